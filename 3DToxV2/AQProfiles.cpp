@@ -0,0 +1,98 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Air quality levels and fan speed controller tunings of each filter profile.
+ // The tables are built at compile time and kept in flash, only the active profile is copied into SRAM by CPm25.
+ // The fan speed controller is tuned from the levels: MinDuty up to the GOOD level, MaxDuty around
+ // the VERY_UNHEALTHY level, and an integral term adding the same amount after about 30 seconds.
+ // The fan is boosted ahead of time when the PM is rising fast enough to leave the dead band within PM_TREND_HORIZON_S.
+
+#include "AQProfiles.h"
+#include "PmTrend.h"
+#include <avr/pgmspace.h>
+
+// proportional gain moving the duty cycle from minDuty at the good limit to maxDuty at the very unhealthy limit (Q8)
+constexpr int FanControlKp(int goodLimit, int veryUnhealthyLimit, byte minDuty, byte maxDuty)
+{
+  return (int)(((long)maxDuty - minDuty) * 256 / (veryUnhealthyLimit - goodLimit));
+}
+
+constexpr int FanControlKi(int kp)
+{
+  return kp / 32 > 0 ? kp / 32 : 1;
+}
+
+// slope leaving the dead band within PM_TREND_HORIZON_S (Q8 ug/m3 per second)
+constexpr int FanBoostSlope(int veryGoodLimit, int goodLimit)
+{
+  return (int)(((long)goodLimit - veryGoodLimit) * 256 / PM_TREND_HORIZON_S);
+}
+
+constexpr FanControlProfile MakeFanControl(int veryGoodLimit, int goodLimit, int veryUnhealthyLimit,
+                                           byte minDuty, byte maxDuty, byte maxRise, byte maxFall, byte hysteresis, byte boostDecay)
+{
+  return FanControlProfile { veryGoodLimit, (byte)(goodLimit - veryGoodLimit),
+                             FanControlKp(goodLimit, veryUnhealthyLimit, minDuty, maxDuty),
+                             FanControlKi(FanControlKp(goodLimit, veryUnhealthyLimit, minDuty, maxDuty)),
+                             minDuty, maxDuty, maxRise, maxFall, hysteresis,
+                             FanBoostSlope(veryGoodLimit, goodLimit), boostDecay };
+}
+
+// AUTO: 50 to 100% duty cycle, QUIET: 40 to 70%
+constexpr AQProfile MakeAQProfile(int veryGood, int good, int moderate, int bad, int unhealthy, int veryUnhealthy)
+{
+  return AQProfile { { veryGood, good, moderate, bad, unhealthy, veryUnhealthy },
+                     MakeFanControl(veryGood, good, veryUnhealthy, 50, 100, 10, 2, 5, 5),
+                     MakeFanControl(veryGood, good, veryUnhealthy, 40, 70, 5, 2, 5, 3) };
+}
+
+constexpr AQProfile AQ_PROFILES[AQ_PROFILE_COUNT] PROGMEM = {
+  // CLEAN_FILTER: the sensor measures the air going through a clean HEPA filter
+  MakeAQProfile(1, 2, 3, 4, 6, 8),
+  // NO_FILTER: the sensor measures the enclosure air
+  // values from https://docs-emea.rs-online.com/webdocs/1665/0900766b816656b2.pdf Page 9
+  MakeAQProfile(10, 50, 100, 150, 200, 300),
+  // ABEK_FILTER: HEPA followed by an ABEK activated carbon filter, which lets some carbon dust through
+  MakeAQProfile(2, 4, 6, 8, 12, 16),
+  // CUSTOM: compile time placeholder for any other setup. It starts as a copy of CLEAN_FILTER,
+  // edit these limits before flashing: selecting it from the menu does not change anything otherwise
+  MakeAQProfile(1, 2, 3, 4, 6, 8),
+};
+
+// the air quality level lookup is a binary search, it needs ascending limits
+constexpr bool AreLimitsAscending(const AQProfile &profile, byte index)
+{
+  return index >= AQ_LIMIT_COUNT || (profile.Limits[index - 1] < profile.Limits[index] && AreLimitsAscending(profile, index + 1));
+}
+
+static_assert(AreLimitsAscending(AQ_PROFILES[CLEAN_FILTER], 1), "CLEAN_FILTER limits must be ascending");
+static_assert(AreLimitsAscending(AQ_PROFILES[NO_FILTER], 1),    "NO_FILTER limits must be ascending");
+static_assert(AreLimitsAscending(AQ_PROFILES[ABEK_FILTER], 1),  "ABEK_FILTER limits must be ascending");
+static_assert(AreLimitsAscending(AQ_PROFILES[CUSTOM], 1),       "CUSTOM limits must be ascending");
+
+void LoadAQProfile(byte index, AQProfile &profile)
+{
+  if(index >= AQ_PROFILE_COUNT)
+  {
+    index = CLEAN_FILTER;
+  }
+  memcpy_P(&profile, &AQ_PROFILES[index], sizeof(AQProfile));
+}
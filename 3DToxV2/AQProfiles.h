@@ -0,0 +1,57 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AQPROFILES
+#define _AQPROFILES
+
+#include <Arduino.h>
+#include "utility.h"
+#include "FanSpeedControl.h"
+
+// Air quality profiles, one per kind of filter installed in front of the sensor.
+// The active profile is selected from the settings menu and saved into EEPROM (see AQProfiles.cpp)
+//have enum in sync and being able to get string from enum name
+#define FOREACH_AQ_PROFILE(PROFILE) \
+        PROFILE(CLEAN_FILTER)   \
+        PROFILE(NO_FILTER)   \
+        PROFILE(ABEK_FILTER)   \
+        PROFILE(CUSTOM)   \
+
+enum AQProfileIndex {
+    FOREACH_AQ_PROFILE(GENERATE_ENUM)
+    AQ_PROFILE_COUNT
+};
+
+static const char *AQ_PROFILE_STRING[] = {
+    FOREACH_AQ_PROFILE(GENERATE_STRING)
+};
+
+const byte AQ_LIMIT_COUNT = 6;    // one limit per AirQualityStatus level, from VERY_GOOD to VERY_UNHEALTHY
+
+typedef struct {
+  int               Limits[AQ_LIMIT_COUNT];  // ug/m3, highest PM2.5 of each level in ascending order. Above the last one: HAZARDOUS
+  FanControlProfile NormalFanControl;        // fan speed controller tuning of the AUTO mode
+  FanControlProfile QuietFanControl;         // fan speed controller tuning of the QUIET mode
+} AQProfile;
+
+// copying a profile from flash. An unknown index loads CLEAN_FILTER
+void LoadAQProfile(byte index, AQProfile &profile);
+
+#endif
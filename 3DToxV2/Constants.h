@@ -45,12 +45,39 @@ const int  RESET_COUNTER_TRIGGER_LIMIT_IN_SEC = 9;
    // Fan model THA0412BN = 2
    const int RPM_SPEED_DEVIDER      = 1;
    const int DISPLAY_PERIOD_MS      = 1000;     // The refresh period of the main screen in milliseconds
-   const int MAIN_LOOP_DELAY        = 5;        // delay for the main loop in milliseconds
+   const int MAIN_LOOP_DELAY        = 5;        // period of the fast main loop tasks in milliseconds
+   const byte DEVICE_EVENT_QUEUE_SIZE = 8;      // amount of timer events that can be queued while the main loop is busy (power of 2)
 
-  const int WARNING_SPEED  = 1000;              // minimum speed in RPM used to display possible warnings on screen
+  const int WARNING_SPEED  = 1000;              // minimum expected speed in RPM for the fan speed to be checked (see FanSupervisor.cpp)
   const int CRITICAL_SPEED = 60;                // minimum speed in RPM where the FAN is considered stopped or blocked
 
+  // fan supervisor, see FanSupervisor.cpp. The durations are multiples of FAN_SUPERVISOR_PERIOD_MS
+  const unsigned int FAN_SUPERVISOR_PERIOD_MS = 250;    // period of the speed checks
+  const unsigned int FAN_SPIN_UP_GRACE_MS     = 2000;   // time given to the fan to reach its speed after a start or a duty cycle increase
+  const unsigned int FAN_STALL_CONFIRM_MS     = 1000;   // the fan is stalled when below CRITICAL_SPEED for this long
+  const unsigned int FAN_DEGRADED_CONFIRM_MS  = 2000;   // the fan is degraded when below FAN_DEGRADED_PERCENT of its expected speed for this long
+  const byte         FAN_DEGRADED_PERCENT     = 50;
+  const unsigned int FAN_KICK_OFF_MS          = 250;    // a kick start switches the fan off for this long
+  const unsigned int FAN_KICK_MS              = 1500;   // then drives it at 100% for this long
+  const byte         FAN_KICK_ATTEMPTS        = 3;      // failed kick starts before the FAN_STALL fault is latched
+  const unsigned long FAN_STALL_RETRY_MS      = 30000;  // period of the kick starts once the fault is latched
+  const unsigned long FAN_BLOCKED_FAULT_MS    = 60000;  // degraded duration latching the FAN_BLOCKED fault
+
+  // fan curve calibration sweep, see FanCurve.cpp. The durations are multiples of FAN_SUPERVISOR_PERIOD_MS
+  const unsigned int FAN_CALIBRATION_MIN_SETTLE_MS  = 2000;   // minimum duration of each step
+  const unsigned int FAN_CALIBRATION_STABLE_MS      = 1000;   // the speed is measured once steady for this long
+  const unsigned int FAN_CALIBRATION_MAX_SETTLE_MS  = 10000;  // or after this long
+  const byte         FAN_CALIBRATION_STABLE_PERCENT = 1;      // speed variation still considered as steady (CRITICAL_SPEED at least)
+
+  // fan speed closed loop, see FanRpmControl.cpp
+  const unsigned int FAN_RPM_CORRECTION_RPM         = 1000;   // speed error changing the duty cycle correction by 1% per second
+  const byte         FAN_RPM_CORRECTION_MAX_PERCENT = 25;     // max duty cycle correction
+  const byte         FAN_RPM_SETTLE_PERCENT         = 5;      // target duty cycle change pausing the correction while the fan follows
+
+  const byte FAN_RAMP_PERCENT_PER_S = 40;       // max duty cycle change of the fan per second, see FanRamp.cpp
+
   const int FAN_SPEED_INCREMENT = 10;           // fan speed increment in % for the manual mode
+  const byte FAN_CONTROL_LEAK_SHIFT = 5;        // the fan speed controller integral loses 1/32 per second once on target
 
   //_SoftwareSerial is used on AUX 2 port
   const int sSerialRxPin = 63;                  // pin 63 of port AUX2 is used for RX pin
@@ -62,6 +89,9 @@ const int  RESET_COUNTER_TRIGGER_LIMIT_IN_SEC = 9;
     // For This device Serial3 is used and corresponds to pins 14(tx) - 15(rx)
   const int SET_PIN     = 64;                   // AUX 2 port Pin 64 used for the Set pin
   const int RESET_PIN   = 44;                   // AUX 2 port Pin 44 is used for the Reset Pin
+  // Second air quality sensor at the filter outlet (DUAL_PMS only), its serial port is PMS_OUTLET_SERIAL (see config.h)
+  const int PMS_OUTLET_SET_PIN   = 65;          // AUX 2 port Pin 65 used for the Set pin
+  const int PMS_OUTLET_RESET_PIN = 66;          // AUX 2 port Pin 66 used for the Reset pin
 
   //SD card pins
   const byte CLK_PIN  = 52;                     // PORT LCD2 pin 52
@@ -91,6 +121,90 @@ const int  RESET_COUNTER_TRIGGER_LIMIT_IN_SEC = 9;
 
 #define SDSS              53                   // SDcard SSDSS pin
 
+// Main loop scheduler task table settings (see main.cpp)
+// Priority 0 is the most urgent. Budgets are in microseconds, periods and deadlines in milliseconds
+const unsigned long TASK_ENCODER_PERIOD_MS   = MAIN_LOOP_DELAY;   // rotary encoder polling
+const unsigned long TASK_ENCODER_DEADLINE_MS = MAIN_LOOP_DELAY;
+const byte          TASK_ENCODER_PRIORITY    = 0;
+const unsigned long TASK_ENCODER_BUDGET_US   = 2000;
+
+const unsigned long TASK_FAN_PERIOD_MS       = MAIN_LOOP_DELAY;   // applying new fan speed
+const unsigned long TASK_FAN_DEADLINE_MS     = MAIN_LOOP_DELAY;
+const byte          TASK_FAN_PRIORITY        = 1;
+const unsigned long TASK_FAN_BUDGET_US       = 2000;
+
+const unsigned long TASK_FAN_SUP_PERIOD_MS   = FAN_SUPERVISOR_PERIOD_MS;   // fan stall and blockage detection
+const unsigned long TASK_FAN_SUP_DEADLINE_MS = 50;
+const byte          TASK_FAN_SUP_PRIORITY    = 2;
+const unsigned long TASK_FAN_SUP_BUDGET_US   = 1000;
+
+const unsigned long TASK_EVENTS_PERIOD_MS    = MAIN_LOOP_DELAY;   // draining events posted by the 1Hz timer interrupt
+const unsigned long TASK_EVENTS_DEADLINE_MS  = MAIN_LOOP_DELAY;
+const byte          TASK_EVENTS_PRIORITY     = 2;
+const unsigned long TASK_EVENTS_BUDGET_US    = 5000;
+
+const unsigned long TASK_DISPLAY_PERIOD_MS   = DISPLAY_PERIOD_MS; // RPM reading, LCD refresh and air quality control
+const unsigned long TASK_DISPLAY_DEADLINE_MS = 100;
+const byte          TASK_DISPLAY_PRIORITY    = 3;
+const unsigned long TASK_DISPLAY_BUDGET_US   = 20000;
+
+const unsigned long TASK_BUTTON_PERIOD_MS    = 1000;              // long press detection, must remain 1 second
+const unsigned long TASK_BUTTON_DEADLINE_MS  = 100;
+const byte          TASK_BUTTON_PRIORITY     = 3;
+const unsigned long TASK_BUTTON_BUDGET_US    = 1000;
+
+const unsigned long TASK_COM_PERIOD_MS       = 1000;              // M105 polling of the 3D printer
+const unsigned long TASK_COM_DEADLINE_MS     = 500;
+const byte          TASK_COM_PRIORITY        = 4;
+const unsigned long TASK_COM_BUDGET_US       = 10000;
+
+const unsigned long TASK_SD_LOG_PERIOD_MS    = 1000;              // SD card data logging
+const unsigned long TASK_SD_LOG_DEADLINE_MS  = 500;
+const byte          TASK_SD_LOG_PRIORITY     = 5;
+const unsigned long TASK_SD_LOG_BUDGET_US    = 30000;
+
+const unsigned long TASK_EEPROM_PERIOD_MS    = 1000;              // running duration EEPROM save
+const unsigned long TASK_EEPROM_DEADLINE_MS  = 1000;
+const byte          TASK_EEPROM_PRIORITY     = 6;
+const unsigned long TASK_EEPROM_BUDGET_US    = 20000;
+
+const unsigned long TASK_CONSOLE_PERIOD_MS   = 50;                // USB serial console commands
+const unsigned long TASK_CONSOLE_DEADLINE_MS = 100;
+const byte          TASK_CONSOLE_PRIORITY    = 4;
+const unsigned long TASK_CONSOLE_BUDGET_US   = 5000;
+
+// USB serial console used for diagnostics commands (TASKS, PROFILE...)
+const long CONSOLE_BAUDRATE                  = 115200;
+const byte CONSOLE_MAX_COMMANDS              = 8;
+const int  PROFILER_SD_SUMMARY_PERIOD_S      = 60;  // a profiler summary line is added to the SD log every minute (PROFILER only)
+const unsigned long IDLE_STATS_WINDOW_MS     = 10000; // window used to compute the CPU active / sleeping duty cycle (TASKS command)
+const unsigned int INPUT_TRACE_BUFFER_SIZE   = 256;   // inputs recorded between two SD card writes, about 90 bytes per second (INPUT_RECORDER only)
+#define INPUT_TRACE_FILE                     "inputs.trc"
+
+// Air quality sensor power management (see PmsPowerManager.cpp, PMS_DUTY_CYCLE inside config.h)
+const unsigned int PMS_STABLE_BEFORE_SLEEP_S = 300;   // clean air duration before the sensor is put to sleep the first time
+const unsigned int PMS_SLEEP_S               = 240;   // sleep duration of one duty cycle
+const unsigned int PMS_WARMUP_S              = 30;    // values are stable 30s after the sensor wake up (PMS1003 datasheet)
+const unsigned int PMS_DUTY_AWAKE_S          = 30;    // measuring duration after the warm up, before going back to sleep
+const int          PMS_SLEEP_MAX_HOTEND_TEMP = 50;    // the sensor only sleeps while the hot end is known to be below this temperature (RS232 link)
+const unsigned int PMS_LASER_SAVE_PERIOD_S   = 360;   // the laser on duration is saved into EEPROM every tenth of hour
+
+// Air quality sensor link health (see CPm25::UpdateLinkState)
+const unsigned long PMS_LINK_DEGRADED_GAP_MS      = 5000;   // no valid frame for this long: the link is degraded
+const unsigned long PMS_LINK_FAILED_GAP_MS        = 15000;  // no valid frame for this long: the sensor is considered failed
+const unsigned long PMS_LINK_WINDOW_MS            = 60000;  // window used to compute the share of bad frames
+const byte          PMS_LINK_DEGRADED_ERROR_PERCENT = 10;   // share of bad frames inside a window making the link degraded
+
+// Inlet / outlet air quality sensors (see PmsFusion.cpp, DUAL_PMS inside config.h)
+const int           PMS_FUSION_MIN_INLET_PM25     = 10;     // ug/m3, below this inlet PM2.5 the filter efficiency is mostly sensor noise
+
+// Watchdog stall detector (see Watchdog.cpp)
+// max duration of one main loop iteration. The PMS read no longer blocks (CPmsParser), the longest blocking paths left are
+// the SD card init and write of the SD_LOG task (WD_SD_INIT, WD_SD_WRITE) and the M105 reply wait of the COM task (WD_COM_READ).
+// The EEPROM clear and rollover kick the watchdog themselves
+#define WATCHDOG_TIMEOUT                     WDTO_8S
+const byte STALL_HISTORY_RECORDS             = 6;     // amount of stalls kept inside the EEPROM history (STALLS command)
+
 // LCD configuration for 20x4 display
 const byte REFRESH_RATE_DIVIDER = DISPLAY_PERIOD_MS / MAIN_LOOP_DELAY; // LCD refresh rate divider
 const int LCD_COLUMNS = 20;
@@ -104,6 +218,8 @@ const int LCD_ROWS    = 4;
 #define BTN_EN1           31                  // Knob encoder 1 pin on port LCD2 Pin 31
 #define BTN_EN2           33                  // Knob encoder 1 pin on port LCD2 Pin 33
 #define BTN_ENC           35                  // Knob push button pin on port LCD1 Pin 35
+const byte INPUT_EVENT_QUEUE_SIZE  = 16;      // amount of knob events that can be queued while the main loop is busy (power of 2)
+const byte BUTTON_DEBOUNCE_SAMPLES = 5;       // the knob button level must be stable for 5 encoder samples (~5ms)
 
 #define LCD_PINS_RS     16                    // LCD RS pin on Port LCD1 Pin 16
 #define LCD_PINS_ENABLE 17                    // LCD ENABLE pin on Port LCD1 Pin 17
@@ -25,6 +25,7 @@
  //
 
 #include "EEPROM_functions.h"
+#include "Watchdog.h"
 
 // Resetting EEPROM data with 0x00
 // Adding INIT code at location 0 to 2 . this identifies the version of the EEPROM structure
@@ -38,10 +39,15 @@ void CEEPROM::ResetEEPROM()
   SafeWriteEEPROMData(0, EEPROM_INIT_0);
   SafeWriteEEPROMData(1, EEPROM_INIT_1);
   SafeWriteEEPROMData(2, EEPROM_INIT_2);
-  // clearing other bytes
-  for (int i = 3 ; i < EEPROM.length(); i++)
+  // clearing other bytes. The laser on duration, the fan curve and fault, the air quality profile and the stall history at the end of the EEPROM are kept
+  for (int i = 3 ; i < EEPROM_SPREAD_END_ADDR; i++)
   {
+    if(i >= EEPROM_LASER_HOURS_ADDR && i <= EEPROM_LASER_TENTHS_ADDR)
+    {
+      continue;
+    }
     SafeWriteEEPROMData(i, 0x00);
+    CWatchdog::Kick();                    // this takes up to 13 seconds
   }
 
 #ifdef DEBUG
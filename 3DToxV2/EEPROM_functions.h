@@ -33,7 +33,9 @@ const byte EEPROM_INIT_2 = 0x04;
 // the 3 first bytes are used to store EEPROM structure version
 const byte  EEPROM_BAUDRATE    = 3;   // address of Baudrate setting (int)
 const byte  EEPROM_MODE        = 4;   // address of currently selected mode (int)
-// bytes add 5-> 9 are kept emtpy for possible future features
+// air quality sensor laser on duration (see PmsPowerManager.cpp). It is not cleared when the running duration is reset
+const byte  EEPROM_LASER_HOURS_ADDR  = 5;   // address of laser on hours (unsigned int, 2 bytes)
+const byte  EEPROM_LASER_TENTHS_ADDR = 7;   // address of the tenths of hour not counted yet inside the laser hours
 
 //-----------------------------------------------------------------------------
 const byte  EEPROM_MINUTES_ADDR = 8;
@@ -43,11 +45,26 @@ const byte  EEPROM_DAYS_H_ADDR = 10;  // address to store Days (highByte)
 const byte  EEPROM_DAYS_L_ADDR = 11;  // address tp store Days (lowByte)
 
 // The remaining bytes starting at add 12 are used to store the running duration
-// Arduino MEGA 2560 has 4KB This leaves 4096-12 = 4084 bytes of memory to spread
-// the device duration over all the bytes
+// Arduino MEGA 2560 has 4KB. The last 79 bytes are reserved for the fan curve, the fan fault, the air quality profile and the watchdog stall history
+// This leaves 4096-12-79 = 4005 bytes of memory to spread the device duration over all the bytes
 // more details are provided about the algorythm inside file RunningDuration.cpp
 const byte  EEPPROM_START_ADDR = 12;  // Address to start spreading the writing of duration
 
+// watchdog stall history (see Watchdog.cpp). It is not cleared when the running duration is reset
+const int   EEPROM_STALL_HISTORY_SIZE = 64;
+const int   EEPROM_STALL_HISTORY_ADDR = (E2END + 1) - EEPROM_STALL_HISTORY_SIZE;
+// selected air quality profile (see AQProfiles.h). It is not cleared when the running duration is reset.
+// This byte used to be the end of the spread memory, which never goes beyond 1 day of minutes: it reads 0 (CLEAN_FILTER) on older devices
+const int   EEPROM_AQ_PROFILE_ADDR    = EEPROM_STALL_HISTORY_ADDR - 1;
+// fan fault latched by the fan supervisor and amount of faults (see FanSupervisor.h). They are not cleared when the running duration is reset
+// These bytes used to be spread memory as well: they read 0 (FAN_OK) on older devices
+const int   EEPROM_FAN_FAULT_ADDR       = EEPROM_AQ_PROFILE_ADDR - 2;
+const int   EEPROM_FAN_FAULT_COUNT_ADDR = EEPROM_AQ_PROFILE_ADDR - 1;
+// calibrated fan curve (see FanCurve.h). It is not cleared when the running duration is reset.
+// Older devices have no FAN_CURVE_MARKER there and use the linear curve
+const int   EEPROM_FAN_CURVE_ADDR       = EEPROM_FAN_FAULT_ADDR - 12;
+const int   EEPROM_SPREAD_END_ADDR    = EEPROM_FAN_CURVE_ADDR;       // first address after the spread memory
+
 class CEEPROM
 {
   public:
@@ -0,0 +1,82 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EVENTQUEUE
+#define _EVENTQUEUE
+
+#include <Arduino.h>
+
+// compiler barrier preventing the items copy from being moved after the index update
+#define EVENTQUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// Single producer / single consumer queue used to pass events from an ISR to the main loop
+// - the producer (ISR) only writes _head
+// - the consumer (main loop) only writes _tail
+// Both indexes are single bytes so they are read and written atomically on AVR,
+// no need to disable interrupts when pushing or popping.
+// SIZE must be a power of 2 and lower or equal to 128. One slot is kept empty to detect a full queue.
+template <class T, byte SIZE>
+class CEventQueue
+{
+  public:
+  // called from the producer side only. returns false if the queue is full, the event is then dropped
+  bool Push(const T &item)
+  {
+    byte head = _head;
+    byte next = (head + 1) & (SIZE - 1);
+    if(next == _tail)
+    {
+      _dropped++;
+      return false;
+    }
+    _items[head] = item;
+    EVENTQUEUE_BARRIER();  // making sure the item is fully written before publishing it
+    _head = next;
+    return true;
+  }
+
+  // called from the consumer side only. returns false if the queue is empty
+  bool Pop(T &item)
+  {
+    byte tail = _tail;
+    if(tail == _head)
+    {
+      return false;
+    }
+    item  = _items[tail];
+    EVENTQUEUE_BARRIER();  // making sure the item is fully read before releasing the slot
+    _tail = (tail + 1) & (SIZE - 1);
+    return true;
+  }
+
+  bool IsEmpty() { return _head == _tail; }
+  // amount of events dropped because the consumer was too slow
+  byte GetDroppedCount() { return _dropped; }
+
+  private:
+  T _items[SIZE];
+  volatile byte _head    = 0;
+  volatile byte _tail    = 0;
+  volatile byte _dropped = 0;
+
+  static_assert((SIZE & (SIZE - 1)) == 0 && SIZE <= 128, "CEventQueue SIZE must be a power of 2 <= 128");
+};
+
+#endif
@@ -22,15 +22,19 @@
  // the air inside the 3DToxV2
  // It can also measure the speed of the fan by using the Hall sensor output of the fan
  // In order to drive the fan speed, we are using the PWM input of the Fan
+ // With FAN_TACH_PERIOD (see config.h), each Hall sensor pulse is timestamped and the speed is computed
+ // from the median period of the last PERIOD_COUNT pulses instead of counting the pulses during one second
 
 
 #include "Arduino.h"
 #include "FanController.h"
+#include "InputRecorder.h"
 
 FanController::FanController(byte sensorPin,
 	 													unsigned int sensorThreshold,
 														unsigned int speedDivider,
-														byte pwmPin)
+														byte pwmPin,
+														unsigned int maxSpeed)
 {
 	_sensorPin = sensorPin;                                  // Hall sensor output wire of the fan
                                                            // this wire will give us the actual rpm of the fan
@@ -41,12 +45,28 @@ FanController::FanController(byte sensorPin,
 	_pwmPin = pwmPin;
 	pinMode(pwmPin, OUTPUT);
 	_pwmDutyCycle = 100;                                     // default fan speed we want at startup
+	_minPeriodMicros = 1;                                    // pulses closer than half the period at maxSpeed are glitches
+	if (maxSpeed > 0 && speedDivider > 0)
+	{
+		_minPeriodMicros = 30000000UL / ((unsigned long)maxSpeed * speedDivider);
+	}
+	_lastReading = 0;
+	_lastPulses = 0;
+	_stoppedPulses = 0;
+	_stopped = false;
+	_lastMillis = 0;
+	memset(&_isrState, 0, sizeof(_isrState));
+	_tach.Publish(_isrState);
 }
 
 // starting the fan speed measurement
 void FanController::begin()
 {
 	static byte instance;
+	if (instance >= MAX_INSTANCES)
+	{
+		return;
+	}
 	_instance = instance;
 	_instances[instance] = this;
 	digitalWrite(_sensorPin, HIGH);                         // Enable pullup on _sensorPin
@@ -55,25 +75,94 @@ void FanController::begin()
 	instance++;
 }
 
+#ifdef FAN_TACH_PERIOD
+// function used to retrieve speed value in RPM
+// the speed is computed at each call from the median period of the last PERIOD_COUNT pulses (a single
+// late or early pulse doesn't move it). The time elapsed since the last pulse is used instead when it is longer,
+// so a slowing down fan is reported at once, and the speed is 0 without any pulse during _sensorThreshold.
+// micros() wraps around every 71.6 minutes: once the fan is seen stopped, the speed stays 0 until the pulse
+// counter moves, so a fan stopped for longer doesn't show the speed of its last periods after the wrap around
+unsigned int FanController::getSpeed() {
+	TachState state;
+	_tach.Read(state);                                                          // consistent copy, the interrupt stays enabled
+	unsigned long sinceLastPulse = micros() - state.LastPulseMicros;
+#ifdef INPUT_RECORDER
+	unsigned int elapsed = millis() - _lastMillis;
+	if (elapsed > _sensorThreshold)
+	{
+		CInputRecorder::RecordTach(state.Pulses - _lastPulses, elapsed);         // the trace keeps the pulse count format of the counting mode
+		_lastPulses = state.Pulses;
+		_lastMillis += elapsed;
+	}
+#endif
+
+	if (_stopped && state.Pulses == _stoppedPulses)
+	{
+		_lastReading = 0;
+		return _lastReading;
+	}
+	_stopped = false;
+	if (state.PeriodCount == 0
+			|| _speed_divider == 0
+			|| sinceLastPulse > (unsigned long)_sensorThreshold * 1000)
+	{
+		_stopped = true;
+		_stoppedPulses = state.Pulses;
+		_lastReading = 0;
+		return _lastReading;
+	}
+	unsigned long period = max(medianPeriod(state.PeriodCount, state.Periods), sinceLastPulse);
+	_lastReading = min(60000000UL / (period * _speed_divider), 65535UL);    // Computing RPM
+	return _lastReading;
+}
+
+// sorting the copied periods (8 values at most, insertion sort) and returning the middle one
+unsigned long FanController::medianPeriod(byte count, unsigned long *periods)
+{
+	for (byte i = 1; i < count; i++)
+	{
+		unsigned long period = periods[i];
+		byte j = i;
+		for (; j > 0 && periods[j - 1] > period; j--)
+		{
+			periods[j] = periods[j - 1];
+		}
+		periods[j] = period;
+	}
+	return periods[count / 2];
+}
+#else
 // function used to retrieve speed value in RPM
 // this function will perform computation only when called after the _sensorThreshold period
 // otherwise it will send the previously calculated speed
+// the interrupt keeps counting during the computation: the pulses are the difference of its free running counter
 unsigned int FanController::getSpeed() {
 	unsigned int elapsed = millis() - _lastMillis;
 	if ((elapsed > _sensorThreshold)
-			&& (elapsed > 0)
 			&& (_speed_divider > 0))
 	{
-		detachInterrupt(_sensorInterruptPin);                                     // detaching interrupts to prevent interruption from happening when performing computation
-		double correctionFactor = (double)_sensorThreshold / elapsed;             // creating correction factor based on actual elapsed duration
-		_lastReading = correctionFactor * _pulses * 60 / _speed_divider;          // Computing RPM
-		_pulses = 0;																															// resetting the count of pulses from FAN HAL effect sensor
-		_lastMillis = millis();																										// setting new starting timestamp for next computation
-		AttachInterrupt();																												// attaching back interrupt to resume measurement
+		TachState state;
+		_tach.Read(state);                                                        // consistent copy, the interrupt stays enabled
+		unsigned int pulses = state.Pulses - _lastPulses;                         // counter wrap around is handled by the unsigned difference
+		_lastReading = (unsigned long)pulses * 60000UL / ((unsigned long)elapsed * _speed_divider);   // Computing RPM
+#ifdef INPUT_RECORDER
+		CInputRecorder::RecordTach(pulses, elapsed);
+#endif
+		_lastPulses = state.Pulses;
+		_lastMillis += elapsed;                                                   // next measurement starts where this one ended
 	}
 	return _lastReading;
 }
 
+#endif
+
+// amount of pulses ignored because they came too early after the previous one (noise on the Hall sensor wire)
+unsigned long FanController::getGlitchCount() {
+	TachState state;
+	_tach.Read(state);
+	return state.Glitches;
+}
+
 // function dedicated to setting fan PWM duty cycle to control it's speed
 void FanController::setDutyCycle(byte dutyCycle) {
 	_pwmDutyCycle = min(dutyCycle, 100);
@@ -86,51 +175,60 @@ byte FanController::getDutyCycle() {
 }
 
 // attaching interrupt based on the the instance index
+// the interrupt stays attached: getSpeed() reads the pulses without stopping it
 void FanController::AttachInterrupt()
 {
-	switch (_instance)
-	{
-	case 0:
-		attachInterrupt(_sensorInterruptPin, TriggerExt0, FALLING);
-		break;
-	case 1:
-		attachInterrupt(_sensorInterruptPin, TriggerExt1, FALLING);
-		break;
-	case 2:
-		attachInterrupt(_sensorInterruptPin, TriggerExt2, FALLING);
-		break;
-	case 3:
-		attachInterrupt(_sensorInterruptPin, TriggerExt3, FALLING);
-		break;
-	case 4:
-		attachInterrupt(_sensorInterruptPin, TriggerExt4, FALLING);
-		break;
-	case 5:
-		attachInterrupt(_sensorInterruptPin, TriggerExt5, FALLING);
-		break;
-	}
+	attachInterrupt(_sensorInterruptPin, _triggers[_instance], FALLING);
 }
 
-FanController * FanController::_instances[6];
+FanController * FanController::_instances[MAX_INSTANCES];
 
 // incrementing amount of pulses when an interrupt happens
+// with FAN_TACH_PERIOD, the period since the previous pulse is also stored. A pulse coming sooner than
+// _minPeriodMicros is a glitch: it is dropped and the next period is measured from the previous valid pulse
 void FanController::Trigger()
 {
-	_pulses++;
+#ifdef FAN_TACH_PERIOD
+	unsigned long now = micros();
+	unsigned long period = now - _isrState.LastPulseMicros;
+	if (period < _minPeriodMicros)
+	{
+		_isrState.Glitches++;
+		_tach.Publish(_isrState);
+		return;
+	}
+	_isrState.LastPulseMicros = now;
+	if (period > (unsigned long)_sensorThreshold * 1000)
+	{
+		_isrState.PeriodIndex = 0;                               // first pulse after a stop, there is no period yet
+		_isrState.PeriodCount = 0;
+	}
+	else
+	{
+		_isrState.Periods[_isrState.PeriodIndex] = period;
+		_isrState.PeriodIndex = (_isrState.PeriodIndex + 1) & (PERIOD_COUNT - 1);
+		if (_isrState.PeriodCount < PERIOD_COUNT)
+		{
+			_isrState.PeriodCount++;
+		}
+	}
+#endif
+	_isrState.Pulses++;
+	_tach.Publish(_isrState);
 }
 
-// calling pulse increment when an interrupt is triggered based on instance index
-void FanController::TriggerCaller(byte instance)
+// interrupt handler of each instance, attachInterrupt() callbacks don't take any argument
+template <byte instance>
+void FanController::TriggerExt()
 {
-	if (FanController::_instances[instance] != nullptr)
+	if (_instances[instance] != nullptr)
 	{
-		FanController::_instances[instance]->Trigger();
+		_instances[instance]->Trigger();
 	}
 }
 
-void FanController::TriggerExt0() { FanController::TriggerCaller(0); }
-void FanController::TriggerExt1() { FanController::TriggerCaller(1); }
-void FanController::TriggerExt2() { FanController::TriggerCaller(2); }
-void FanController::TriggerExt3() { FanController::TriggerCaller(3); }
-void FanController::TriggerExt4() { FanController::TriggerCaller(4); }
-void FanController::TriggerExt5() { FanController::TriggerCaller(5); }
+// one handler per instance, indexed by _instance
+void (* const FanController::_triggers[MAX_INSTANCES])() = {
+	TriggerExt<0>, TriggerExt<1>, TriggerExt<2>, TriggerExt<3>, TriggerExt<4>, TriggerExt<5>
+};
+static_assert(FanController::MAX_INSTANCES == 6, "one TriggerExt handler is needed for each instance");
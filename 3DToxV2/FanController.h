@@ -11,6 +11,7 @@
 #define FanController_h
 
 #include "Arduino.h"
+#include "SeqLock.h"
 
 class FanController
 {
@@ -18,32 +19,46 @@ class FanController
 		FanController(byte sensorPin,
 			 						unsigned int sensorThreshold,
 									unsigned int speedDivider = 1,
-								  byte pwmPin = 0);
+								  byte pwmPin = 0,
+									unsigned int maxSpeed = 0);
 		void begin();
 		unsigned int getSpeed();
 		void setDutyCycle(byte dutyCycle);
 		byte getDutyCycle();
+		unsigned long getGlitchCount();
+		static const byte PERIOD_COUNT = 8;	// amount of pulse periods the speed is computed from (power of 2)
+		static const byte MAX_INSTANCES = 6;
 	private:
-		static FanController *_instances[6];
+		// pulse accounting of the tachometer interrupt, published after each pulse
+		struct TachState {
+			unsigned int  Pulses;                 // free running count of the valid pulses
+			unsigned long LastPulseMicros;
+			unsigned long Glitches;
+			byte          PeriodIndex;            // next slot of Periods
+			byte          PeriodCount;            // amount of valid Periods, 0 until a second pulse after a stop
+			unsigned long Periods[PERIOD_COUNT];
+		};
+		static FanController *_instances[MAX_INSTANCES];
+		static void (* const _triggers[MAX_INSTANCES])();
 		byte _sensorPin;
 		byte _sensorInterruptPin;
-		byte _sensorThreshold;
+		unsigned int _sensorThreshold;
 		byte _speed_divider;
 		byte _pwmPin;
 		byte _pwmDutyCycle;
 		byte _instance;
 		unsigned int _lastReading;
-		volatile unsigned int _pulses;
+		unsigned int _lastPulses;               // TachState.Pulses at the previous measurement
+		unsigned int _stoppedPulses;            // TachState.Pulses when the fan was seen stopped
+		bool _stopped;                          // the speed stays 0 until a new pulse comes
 		unsigned long _lastMillis;
+		unsigned long _minPeriodMicros;
+		TachState _isrState;                    // written by the interrupt only
+		CSeqLock<TachState> _tach;              // copy of _isrState read by getSpeed() without disabling the interrupt
+		unsigned long medianPeriod(byte count, unsigned long *periods);
 		void Trigger();
 		void AttachInterrupt();
-		static void TriggerCaller(byte instance);
-		static void TriggerExt0();
-		static void TriggerExt1();
-		static void TriggerExt2();
-		static void TriggerExt3();
-		static void TriggerExt4();
-		static void TriggerExt5();
+		template <byte instance> static void TriggerExt();
 };
 
 #endif
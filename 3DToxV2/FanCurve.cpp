@@ -0,0 +1,171 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class holds the duty cycle to speed curve of the fan. Each fan model and supply voltage gives a different
+ // speed at the same duty cycle, so the curve is measured by a calibration sweep:
+ // the duty cycle goes from 0% to 100% by FAN_CURVE_STEP_PERCENT steps. Each step lasts at least
+ // FAN_CALIBRATION_MIN_SETTLE_MS, then until the speed stays within FAN_CALIBRATION_STABLE_PERCENT
+ // of the same value for FAN_CALIBRATION_STABLE_MS (FAN_CALIBRATION_MAX_SETTLE_MS at most). The last speed is the point of the step.
+ // The sweep takes about one minute. Its points are made non decreasing and saved inside EEPROM,
+ // unless the fan never reached WARNING_SPEED: the previous curve is then kept.
+
+#include "FanCurve.h"
+#include "EEPROM_functions.h"
+
+static const unsigned int FAN_CALIBRATION_MIN_SETTLE_TICKS = FAN_CALIBRATION_MIN_SETTLE_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_CALIBRATION_MAX_SETTLE_TICKS = FAN_CALIBRATION_MAX_SETTLE_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const byte         FAN_CALIBRATION_STABLE_TICKS     = FAN_CALIBRATION_STABLE_MS / FAN_SUPERVISOR_PERIOD_MS;
+
+void CFanCurve::Load()
+{
+  _calibrated = EEPROM.read(EEPROM_FAN_CURVE_ADDR) == FAN_CURVE_MARKER;
+  for(byte i = 0; i < FAN_CURVE_POINTS; i++)
+  {
+    _points[i] = EEPROM.read(EEPROM_FAN_CURVE_ADDR + 1 + i);
+    if(i > 0 && _points[i] < _points[i - 1])
+    {
+      _calibrated = false;          // saved curves are non decreasing
+    }
+  }
+}
+
+unsigned int CFanCurve::GetRpm(byte duty)
+{
+  duty = min(duty, 100);
+  if(!_calibrated)
+  {
+    return (unsigned long)MAX_FAN_RPM * duty / 100;
+  }
+  byte point = duty / FAN_CURVE_STEP_PERCENT;
+  byte rest  = duty % FAN_CURVE_STEP_PERCENT;
+  unsigned int rpm = _points[point] * 100;
+  if(rest > 0)
+  {
+    rpm += (unsigned long)(_points[point + 1] - _points[point]) * 100 * rest / FAN_CURVE_STEP_PERCENT;
+  }
+  return rpm;
+}
+
+// the curve is flat below the start duty cycle of the fan, the rising segment is used
+byte CFanCurve::GetDuty(unsigned int rpm)
+{
+  if(rpm == 0)
+  {
+    return 0;
+  }
+  if(!_calibrated)
+  {
+    return min((unsigned long)rpm * 100 / MAX_FAN_RPM, 100UL);
+  }
+  for(byte i = 0; i + 1 < FAN_CURVE_POINTS; i++)
+  {
+    unsigned int low  = _points[i] * 100;
+    unsigned int high = _points[i + 1] * 100;
+    if(high >= rpm && high > low)
+    {
+      unsigned int offset = rpm > low ? rpm - low : 0;
+      return i * FAN_CURVE_STEP_PERCENT + (unsigned long)offset * FAN_CURVE_STEP_PERCENT / (high - low);
+    }
+  }
+  return 100;
+}
+
+void CFanCurve::Clear()
+{
+  _calibrated = false;
+  CEEPROM::SafeWriteEEPROMData(EEPROM_FAN_CURVE_ADDR, 0);
+}
+
+void CFanCurve::StartCalibration()
+{
+  _calibrating       = true;
+  _calibrationFailed = false;
+  _step              = 0;
+  _stepTicks         = 0;
+  _stableTicks       = 0;
+  _steadyRpm         = 0;
+}
+
+void CFanCurve::StopCalibration()
+{
+  _calibrating = false;
+}
+
+void CFanCurve::UpdateCalibration(unsigned int rpm)
+{
+  if(!_calibrating)
+  {
+    return;
+  }
+  _stepTicks++;
+  unsigned int tolerance = max(_steadyRpm / 100 * FAN_CALIBRATION_STABLE_PERCENT, (unsigned int)CRITICAL_SPEED);
+  // the fan is unpowered at 0%: its slow coast down would look steady, it is only once stopped.
+  // The sweep then starts from rest, a fan still turning could keep turning below its start duty cycle
+  bool stopping = _step == 0 && rpm > 0;
+  if(!stopping && rpm + tolerance >= _steadyRpm && rpm <= _steadyRpm + tolerance)
+  {
+    _stableTicks++;
+  }
+  else
+  {
+    _steadyRpm   = rpm;             // the speed still moves, the steady window starts again from here
+    _stableTicks = 0;
+  }
+  if(_stepTicks < FAN_CALIBRATION_MIN_SETTLE_TICKS
+     || (_stableTicks < FAN_CALIBRATION_STABLE_TICKS && _stepTicks < FAN_CALIBRATION_MAX_SETTLE_TICKS))
+  {
+    return;
+  }
+
+  _measures[_step] = min((rpm + 50) / 100, 255U);
+  _step++;
+  _stepTicks   = 0;
+  _stableTicks = 0;
+  if(_step == FAN_CURVE_POINTS)
+  {
+    _calibrating = false;
+    _step        = 0;
+    SaveCalibration();
+  }
+}
+
+// a speed measured lower than the one of the previous step is a measurement error, the previous speed is kept
+void CFanCurve::SaveCalibration()
+{
+  for(byte i = 1; i < FAN_CURVE_POINTS; i++)
+  {
+    _measures[i] = max(_measures[i], _measures[i - 1]);
+  }
+  if(_measures[FAN_CURVE_POINTS - 1] * 100 < WARNING_SPEED)
+  {
+    _calibrationFailed = true;
+    return;
+  }
+  memcpy(_points, _measures, sizeof(_points));
+  _calibrated = true;
+  for(byte i = 0; i < FAN_CURVE_POINTS; i++)
+  {
+    CEEPROM::SafeWriteEEPROMData(EEPROM_FAN_CURVE_ADDR + 1 + i, _points[i]);
+  }
+  CEEPROM::SafeWriteEEPROMData(EEPROM_FAN_CURVE_ADDR, FAN_CURVE_MARKER);
+}
+
+static_assert(FAN_CURVE_EEPROM_SIZE == EEPROM_FAN_FAULT_ADDR - EEPROM_FAN_CURVE_ADDR, "the fan curve doesn't fit its EEPROM slot");
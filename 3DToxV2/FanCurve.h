@@ -0,0 +1,75 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FANCURVE
+#define _FANCURVE
+
+#include <Arduino.h>
+#include "Constants.h"
+
+const byte FAN_CURVE_POINTS       = 11;                        // fan speed measured every FAN_CURVE_STEP_PERCENT from 0% to 100%
+const byte FAN_CURVE_STEP_PERCENT = 100 / (FAN_CURVE_POINTS - 1);
+const byte FAN_CURVE_EEPROM_SIZE  = FAN_CURVE_POINTS + 1;      // marker byte followed by the points
+const byte FAN_CURVE_MARKER       = 0xC5;                      // tells a calibrated curve from an empty EEPROM (0x00 or 0xFF)
+
+// Duty cycle to fan speed curve, measured by a calibration sweep and saved inside EEPROM.
+// Each point is the speed in hundreds of RPM (25500 RPM max). Until a calibration succeeds
+// the curve is linear, MAX_FAN_RPM at 100%.
+// The sweep is started with the FANCAL START console command (see FanCurve.cpp)
+class CFanCurve
+{
+  public:
+  // reading back the curve. Should be called after the EEPROM version has been checked
+  void Load();
+  bool IsCalibrated() { return _calibrated; }
+  // speed given by this duty cycle, interpolated between two points
+  unsigned int GetRpm(byte duty);
+  // smallest duty cycle giving this speed, 100% above the max speed
+  byte GetDuty(unsigned int rpm);
+  unsigned int GetMaxRpm() { return GetRpm(100); }
+  // back to the linear curve, the saved curve is erased
+  void Clear();
+
+  // the calibration sweep drives the fan itself, the air quality control and the fan supervisor are paused meanwhile
+  void StartCalibration();
+  void StopCalibration();
+  bool IsCalibrating() { return _calibrating; }
+  // called every FAN_SUPERVISOR_PERIOD_MS with the measured speed while calibrating
+  void UpdateCalibration(unsigned int rpm);
+  // duty cycle to apply while calibrating
+  byte GetCalibrationDuty() { return _step * FAN_CURVE_STEP_PERCENT; }
+  // true when the last sweep measured no usable curve (fan not turning, no tachometer signal), the previous curve is kept
+  bool HasCalibrationFailed() { return _calibrationFailed; }
+
+  private:
+  void SaveCalibration();
+
+  byte          _points[FAN_CURVE_POINTS];
+  bool          _calibrated        = false;
+  bool          _calibrating       = false;
+  bool          _calibrationFailed = false;
+  byte          _step              = 0;       // point being measured
+  unsigned int  _stepTicks         = 0;       // UpdateCalibration() calls since the duty cycle of the step was applied
+  byte          _stableTicks       = 0;       // consecutive calls with the speed close to _steadyRpm
+  unsigned int  _steadyRpm         = 0;
+  byte          _measures[FAN_CURVE_POINTS];  // points of the sweep in progress
+};
+
+#endif
@@ -0,0 +1,69 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class ramps the fan duty cycle instead of applying each new speed at once.
+ // The duty cycle moves by FAN_RAMP_PERCENT_PER_S at most, in small steps applied by the fan task
+ // every MAIN_LOOP_DELAY, so the loop never waits for the fan. The fractional progress is kept between two
+ // updates, so the rate doesn't depend on the update period.
+ // The latency of each ramp, from the target change until the duty cycle reaches it, is measured for the
+ // STATUS console command. A target changed during a ramp extends it.
+
+#include "FanRamp.h"
+
+void CFanRamp::SetTarget(byte duty, unsigned long nowMs)
+{
+  duty = min(duty, 100);
+  if(duty == _target)
+  {
+    return;
+  }
+  if(_duty == _target)
+  {
+    _startMs  = nowMs;              // new ramp, the previous one was completed
+    _lastMs   = nowMs;
+    _progress = 0;
+  }
+  _target = duty;
+}
+
+byte CFanRamp::Update(unsigned long nowMs)
+{
+  unsigned long elapsed = nowMs - _lastMs;
+  _lastMs = nowMs;
+  if(_duty == _target)
+  {
+    return _duty;
+  }
+
+  _progress += elapsed * _percentPerSecond;
+  byte distance = _duty < _target ? _target - _duty : _duty - _target;
+  byte step     = min(_progress / 1000, (unsigned long)distance);
+  _progress    -= (unsigned long)step * 1000;
+  _duty         = _duty < _target ? _duty + step : _duty - step;
+
+  if(_duty == _target)
+  {
+    _lastLatencyMs = nowMs - _startMs;
+    _maxLatencyMs  = max(_maxLatencyMs, _lastLatencyMs);
+    _ramps++;
+  }
+  return _duty;
+}
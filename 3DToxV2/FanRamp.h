@@ -0,0 +1,62 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FANRAMP
+#define _FANRAMP
+
+#include <Arduino.h>
+
+// Slew rate limiter of the fan duty cycle (see FanRamp.cpp).
+// The duty cycle applied to the fan moves towards its target by FAN_RAMP_PERCENT_PER_S at most,
+// so a speed change neither stalls the fan nor draws an inrush current
+class CFanRamp
+{
+  public:
+  CFanRamp(byte percentPerSecond) : _percentPerSecond(percentPerSecond) {}
+  // duty cycle to reach, the ramp starts at the next Update()
+  void SetTarget(byte duty, unsigned long nowMs);
+  // called periodically, returns the duty cycle to apply
+  byte Update(unsigned long nowMs);
+  // applies the duty cycle at once, without ramp nor latency measurement
+  void SetDutyCycle(byte duty) { _duty = _target = min(duty, 100); }
+
+  byte GetDutyCycle() { return _duty; }
+  byte GetTarget() { return _target; }
+  bool IsRamping() { return _duty != _target; }
+  byte GetRate() { return _percentPerSecond; }
+  // duration between a target change and the duty cycle reaching it, for the last ramp and the longest one
+  unsigned long GetLastLatencyMs() { return _lastLatencyMs; }
+  unsigned long GetMaxLatencyMs() { return _maxLatencyMs; }
+  // amount of completed ramps since startup
+  unsigned int GetRampCount() { return _ramps; }
+
+  private:
+  byte          _percentPerSecond;
+  byte          _duty          = 0;
+  byte          _target        = 0;
+  unsigned long _lastMs        = 0;       // millis() of the last Update()
+  unsigned long _startMs       = 0;       // millis() when the current ramp started
+  unsigned long _progress      = 0;       // duty cycle progress not applied yet, in 1/1000 %
+  unsigned long _lastLatencyMs = 0;
+  unsigned long _maxLatencyMs  = 0;
+  unsigned int  _ramps         = 0;
+};
+
+#endif
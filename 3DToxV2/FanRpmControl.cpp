@@ -0,0 +1,72 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class drives the fan at a target speed instead of a duty cycle.
+ // The air flow of a fan is proportional to its speed, so a speed percentage of the calibrated max speed
+ // gives the same share of the max air flow whatever the fan model and the supply voltage.
+ // The duty cycle read from the calibrated curve is the feed forward part. As the filter loads up, the fan
+ // no longer turns at the speed of the curve: an integral correction, 1% per second for each FAN_RPM_CORRECTION_RPM
+ // of speed error, tracks the target speed. It is limited to FAN_RPM_CORRECTION_MAX_PERCENT and isn't
+ // increased further while the duty cycle is at 0% or 100%.
+ // A fan far below its target is reported as degraded by the fan supervisor.
+
+#include "FanRpmControl.h"
+
+byte CFanRpmControl::GetDutyCycle(byte speedPercent)
+{
+  if(!_curve->IsCalibrated() || speedPercent == 0)
+  {
+    _targetRpm = 0;
+    _duty      = speedPercent;
+    return _duty;
+  }
+  _targetRpm   = (unsigned long)_curve->GetMaxRpm() * min(speedPercent, 100) / 100;
+  _feedForward = _curve->GetDuty(_targetRpm);
+  int duty     = _feedForward + (int)((_correctionQ8 + 128) >> 8);
+  _duty        = constrain(duty, 1, 100);
+  return _duty;
+}
+
+void CFanRpmControl::Update(unsigned int rpm, bool settled)
+{
+  if(_targetRpm == 0 || !settled)
+  {
+    return;
+  }
+  if(abs((int)_feedForward - _settleDuty) > FAN_RPM_SETTLE_PERCENT)
+  {
+    _settleDuty  = _feedForward;
+    _settleTicks = FAN_SPIN_UP_GRACE_MS / FAN_SUPERVISOR_PERIOD_MS;
+  }
+  if(_settleTicks > 0)
+  {
+    _settleTicks--;               // the fan is still reaching the new target
+    return;
+  }
+  long error = (long)_targetRpm - rpm;
+  if((error > 0 && _duty >= 100) || (error < 0 && _duty <= 1))
+  {
+    return;                       // anti windup
+  }
+  const long maxQ8 = (long)FAN_RPM_CORRECTION_MAX_PERCENT * 256;
+  _correctionQ8 += error * 256 * FAN_SUPERVISOR_PERIOD_MS / (1000L * FAN_RPM_CORRECTION_RPM);
+  _correctionQ8  = constrain(_correctionQ8, -maxQ8, maxQ8);
+}
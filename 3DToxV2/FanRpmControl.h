@@ -0,0 +1,57 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FANRPMCONTROL
+#define _FANRPMCONTROL
+
+#include <Arduino.h>
+#include "FanCurve.h"
+
+// Closed loop on the fan speed once the fan curve is calibrated (see FanRpmControl.cpp).
+// The fan speed percentage asked by the air quality control or the knob becomes a percentage of the max speed
+// measured by the calibration, so of the max air flow. Without calibration the duty cycle is applied as is
+class CFanRpmControl
+{
+  public:
+  CFanRpmControl(CFanCurve* curve) : _curve(curve) {}
+  // duty cycle to apply for this speed percentage: duty cycle of the target speed on the curve plus the correction
+  byte GetDutyCycle(byte speedPercent);
+  // called every FAN_SUPERVISOR_PERIOD_MS with the measured speed. The correction is only updated
+  // when the fan is settled at its duty cycle (see CFanSupervisor::IsSettled), and not during FAN_SPIN_UP_GRACE_MS
+  // after a change of the target speed larger than FAN_RPM_SETTLE_PERCENT, while the fan is still slowing down or speeding up
+  void Update(unsigned int rpm, bool settled);
+  // forgets the correction, called when the curve changes
+  void Reset() { _correctionQ8 = 0; }
+
+  unsigned int GetTargetRpm() { return _targetRpm; }
+  // duty cycle correction in %
+  int GetCorrection() { return _correctionQ8 / 256; }
+
+  private:
+  CFanCurve*   _curve;
+  unsigned int _targetRpm    = 0;
+  byte         _duty         = 0;       // last duty cycle returned
+  byte         _feedForward  = 0;       // duty cycle of the target speed on the curve
+  byte         _settleDuty   = 0;       // feed forward duty cycle when the fan last settled
+  unsigned int _settleTicks  = 0;       // Update() calls left before updating the correction again
+  long         _correctionQ8 = 0;       // duty cycle correction in 1/256 %
+};
+
+#endif
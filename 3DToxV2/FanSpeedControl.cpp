@@ -0,0 +1,118 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class computes the fan speed of the AUTO and QUIET modes from the averaged PM2.5.
+ // It replaces the air quality status to duty cycle maps: with the maps, a PM2.5 close to
+ // a level limit made the fan jump by 10 to 20% back and forth, each jump power cycling the fan.
+
+#include "FanSpeedControl.h"
+#include "Constants.h"
+
+int CFanSpeedControl::Update(const FanControlProfile &profile, int pm25Avg, byte boost)
+{
+  long minQ8 = (long)profile.MinDuty << 8;
+  long maxQ8 = (long)profile.MaxDuty << 8;
+
+  int error = 0;
+  if(pm25Avg >= 0)    // -1 while nothing has been measured
+  {
+    error = pm25Avg - profile.SetpointPm25;
+    if(error > profile.DeadBand)
+    {
+      error -= profile.DeadBand;
+    }
+    else if(error < -profile.DeadBand)
+    {
+      error += profile.DeadBand;
+    }
+    else
+    {
+      error = 0;
+    }
+  }
+
+  long proportionalQ8 = (long)profile.Kp * error;
+  long targetQ8       = minQ8 + proportionalQ8 + _integralQ8;
+
+  // anti windup: integrating only when it doesn't push further a saturated output
+  if(!(targetQ8 >= maxQ8 && error > 0) && !(targetQ8 <= minQ8 && error < 0))
+  {
+    _integralQ8 += (long)profile.Ki * error;
+  }
+  // the PM2.5 can't go much below the setpoint, so the integral slowly leaks once on target.
+  // Otherwise the fan would keep the speed reached during the last fumes forever
+  if(error == 0)
+  {
+    _integralQ8 -= _integralQ8 >> FAN_CONTROL_LEAK_SHIFT;
+  }
+  _integralQ8 = constrain(_integralQ8, 0, maxQ8 - minQ8);
+  targetQ8    = constrain(minQ8 + proportionalQ8 + _integralQ8, minQ8, maxQ8);
+
+  if(_started == false)
+  {
+    _outputQ8 = targetQ8;
+    _duty     = (int)((targetQ8 + 128) >> 8);
+    _started  = true;
+    return _duty;
+  }
+
+  // rate limiting
+  long maxRiseQ8 = (long)profile.MaxRise << 8;
+  long maxFallQ8 = (long)profile.MaxFall << 8;
+  if(targetQ8 > _outputQ8 + maxRiseQ8)
+  {
+    _outputQ8 += maxRiseQ8;
+  }
+  else if(targetQ8 < _outputQ8 - maxFallQ8)
+  {
+    _outputQ8 -= maxFallQ8;
+  }
+  else
+  {
+    _outputQ8 = targetQ8;
+  }
+  // the boost isn't rate limited: the fumes are caught before the averaged PM2.5 rises.
+  // Once released, the output goes down at MaxFall per second like any other decrease
+  long boostQ8 = min(minQ8 + ((long)boost << 8), maxQ8);
+  if(_outputQ8 < boostQ8)
+  {
+    _outputQ8 = boostQ8;
+  }
+  _outputQ8 = constrain(_outputQ8, minQ8, maxQ8);   // the profile may have changed with the mode
+
+  // hysteresis
+  int output = GetOutput();
+  if(abs(output - _duty) >= profile.Hysteresis
+    || (output != _duty && (output == profile.MinDuty || output == profile.MaxDuty))
+    || _duty < profile.MinDuty || _duty > profile.MaxDuty)
+  {
+    _duty = output;
+  }
+  return _duty;
+}
+
+void CFanSpeedControl::Reset()
+{
+  _started    = false;
+  _integralQ8 = 0;
+  _outputQ8   = 0;
+  _duty       = 0;
+}
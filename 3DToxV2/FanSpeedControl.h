@@ -0,0 +1,69 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FANSPEEDCONTROL
+#define _FANSPEEDCONTROL
+
+#include <Arduino.h>
+
+// Tuning of the fan speed controller for one air quality mode (see the profiles inside AQProfiles.cpp)
+// Kp and Ki are Q8 fixed point values: 256 means 1% of duty cycle
+typedef struct {
+  int  SetpointPm25;   // ug/m3, averaged PM2.5 the controller tries to keep
+  byte DeadBand;       // ug/m3, PM2.5 within +/- DeadBand of the setpoint counts as on target
+  int  Kp;             // duty % per ug/m3 above the setpoint (Q8)
+  int  Ki;             // duty % added each second per ug/m3 above the setpoint (Q8)
+  byte MinDuty;        // %, duty cycle on target
+  byte MaxDuty;        // %
+  byte MaxRise;        // %, max duty cycle increase per second
+  byte MaxFall;        // %, max duty cycle decrease per second
+  byte Hysteresis;     // %, smaller changes aren't applied, so PM noise doesn't keep moving the PWM and its ramp (see FanRamp.h) and the fan speed doesn't hunt
+  int  BoostSlope;     // ug/m3 per second (Q8), rising PM faster than this boosts the fan ahead of time (see PmTrend.h)
+  byte BoostDecay;     // %, boost released per second once the PM stops rising
+} FanControlProfile;
+
+// Proportional / integral fan speed controller driven by the averaged PM2.5, updated once per second.
+// - errors inside the dead band are ignored so the fan doesn't hunt around the setpoint
+// - the integral stops growing while the output is saturated (anti windup) and is bounded
+//   to the MinDuty..MaxDuty range, so it never needs to unwind after a long saturation.
+//   It leaks back to 0 while the PM2.5 is on target (FAN_CONTROL_LEAK_SHIFT)
+// - the output moves at most MaxRise / MaxFall per second
+// - a boost given by the PM trend raises the output right away, above MinDuty + boost
+// - the returned duty cycle only changes by Hysteresis steps, or when it reaches MinDuty / MaxDuty
+// Everything is computed in Q8 fixed point, without floating point
+class CFanSpeedControl
+{
+  public:
+  // returns the duty cycle to apply, in %. boost: %, added to MinDuty while the PM is rising fast
+  int Update(const FanControlProfile &profile, int pm25Avg, byte boost = 0);
+  void Reset();
+
+  int  GetOutput()   { return (int)((_outputQ8 + 128) >> 8); }   // before hysteresis
+  int  GetDuty()     { return _duty; }                           // after hysteresis
+  long GetIntegralQ8() { return _integralQ8; }
+
+  private:
+  bool _started    = false;
+  long _integralQ8 = 0;
+  long _outputQ8   = 0;
+  int  _duty       = 0;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class watches the fan speed. A stalled or blocked fan no longer removes the fumes,
+ // so it is kick started and a fault is latched, shown on the LCD, logged and saved inside EEPROM.
+ //   FAN_STOPPED ----(duty cycle requested)----> FAN_SPIN_UP
+ //   FAN_SPIN_UP ----(FAN_SPIN_UP_GRACE_MS elapsed)----> FAN_RUNNING, or FAN_STALLED if the fan doesn't turn
+ //   FAN_RUNNING ----(below FAN_DEGRADED_PERCENT of the expected speed for FAN_DEGRADED_CONFIRM_MS)----> FAN_DEGRADED
+ //   FAN_RUNNING, FAN_DEGRADED ----(below CRITICAL_SPEED for FAN_STALL_CONFIRM_MS)----> FAN_STALLED
+ //   FAN_STALLED ----(kick start)----> FAN_RECOVERING
+ //   FAN_RECOVERING ----(the fan turns)----> FAN_SPIN_UP, or FAN_STALLED for the next kick start
+ // A kick start switches the fan off for FAN_KICK_OFF_MS, which resets the stall protection of its driver,
+ // then drives it at 100% for FAN_KICK_MS. After FAN_KICK_ATTEMPTS failed kick starts the FAN_STALL fault
+ // is latched, the fan is kept at 100% and the kick starts are tried again every FAN_STALL_RETRY_MS.
+ // A fan degraded for FAN_BLOCKED_FAULT_MS latches the FAN_BLOCKED fault (clogged filter or blocked air path).
+ // The expected speed is read from the fan curve, linear until calibrated (see FanCurve.h).
+ // When the expected speed is below WARNING_SPEED, the fan may not turn at all so its speed isn't checked.
+ // With FAN_TACH_PERIOD, the speed reads below CRITICAL_SPEED 1s after the last tachometer pulse,
+ // so a stall is detected within 1s + FAN_STALL_CONFIRM_MS + FAN_SUPERVISOR_PERIOD_MS.
+
+#include "FanSupervisor.h"
+#include "EEPROM_functions.h"
+
+static const unsigned int FAN_SPIN_UP_GRACE_TICKS     = FAN_SPIN_UP_GRACE_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_STALL_CONFIRM_TICKS     = FAN_STALL_CONFIRM_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_DEGRADED_CONFIRM_TICKS  = FAN_DEGRADED_CONFIRM_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_KICK_OFF_TICKS          = FAN_KICK_OFF_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_KICK_TICKS              = FAN_KICK_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_STALL_RETRY_TICKS       = FAN_STALL_RETRY_MS / FAN_SUPERVISOR_PERIOD_MS;
+static const unsigned int FAN_BLOCKED_FAULT_TICKS     = FAN_BLOCKED_FAULT_MS / FAN_SUPERVISOR_PERIOD_MS;
+
+void CFanSupervisor::LoadFault()
+{
+  _fault      = (FanFault)EEPROM.read(EEPROM_FAN_FAULT_ADDR);
+  _faultCount = EEPROM.read(EEPROM_FAN_FAULT_COUNT_ADDR);
+  if(_fault >= FAN_FAULT_COUNT)   // never written
+  {
+    _fault      = FAN_OK;
+    _faultCount = 0;
+  }
+}
+
+void CFanSupervisor::Update(byte requestedDuty, unsigned int rpm)
+{
+  _stateTicks++;
+  if(requestedDuty == 0)
+  {
+    if(_state != FAN_STOPPED)
+    {
+      SetState(FAN_STOPPED);
+    }
+    return;
+  }
+
+  byte duty = GetDutyCycle(requestedDuty);
+  if(duty > _lastDuty)
+  {
+    _settleTicks = FAN_SPIN_UP_GRACE_TICKS;     // the fan needs some time to speed up
+  }
+  else if(_settleTicks > 0)
+  {
+    _settleTicks--;
+  }
+  _lastDuty = duty;
+
+  unsigned int expectedRpm = GetExpectedRpm(duty);
+  bool supervised = expectedRpm >= WARNING_SPEED;
+  bool slow = supervised && _settleTicks == 0 && rpm < (unsigned long)expectedRpm * FAN_DEGRADED_PERCENT / 100;
+  _stallTicks = (supervised && rpm < CRITICAL_SPEED) ? _stallTicks + 1 : 0;
+  _slowTicks  = slow ? _slowTicks + 1 : 0;
+  _okTicks    = (slow || _settleTicks > 0) ? 0 : _okTicks + 1;
+
+  switch(_state)
+  {
+    case FAN_STOPPED:
+      SetState(FAN_SPIN_UP);
+      break;
+    case FAN_SPIN_UP:
+      if(_stateTicks >= FAN_SPIN_UP_GRACE_TICKS)
+      {
+        SetState(_stallTicks > 0 ? FAN_STALLED : FAN_RUNNING);
+      }
+      break;
+    case FAN_RUNNING:
+    case FAN_DEGRADED:
+      if(_stallTicks >= FAN_STALL_CONFIRM_TICKS)
+      {
+        SetState(FAN_STALLED);
+      }
+      else if(_state == FAN_RUNNING && _slowTicks >= FAN_DEGRADED_CONFIRM_TICKS)
+      {
+        SetState(FAN_DEGRADED);
+      }
+      else if(_state == FAN_DEGRADED && _okTicks >= FAN_DEGRADED_CONFIRM_TICKS)
+      {
+        SetState(FAN_RUNNING);
+      }
+      else if(_state == FAN_DEGRADED && _stateTicks == FAN_BLOCKED_FAULT_TICKS)
+      {
+        LatchFault(FAN_BLOCKED);
+      }
+      break;
+    case FAN_STALLED:
+      if(_kickAttempts < FAN_KICK_ATTEMPTS || _stateTicks >= FAN_STALL_RETRY_TICKS)
+      {
+        if(_kickAttempts >= FAN_KICK_ATTEMPTS)
+        {
+          _kickAttempts = 0;
+        }
+        SetState(FAN_RECOVERING);
+      }
+      break;
+    case FAN_RECOVERING:
+      if(_stateTicks < FAN_KICK_OFF_TICKS + FAN_KICK_TICKS)
+      {
+        break;
+      }
+      if(rpm >= CRITICAL_SPEED)
+      {
+        _recoveries++;
+        _kickAttempts = 0;
+        SetState(FAN_SPIN_UP);
+        break;
+      }
+      SetState(FAN_STALLED);
+      if(_kickAttempts >= FAN_KICK_ATTEMPTS)
+      {
+        LatchFault(FAN_STALL);
+      }
+      break;
+  }
+}
+
+// the fan is switched off then driven at 100% while kick started
+byte CFanSupervisor::GetDutyCycle(byte requestedDuty)
+{
+  if(requestedDuty == 0)
+  {
+    return 0;
+  }
+  if(_state == FAN_RECOVERING)
+  {
+    return _stateTicks < FAN_KICK_OFF_TICKS ? 0 : 100;
+  }
+  if(_state == FAN_STALLED)
+  {
+    return 100;     // the fan may start again by itself, at full speed to remove the fumes accumulated meanwhile
+  }
+  return requestedDuty;
+}
+
+void CFanSupervisor::ClearFault()
+{
+  _fault = FAN_OK;
+  CEEPROM::SafeWriteEEPROMData(EEPROM_FAN_FAULT_ADDR, _fault);
+}
+
+void CFanSupervisor::SetState(FanState state)
+{
+  switch(state)
+  {
+    case FAN_STALLED:
+      if(_state != FAN_RECOVERING)
+      {
+        _stalls++;
+        _lastStallMs = millis();
+      }
+      break;
+    case FAN_RECOVERING:
+      _kickAttempts++;
+      _kicks++;
+      break;
+    case FAN_STOPPED:
+      _kickAttempts = 0;
+      _settleTicks  = 0;
+      _lastDuty     = 0;
+      break;
+    default:
+      break;
+  }
+  _state      = state;
+  _stateTicks = 0;
+  _stallTicks = 0;
+  _slowTicks  = 0;
+  _okTicks    = 0;
+}
+
+// the fault and the amount of faults are only written when a new fault is latched
+void CFanSupervisor::LatchFault(FanFault fault)
+{
+  if(_fault == fault)
+  {
+    return;
+  }
+  _fault = fault;
+  if(_faultCount < 255)
+  {
+    _faultCount++;
+  }
+  CEEPROM::SafeWriteEEPROMData(EEPROM_FAN_FAULT_ADDR, _fault);
+  CEEPROM::SafeWriteEEPROMData(EEPROM_FAN_FAULT_COUNT_ADDR, _faultCount);
+}
@@ -0,0 +1,113 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FANSUPERVISOR
+#define _FANSUPERVISOR
+
+#include <Arduino.h>
+#include "utility.h"
+#include "Constants.h"
+#include "FanCurve.h"
+
+// state of the fan checked by CFanSupervisor
+//have enum in sync and being able to get string from enum name
+#define FOREACH_FAN_STATE(STATE) \
+        STATE(FAN_STOPPED)   \
+        STATE(FAN_SPIN_UP)   \
+        STATE(FAN_RUNNING)   \
+        STATE(FAN_DEGRADED)   \
+        STATE(FAN_STALLED)   \
+        STATE(FAN_RECOVERING)   \
+
+enum FanState {
+    FOREACH_FAN_STATE(GENERATE_ENUM)
+};
+
+static const char *FAN_STATE_STRING[] = {
+    FOREACH_FAN_STATE(GENERATE_STRING)
+};
+
+// fault latched by CFanSupervisor, kept inside EEPROM until cleared with the FANFAULT CLEAR console command
+//have enum in sync and being able to get string from enum name
+#define FOREACH_FAN_FAULT(FAULT) \
+        FAULT(FAN_OK)   \
+        FAULT(FAN_STALL)   \
+        FAULT(FAN_BLOCKED)   \
+
+enum FanFault {
+    FOREACH_FAN_FAULT(GENERATE_ENUM)
+    FAN_FAULT_COUNT
+};
+
+static const char *FAN_FAULT_STRING[] = {
+    FOREACH_FAN_FAULT(GENERATE_STRING)
+};
+
+// Compares the measured fan speed with the speed expected from the applied duty cycle
+// and kick starts a stalled fan (see FanSupervisor.cpp)
+class CFanSupervisor
+{
+  public:
+  CFanSupervisor(CFanCurve* curve) : _curve(curve) {}
+  // reading back the latched fault. Should be called after the EEPROM version has been checked
+  void LoadFault();
+  // called every FAN_SUPERVISOR_PERIOD_MS with the duty cycle requested by the air quality control and the measured speed
+  void Update(byte requestedDuty, unsigned int rpm);
+  // duty cycle to apply to the fan: the requested one, or the kick start pulse while recovering
+  byte GetDutyCycle(byte requestedDuty);
+  // fan speed expected at this duty cycle, read from the fan curve
+  unsigned int GetExpectedRpm(byte duty) { return _curve->GetRpm(duty); }
+  // true when the fan runs at the speed of its duty cycle, neither starting nor speeding up
+  bool IsSettled() { return _state == FAN_RUNNING && _settleTicks == 0; }
+
+  FanState GetState() { return _state; }
+  FanFault GetFault() { return _fault; }
+  // amount of faults latched since the EEPROM fault slot was first written (255 max)
+  byte GetFaultCount() { return _faultCount; }
+  void ClearFault();
+  // amount of stalls detected, kick starts tried and stalls recovered since startup
+  unsigned int GetStallCount() { return _stalls; }
+  unsigned int GetKickCount() { return _kicks; }
+  unsigned int GetRecoveryCount() { return _recoveries; }
+  // millis() when the last stall was detected, 0 if none
+  unsigned long GetLastStallMs() { return _lastStallMs; }
+
+  private:
+  void SetState(FanState state);
+  void LatchFault(FanFault fault);
+
+  CFanCurve*    _curve;
+  FanState      _state         = FAN_STOPPED;
+  unsigned int  _stateTicks    = 0;       // Update() calls inside the current state
+  unsigned int  _stallTicks    = 0;       // consecutive Update() calls below CRITICAL_SPEED
+  unsigned int  _slowTicks     = 0;       // consecutive Update() calls below FAN_DEGRADED_PERCENT of the expected speed
+  unsigned int  _okTicks       = 0;       // consecutive Update() calls at the expected speed
+  unsigned int  _settleTicks   = 0;       // speed checks paused after a duty cycle increase
+  byte          _lastDuty      = 0;
+  byte          _kickAttempts  = 0;       // kick starts tried for the current stall
+  FanFault      _fault         = FAN_OK;
+  byte          _faultCount    = 0;
+  unsigned int  _stalls        = 0;
+  unsigned int  _kicks         = 0;
+  unsigned int  _recoveries    = 0;
+  unsigned long _lastStallMs   = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Input recorder: every external input (sensor frames, 3D printer replies, knob, fan tachometer,
+ // SD card detection) is stored with its timestamp into a compact binary trace.
+ // Replaying the trace inside the host build goes through the same parsing and control code,
+ // so a field issue can be reproduced at the desk. The record format is described inside InputRecorder.h
+ // This file is empty unless INPUT_RECORDER is defined inside config.h
+
+#include "InputRecorder.h"
+
+#ifdef INPUT_RECORDER
+
+byte          CInputRecorder::_buffer[INPUT_TRACE_BUFFER_SIZE];
+unsigned int  CInputRecorder::_length       = 0;
+unsigned long CInputRecorder::_lastRecordMs = 0;
+unsigned int  CInputRecorder::_dropped      = 0;
+byte          CInputRecorder::_lastSdDetect = 0xFF;
+
+void CInputRecorder::Begin()
+{
+  const byte session[] = { 'T', 'R', INPUT_TRACE_VERSION };
+  Record(itSESSION, session, sizeof(session));
+}
+
+void CInputRecorder::Record(byte type, const void *data, byte length)
+{
+  Append(type, false, data, length);
+}
+
+void CInputRecorder::RecordBytes(byte type, const void *data, byte length)
+{
+  Append(type, true, data, length);
+}
+
+void CInputRecorder::RecordTach(unsigned int pulses, unsigned int periodMs)
+{
+  const byte payload[] = { lowByte(pulses), highByte(pulses), lowByte(periodMs), highByte(periodMs) };
+  Record(itTACH, payload, sizeof(payload));
+}
+
+void CInputRecorder::RecordSdDetect(byte level)
+{
+  if(level == _lastSdDetect)
+  {
+    return;
+  }
+  _lastSdDetect = level;
+  Record(itSD_DETECT, &level, 1);
+}
+
+// the whole record is dropped if it doesn't fit, the next time delta then includes the dropped one
+void CInputRecorder::Append(byte type, bool withLength, const void *data, byte length)
+{
+  unsigned long now   = millis();
+  unsigned long delta = now - _lastRecordMs;
+  byte header[7];
+  byte headerLength = 0;
+  header[headerLength++] = type;
+  do
+  {
+    byte value = delta & 0x7F;
+    delta >>= 7;
+    if(delta != 0)
+    {
+      value |= 0x80;                      // more bytes follow
+    }
+    header[headerLength++] = value;
+  } while(delta != 0);
+  if(withLength)
+  {
+    header[headerLength++] = length;
+  }
+
+  if(_length + headerLength + length > INPUT_TRACE_BUFFER_SIZE)
+  {
+    _dropped++;
+    return;
+  }
+  memcpy(&_buffer[_length], header, headerLength);
+  memcpy(&_buffer[_length + headerLength], data, length);
+  _length      += headerLength + length;
+  _lastRecordMs = now;
+}
+
+void CInputRecorder::Flush(Print &output)
+{
+  output.write(_buffer, _length);
+  _length = 0;
+}
+
+#endif
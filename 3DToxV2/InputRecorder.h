@@ -0,0 +1,89 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INPUTRECORDER
+#define _INPUTRECORDER
+
+#include <Arduino.h>
+#include "config.h"
+#include "Constants.h"
+
+// Version of the trace format, stored inside each session record
+const byte INPUT_TRACE_VERSION = 2;
+
+// Kind of external input stored inside the trace.
+// Each record is: type (1 byte) | time since the previous record in ms (varint, 7 bits per byte, low bits first) | payload
+enum eInputTraceRecord
+{
+  itSESSION,      // firmware start, the time is millis() at startup. payload: 'T' 'R' INPUT_TRACE_VERSION
+  itPMS_DATA,     // bytes read from the inlet sensor by CPm25::ReadValues. payload: length + bytes
+  itCOM_REPLY,    // line received by HandleComMessages after M105. payload: length + text
+  itCOM_TIMEOUT,  // no line received by HandleComMessages. no payload
+  itKNOB,         // knob event applied by HandleRotaryEncoder. payload: InputEvent (type + steps)
+  itTACH,         // fan speed measurement of FanController::getSpeed. payload: pulses + period in ms (uint16 little endian)
+  itSD_DETECT,    // SD card detect pin level change. payload: level
+  itPMS_OUTLET_DATA // bytes read from the outlet sensor by CPm25::ReadValues (DUAL_PMS). payload: length + bytes
+};
+
+#ifdef INPUT_RECORDER
+
+// Records every external input of the firmware with its timestamp into a RAM buffer.
+// The buffer is appended to INPUT_TRACE_FILE on the SD card once per second (see FlushInputTrace in main.cpp)
+// The host build replays the trace with the --replay option to reproduce a field behaviour
+class CInputRecorder
+{
+  public:
+  // writes the session record. called once at startup
+  static void Begin();
+  static void Record(byte type, const void *data, byte length);
+  // same as Record() for variable size payloads, the length is stored before the data
+  static void RecordBytes(byte type, const void *data, byte length);
+  static void RecordTach(unsigned int pulses, unsigned int periodMs);
+  // only the level changes are recorded
+  static void RecordSdDetect(byte level);
+
+  static bool IsEmpty() { return _length == 0; }
+  // writes the buffered records to output and empties the buffer
+  static void Flush(Print &output);
+  // amount of records lost because the buffer couldn't be written to the SD card in time
+  static unsigned int GetDroppedCount() { return _dropped; }
+
+  private:
+  static void Append(byte type, bool withLength, const void *data, byte length);
+
+  static byte          _buffer[INPUT_TRACE_BUFFER_SIZE];
+  static unsigned int  _length;
+  static unsigned long _lastRecordMs;
+  static unsigned int  _dropped;
+  static byte          _lastSdDetect;
+};
+
+#define RECORD_INPUT(type, data, length)       CInputRecorder::Record(type, data, length)
+#define RECORD_INPUT_BYTES(type, data, length) CInputRecorder::RecordBytes(type, data, length)
+
+#else
+
+// recorder compiled out: nothing is recorded
+#define RECORD_INPUT(type, data, length)       do { } while(0)
+#define RECORD_INPUT_BYTES(type, data, length) do { } while(0)
+
+#endif
+
+#endif
@@ -25,6 +25,8 @@
 #include "ViewMain.h"
 #include "ModeView.h"
 #include "BaudrateView.h"
+#include "ProfileView.h"
+#include "Pm25.h"
 #include "EEPROM_functions.h"
 
 // -------------------- Main Settings View screen----------------
@@ -47,6 +49,11 @@ void MainSettingsView::Up()
   {
     MenuSelectedIndex = (MAX_MENU_ITEMS - 1);
   }
+  if(MenuSelectedIndex > viewWindowMaxIndex)              // scrolling the visible window, there are more menus than lines
+  {
+    viewWindowMinIndex += 1;
+    viewWindowMaxIndex += 1;
+  }
 
   _needUpdate = true;                                      // tag the screen to be updated
   Refresh();                                               // force refresh
@@ -59,6 +66,11 @@ void MainSettingsView::Down()
   if(MenuSelectedIndex < 0)                               // making sure the index doesn't go negative
   {
     MenuSelectedIndex = 0;
+  }
+  if(MenuSelectedIndex < viewWindowMinIndex)
+  {
+    viewWindowMinIndex -= 1;
+    viewWindowMaxIndex -= 1;
   }
     _needUpdate = true;
     Refresh();
@@ -78,7 +90,10 @@ ViewBase* MainSettingsView::Select()
     case 2:                                             // Get inside the Baudrate settings
         return new BaudrateView();
         break;
-    case 3:                                             // Save current settings to EEPROM
+    case 3:                                             // Get inside the air quality profile settings
+        return new ProfileView();
+        break;
+    case 4:                                             // Save current settings to EEPROM
       {
           //-------------------------Save baudrate---------------------
           byte BaudrateMode = 0;
@@ -97,6 +112,7 @@ ViewBase* MainSettingsView::Select()
           // writing data to EEPROM
           CEEPROM::SafeWriteEEPROMData(EEPROM_MODE, AQModeMode);
           CEEPROM::SafeWriteEEPROMData(EEPROM_BAUDRATE, BaudrateMode);
+          CEEPROM::SafeWriteEEPROMData(EEPROM_AQ_PROFILE_ADDR, _config->_pm25->GetAQProfileIndex());
       }
       return new ViewMain();
     default:
@@ -34,8 +34,8 @@ void Down() override;
 ViewBase* Select() override;
 void Refresh() override;
 
- static const int MAX_MENU_ITEMS = 4;
- char *MenuLabels[MAX_MENU_ITEMS] = {"..", "Select Mode","Bauderate", "Save"}; // possible menus to display
+ static const int MAX_MENU_ITEMS = 5;
+ char *MenuLabels[MAX_MENU_ITEMS] = {"..", "Select Mode","Bauderate", "Filter profile", "Save"}; // possible menus to display
 
 };
 #endif  //_VIEWMAINSETTINGS
@@ -20,19 +20,24 @@
 
 #include <Arduino.h>
 #include "Pm25.h"
+#include "InputRecorder.h"
+#include "Constants.h"
+#include "config.h"
 
 // THis class is dedicated into managing the PM25 air quality sensor
 
-CPm25::CPm25(int pin_set, int pin_reset)
+CPm25::CPm25(HardwareSerial* serial, int pin_set, int pin_reset, byte recordType)
 {
-  SET_PIN   = pin_set;
-  RESET_PIN = pin_reset;
+  _hSerial    = serial;
+  _recordType = recordType;
+  SET_PIN     = pin_set;
+  RESET_PIN   = pin_reset;
 
-  Serial3.begin(9600);         // using serial3 that is mapped on special pins
-  Serial3.setTimeout(1500);    // set the Timeout to 1500ms, longer than the data transmission periodic time of the sensor
+  _hSerial->begin(9600);       // the sensor sends its frames at 9600 bauds
   pinMode(SET_PIN, OUTPUT);    // 1 = the module works in continuous sampling mode, it will upload the sample data after the end of each sampling. (The sampling response time is 1000ms)
                                // 0, the module enters a low-power standby mode.
   pinMode(RESET_PIN, OUTPUT);
+  SetAQProfile(CLEAN_FILTER);
   WakeUp();                    // waking up the device
 }
 
@@ -41,186 +46,235 @@ void CPm25::Sleep()
 {
  digitalWrite(SET_PIN, LOW);
  digitalWrite(RESET_PIN, HIGH);
+ _sleeping = true;
 }
 
 // enable the device
+// the link health restarts from the wake up, the time spent sleeping isn't a missing frame
 void CPm25::WakeUp()
 {
  digitalWrite(SET_PIN, HIGH);
  digitalWrite(RESET_PIN, HIGH);
+ _sleeping    = false;
+ _lastFrameMs = millis();
+ _trend.Clear();              // the values measured before sleeping are too old to compute a slope
 }
 
 // read the data from RX buffer, automatically sent by the sensor
+// only the bytes already received are parsed, a frame received in several parts is completed on the next calls.
+// At most one receive buffer (PMS_READ_CHUNK) is parsed per call, the bytes received meanwhile wait for the next call
 void CPm25::ReadValues()
 {
-  if (Serial3.available() == 0)           // check if we received data from the sensor
+  byte chunk[PMS_READ_CHUNK];
+  byte length = 0;
+  while(length < PMS_READ_CHUNK && _hSerial->available() > 0)   // check if we received data from the sensor
   {
-    return;
+    chunk[length++] = _hSerial->read();
+  }
+  if(length > 0)
+  {
+    RECORD_INPUT_BYTES(_recordType, chunk, length);
   }
 
-  // when the sensor is sending data, the stream will start by 0x424d
-  if( Serial3.find(0x42) )                // first starting byte 0x42
+  for(byte i = 0; i < length; i++)
   {
-      Serial3.readBytes(buf,LENG);
+    if(_parser.Parse(chunk[i]))
+    {
+      OnValidFrame(millis());
+      ApplyFrame(_parser.GetFrame());
+    }
+  }
+  UpdateLinkState(millis());
+}
 
-      if(buf[0] == 0x4d)                  // 2nd starting byte
-      {
-        if(checkValue(buf,LENG))
-        {
-          PM01Value  = transmitPM01(buf); //count PM1.0 value of the air detector module
-          PM2_5Value = transmitPM2_5(buf);//count PM2.5 value of the air detector module
-          PM10Value  = transmitPM10(buf); //count PM10 value of the air detector module
+void CPm25::OnValidFrame(unsigned long now)
+{
+  unsigned long gapMs = now - _lastFrameMs;
+  if(gapMs > _maxFrameGapMs)
+  {
+    _maxFrameGapMs = gapMs;
+  }
+  _lastFrameMs = now;
+}
 
-          // each type of data is stored inside dedicated lists.
-          // These lists will be averaged in order to smooth the device reaction
-          updateList(&ListAvgPM01 , PM01Value );
-          updateList(&ListAvgPM2_5, PM2_5Value);
-          updateList(&ListAvgPM10 , PM10Value );
-        }
-      }
-    }
+unsigned long CPm25::GetErrorCount()
+{
+  return (unsigned long)_parser.GetChecksumErrors() + _parser.GetFramingErrors() + _parser.GetShortReads();
 }
 
-// storing new measurement into a fifo
-void CPm25::updateList(LinkedList<int> *list, int newValue)
+// called after each read of the sensor data:
+// - LINK_FAILED: no valid frame for PMS_LINK_FAILED_GAP_MS, the sensor or its cable is dead
+// - LINK_DEGRADED: no valid frame for PMS_LINK_DEGRADED_GAP_MS, or more than PMS_LINK_DEGRADED_ERROR_PERCENT
+//   of the frames were damaged during the last PMS_LINK_WINDOW_MS window (noisy cable, dying sensor)
+// The state is kept while the sensor sleeps
+void CPm25::UpdateLinkState(unsigned long now)
 {
-  if(list == NULL)
+  if(_sleeping)
   {
     return;
   }
-  if(newValue == -1)
+  if(now - _windowStartMs >= PMS_LINK_WINDOW_MS)
   {
-    return;
+    unsigned long frames = _parser.GetFrameCount() - _windowFrames;
+    unsigned long errors = GetErrorCount() - _windowErrors;
+    _windowDegraded = errors * 100 > (frames + errors) * PMS_LINK_DEGRADED_ERROR_PERCENT;
+    _windowFrames   = _parser.GetFrameCount();
+    _windowErrors   = GetErrorCount();
+    _windowStartMs  = now;
+  }
+
+  unsigned long frameAgeMs = now - _lastFrameMs;
+  if(frameAgeMs > PMS_LINK_FAILED_GAP_MS)
+  {
+    _linkState = LINK_FAILED;
+  }
+  else if(frameAgeMs > PMS_LINK_DEGRADED_GAP_MS || _windowDegraded)
+  {
+    _linkState = LINK_DEGRADED;
   }
-  if(list->size() >= AVG_LIST_SAMPLE_SIZE)
+  else
   {
-    list->remove(0);//remove the first item
+    _linkState = LINK_OK;
   }
-    list->add(newValue);//add new item at the end
 }
 
-// computing and checking CRC of the received data from the sensor
-char CPm25::checkValue(unsigned char *thebuf, char len)
+void CPm25::GetLinkStatistics(PmsLinkStatistics &statistics)
 {
-  char receiveflag = 0;
-  int receiveSum   = 0;
+  statistics.State          = _linkState;
+  statistics.Frames         = _parser.GetFrameCount();
+  statistics.ChecksumErrors = _parser.GetChecksumErrors();
+  statistics.FramingErrors  = _parser.GetFramingErrors();
+  statistics.Resyncs        = _parser.GetResyncs();
+  statistics.ShortReads     = _parser.GetShortReads();
+  statistics.DiscardedBytes = _parser.GetDiscardedBytes();
+  statistics.MaxFrameGapMs  = _maxFrameGapMs;
+}
 
-  for(int i = 0; i < (len - 2); i++)
+// storing the whole frame, the CF=1 concentrations also feed the smoothing filters
+void CPm25::ApplyFrame(const PmsFrame &frame)
+{
+  if(frame.WordCount < 3 || _warmingUp)
   {
-    receiveSum = receiveSum + thebuf[i];
+    return;
   }
-  receiveSum = receiveSum + 0x42;
+  DecodeFrame(frame, _sample);
+  _hasSample = true;
 
-  if(receiveSum == ((thebuf[len - 2] << 8) + thebuf[len - 1]))  //check CRC the serial data
-  {
-    receiveSum  = 0;
-    receiveflag = 1;
-  }
-  return receiveflag;
+  // each type of data is added to a dedicated smoothing filter (PM_FILTER)
+  // in order to smooth the device reaction
+  updateAverage(&AvgPM01 , _sample.Pm01Cf1);
+  updateAverage(&AvgPM2_5, _sample.Pm25Cf1);
+  updateAverage(&AvgPM10 , _sample.Pm10Cf1);
+  _trend.Add(_sample.Pm25Cf1, _sample.Pm01Cf1);
 }
 
-// extracting PM01 value from the received buffer
-int CPm25::transmitPM01(unsigned char *thebuf)
+// PMS1003 data words, in frame order:
+// PM1.0, PM2.5, PM10 CF=1 | PM1.0, PM2.5, PM10 atmospheric | particles beyond 0.3, 0.5, 1.0, 2.5, 5.0, 10um | reserved
+// The fields of PmsSample follow the same order, words missing from a shorter frame are set to 0
+void CPm25::DecodeFrame(const PmsFrame &frame, PmsSample &sample)
 {
-  int PM01Val;
-  PM01Val = ((thebuf[3] << 8) + thebuf[4]); //count PM1.0 value of the air detector module
-  return PM01Val;
+  uint16_t words[PMS_MAX_DATA_WORDS];
+  for(byte i = 0; i < PMS_MAX_DATA_WORDS; i++)
+  {
+    words[i] = i < frame.WordCount ? frame.Words[i] : 0;
+  }
+  sample.ReceivedMs = millis();
+  sample.Pm01Cf1    = words[0];
+  sample.Pm25Cf1    = words[1];
+  sample.Pm10Cf1    = words[2];
+  sample.Pm01Atm    = words[3];
+  sample.Pm25Atm    = words[4];
+  sample.Pm10Atm    = words[5];
+  for(byte bin = 0; bin < PMS_PARTICLE_BINS; bin++)
+  {
+    sample.Particles[bin] = words[6 + bin];
+  }
+  sample.Reserved   = words[12];
 }
 
-// extracting PM2.5 value from the received buffer
-int CPm25::transmitPM2_5(unsigned char *thebuf)
+// storing new measurement into the smoothing filter
+void CPm25::updateAverage(PmFilter *average, int newValue)
 {
-  int PM2_5Val;
-  PM2_5Val = ((thebuf[5] << 8) + thebuf[6]);//count PM2.5 value of the air detector module
-  return PM2_5Val;
+  if(newValue == -1)
+  {
+    return;
   }
-
-// extracting PM10 value from the received buffer
-int CPm25::transmitPM10(unsigned char *thebuf)
-{
-  int PM10Val;
-  PM10Val = ((thebuf[7] << 8) + thebuf[8]); //count PM10 value of the air detector module
-  return PM10Val;
+  average->Add(newValue);
 }
 
-// Extrapolating Fan speed based on current Air quality
-// Depending on the current working mode, th efan speed will vary
-int CPm25::GetSpeedBasedOnAQMode(AirQualityMODE mode,AirQualityStatus status )
+// Computing the Fan speed based on current Air quality
+// Depending on the current working mode, the fan speed controller uses a different tuning
+int CPm25::GetSpeedBasedOnAQMode(AirQualityMODE mode, int pm25Avg)
 {
   switch(mode)
   {
     case AUTO:
     case MANUAL:// in manual mode this speed is just ignored
-        return FindFanSpeedInsideFanSpeedTranslationMap(&NormalFanSpeedMap[0], status);
+        return GetControlledSpeed(_aqProfile.NormalFanControl, pm25Avg);
     case QUIET:
-        return FindFanSpeedInsideFanSpeedTranslationMap(&QuietFanSpeedMap[0], status);
+        return GetControlledSpeed(_aqProfile.QuietFanControl, pm25Avg);
     default: //other undifined modes
       return 100;
     break;
   }
 }
 
-// Using Mapping to extract fan speed based on air quality status
-// It's very easy to add more speed profiles by adding a new map inside Pm25.h and linking it into function GetSpeedBasedOnAQMode
-int CPm25::FindFanSpeedInsideFanSpeedTranslationMap(IntTranslationMap *map, AirQualityStatus status)
+// without any sensor value, the air can't be considered clean: running the fan at the max speed of the mode
+int CPm25::GetControlledSpeed(const FanControlProfile &profile, int pm25Avg)
 {
-  for (int i = 0; i < MAPSIZE; i++)
+  if(_linkState == LINK_FAILED)
   {
-    if(map[i].key == status)
-    {
-      return map[i].value;
-    }
+    return profile.MaxDuty;
   }
+#ifdef PM_TREND_BOOST
+  return _fanSpeedControl.Update(profile, pm25Avg, _trend.UpdateBoost(profile));
+#else
+  return _fanSpeedControl.Update(profile, pm25Avg);
+#endif
 }
 
-// dedicated function to convert Pm values 2.5 into AirQuality level
-// this level can be adjusted inside PM2.5.h
-AirQualityStatus CPm25::ConvertPM2_5ToAirQualityStatus(int PM_25_Value)
+// the fan speed controller restarts from the min duty cycle of the new levels
+void CPm25::SetAQProfile(byte index)
 {
-  return ComputePm25ToAirQualitStatus(&Pm25ToAirQualityStatusMap[0], PM_25_Value);
+  if(index >= AQ_PROFILE_COUNT)
+  {
+    index = CLEAN_FILTER;
+  }
+  _aqProfileIndex = index;
+  LoadAQProfile(index, _aqProfile);
+  _fanSpeedControl.Reset();
 }
 
-AirQualityStatus CPm25::ComputePm25ToAirQualitStatus(IntTranslationMap *map, int pm25)
+// dedicated function to convert Pm values 2.5 into AirQuality level
+// the levels come from the selected profile: the status is the amount of limits below the value,
+// found by a binary search whose steps only select a pointer (no data dependent branch, same duration for every value)
+AirQualityStatus CPm25::ConvertPM2_5ToAirQualityStatus(int PM_25_Value)
 {
-  for( int i = 0; i < MAPSIZE - 1; i++)
+  const int *base = _aqProfile.Limits;
+  byte count = AQ_LIMIT_COUNT;
+  while(count > 1)
   {
-    if(pm25 <= map[i].key)
-    {
-      return map[i].value;
-    }
+    byte half = count / 2;
+    base   = (base[half - 1] < PM_25_Value) ? base + half : base;
+    count -= half;
   }
-  return map[MAPSIZE - 1].value; //default value
+  return (AirQualityStatus)((base - _aqProfile.Limits) + (base[0] < PM_25_Value));   // HAZARDOUS above the last limit
 }
 
 int CPm25::GetAvgPM01()
 {
-  return GetAvgPM(&ListAvgPM01);
+  return AvgPM01.GetValue(-1);
 }
 int CPm25::GetAvgPM2_5()
 {
-  return GetAvgPM(&ListAvgPM2_5);
+  return AvgPM2_5.GetValue(-1);
 }
 int CPm25::GetAvgPM10()
 {
-  return GetAvgPM(&ListAvgPM10);
+  return AvgPM10.GetValue(-1);
 }
 
-int CPm25::GetAvgPM(LinkedList<int> *list)
-{
-  int listSize = list->size();
-  if(listSize == 0)
-  {
-    return -1;
-  }
-
-  long sum = 0;
-  for( int i = 0; i < listSize; i++)
-  {
-     sum += list->get(i);
-  }
-  return (int)(sum / listSize);
-}
 int CPm25::GetAvgListSize()
 {
-  return ListAvgPM2_5.size();
+  return AvgPM2_5.GetCount();
 }
@@ -22,40 +22,54 @@
 #define _PM25
 
 #include <Arduino.h>
-#include "LinkedList.h"
+#include "PmFilters.h"
 #include "utility.h"
+#include "PmsParser.h"
+#include "FanSpeedControl.h"
+#include "AQProfiles.h"
+#include "PmTrend.h"
+
+#define PMS_READ_CHUNK 64   // max bytes read from the sensor serial port per call, the size of its receive buffer
+// smoothing filter applied to the PM values in order to smooth the device reaction (see PmFilters.h)
+// each setting can be overridden from the build flags
+#ifndef PM_FILTER
+  #define PM_FILTER          PM_FILTER_MEAN
+#endif
+#ifndef PM_AVERAGE_WINDOW
+  #define PM_AVERAGE_WINDOW  10   // PM_FILTER_MEAN: amount of sensor frames averaged (max 255)
+#endif
+#ifndef PM_EWMA_SHIFT
+  #define PM_EWMA_SHIFT      2    // PM_FILTER_EWMA: each new frame weights 1/2^PM_EWMA_SHIFT
+#endif
+#ifndef PM_MEDIAN_WINDOW
+  #define PM_MEDIAN_WINDOW   5    // PM_FILTER_MEDIAN: amount of frames the median is taken from
+#endif
+#ifndef PM_TRIMMED_WINDOW
+  #define PM_TRIMMED_WINDOW  7    // PM_FILTER_TRIMMED_MEAN: amount of frames averaged...
+#endif
+#ifndef PM_TRIMMED_COUNT
+  #define PM_TRIMMED_COUNT   1    // ...without their PM_TRIMMED_COUNT lowest and highest values
+#endif
+#ifndef PM_ATTACK_SHIFT
+  #define PM_ATTACK_SHIFT    1    // PM_FILTER_ASYMMETRIC: weight 1/2^PM_ATTACK_SHIFT of a rising frame
+#endif
+#ifndef PM_DECAY_SHIFT
+  #define PM_DECAY_SHIFT     4    // PM_FILTER_ASYMMETRIC: weight 1/2^PM_DECAY_SHIFT of a falling frame
+#endif
 
-#define LENG 31   //0x42 + 31 bytes equal to 32 bytes
-#define AVG_LIST_SAMPLE_SIZE  10
-#define FILTER_INSTALLED
-
-//set of values without filter
-//values from https://docs-emea.rs-online.com/webdocs/1665/0900766b816656b2.pdf Page 9
-#ifndef FILTER_INSTALLED
-  #define SENSITIVITY 10/10
-
-  #define VERY_GOOD_VALUE 10
-  #define GOOD_VALUE 50
-  #define MODERATE_VALUE 100
-  #define BAD_VALUE 150
-  #define UNHEALTHY_VALUE 200
-  #define VERY_UNHEALTHY_VALUE 300
-  #define HAZARDOUS_VALUE 500
+#if PM_FILTER == PM_FILTER_MEAN
+  typedef CMeanFilter<PM_AVERAGE_WINDOW> PmFilter;
+#elif PM_FILTER == PM_FILTER_EWMA
+  typedef CEwmaFilter<PM_EWMA_SHIFT> PmFilter;
+#elif PM_FILTER == PM_FILTER_MEDIAN
+  typedef CMedianFilter<PM_MEDIAN_WINDOW> PmFilter;
+#elif PM_FILTER == PM_FILTER_TRIMMED_MEAN
+  typedef CTrimmedMeanFilter<PM_TRIMMED_WINDOW, PM_TRIMMED_COUNT> PmFilter;
+#elif PM_FILTER == PM_FILTER_ASYMMETRIC
+  typedef CAsymmetricFilter<PM_ATTACK_SHIFT, PM_DECAY_SHIFT> PmFilter;
 #else
-// set of values with clean filter
-//good whithout encents
-  #define SENSITIVITY 10/10
-
-  #define VERY_GOOD_VALUE 1
-  #define GOOD_VALUE 2
-  #define MODERATE_VALUE 3
-  #define BAD_VALUE 4
-  #define UNHEALTHY_VALUE 6
-  #define VERY_UNHEALTHY_VALUE 8
-  #define HAZARDOUS_VALUE 10
-
+  #error "Unknown PM_FILTER"
 #endif
-
 //have enum in sync and being able to get string from enum name
 #define FOREACH_AQ(AQ) \
         AQ(VERY_GOOD)   \
@@ -89,59 +103,59 @@ static const char *AQMODE_STRING[] = {
     FOREACH_AQ_MODE(GENERATE_STRING)
 };
 
-typedef struct {
-  int key;
-  int value;
-} IntTranslationMap;
+// health of the serial link with the sensor
+#define FOREACH_PMS_LINK(LINK) \
+        LINK(LINK_OK)   \
+        LINK(LINK_DEGRADED)  \
+        LINK(LINK_FAILED)   \
+
+enum PmsLinkState {
+    FOREACH_PMS_LINK(GENERATE_ENUM)
+};
 
-#define MAPSIZE 7
+static const char *PMS_LINK_STRING[] = {
+    FOREACH_PMS_LINK(GENERATE_STRING)
+};
 
 class CPm25
 {
   int SET_PIN;
   int RESET_PIN;
 
-  const IntTranslationMap QuietFanSpeedMap[MAPSIZE] = {  {VERY_GOOD, 40},
-                                                         {GOOD, 45},
-                                                         {MODERATE, 50},
-                                                         {BAD, 60},
-                                                         {UNHEALTHY, 70},
-                                                         {VERY_UNHEALTHY, 70},
-                                                         {HAZARDOUS, 70},
-                                                       };
-  const IntTranslationMap NormalFanSpeedMap[MAPSIZE] = {{VERY_GOOD, 50},
-                                                        {GOOD, 60},
-                                                        {MODERATE, 70},
-                                                        {BAD, 80},
-                                                        {UNHEALTHY, 90},
-                                                        {VERY_UNHEALTHY, 100},
-                                                        {HAZARDOUS, 100},
-                                                      };
-
-  const IntTranslationMap Pm25ToAirQualityStatusMap[MAPSIZE] = {{VERY_GOOD_VALUE * SENSITIVITY, VERY_GOOD},
-                                                                {GOOD_VALUE * SENSITIVITY, GOOD},
-                                                                {MODERATE_VALUE * SENSITIVITY, MODERATE},
-                                                                {BAD_VALUE * SENSITIVITY, BAD},
-                                                                {UNHEALTHY_VALUE * SENSITIVITY, UNHEALTHY},
-                                                                {VERY_UNHEALTHY_VALUE * SENSITIVITY, VERY_UNHEALTHY},
-                                                                {HAZARDOUS_VALUE * SENSITIVITY, HAZARDOUS},
-                                                              };
-
 public:
-  CPm25(int pin_set,int pin_reset);
+  // recordType: eInputTraceRecord used to record the bytes received (see InputRecorder.h)
+  CPm25(HardwareSerial* serial, int pin_set, int pin_reset, byte recordType);
   void ReadValues();
   void Sleep();
   void WakeUp();
-  int GetSpeedBasedOnAQMode(AirQualityMODE mode,AirQualityStatus status );
+  // runs the fan speed controller of the mode once per second with the averaged PM2.5 value
+  int GetSpeedBasedOnAQMode(AirQualityMODE mode, int pm25Avg);
+  CFanSpeedControl &GetFanSpeedControl() { return _fanSpeedControl; }
+  CPmTrend &GetTrend() { return _trend; }
 
   int GetAvgListSize();
   int GetAvgPM01();                         //ug/m3
   int GetAvgPM2_5();                        //ug/m3
   int GetAvgPM10();                         //ug/m3
-  int GetPM01()  { return PM01Value; }      //ug/m3
-  int GetPM2_5()  { return PM2_5Value; }    //ug/m3
-  int GetPM10()  { return PM10Value; }      //ug/m3
-
+  int GetPM01()  { return _hasSample ? _sample.Pm01Cf1 : -1; }   //ug/m3
+  int GetPM2_5() { return _hasSample ? _sample.Pm25Cf1 : -1; }   //ug/m3
+  int GetPM10()  { return _hasSample ? _sample.Pm10Cf1 : -1; }   //ug/m3
+  // particles per 0.1L of air, -1 until the first frame is received
+  long GetParticles(PmsParticleBin bin) { return _hasSample ? (long)_sample.Particles[bin] : -1; }
+  // every field of the last frame, only meaningful once HasSample() is true
+  const PmsSample &GetSample() { return _sample; }
+  bool HasSample() { return _hasSample; }
+  CPmsParser &GetParser() { return _parser; }
+  // LINK_DEGRADED when frames are missing or too many frames are damaged, LINK_FAILED when no frame is received anymore
+  PmsLinkState GetLinkState() { return _linkState; }
+  void GetLinkStatistics(PmsLinkStatistics &statistics);
+  // frames received while the sensor warms up after a wake up are parsed but their values are ignored
+  void SetWarmingUp(bool warmingUp) { _warmingUp = warmingUp; }
+
+  // the air quality levels and the fan speed controller tunings come from the selected filter profile (see AQProfiles.h)
+  void SetAQProfile(byte index);
+  byte GetAQProfileIndex() { return _aqProfileIndex; }
+  const AQProfile &GetAQProfile() { return _aqProfile; }
   AirQualityStatus ConvertPM2_5ToAirQualityStatus(int PM_25_Value);
 //EU limits:
 //2.5=> 20/25 ug/m3//combustion particules, organic compound, metals, etc...
@@ -152,28 +166,41 @@ public:
 protected:
 private:
   HardwareSerial* _hSerial;
-  unsigned char buf[LENG];
-  int PM01Value = -1;          //define PM1.0 value of the air detector module
-  int PM2_5Value= -1;         //define PM2.5 value of the air detector module
-  int PM10Value = -1;         //define PM10 value of the air detector module
+  byte _recordType;
+  CPmsParser _parser;
+  CFanSpeedControl _fanSpeedControl;
+  CPmTrend _trend;
+  AQProfile _aqProfile;       // copy of the selected profile, the tables stay in flash
+  byte _aqProfileIndex = CLEAN_FILTER;
+  PmsSample _sample = {};     // last frame received from the air detector module
+  bool _hasSample = false;
+  bool _warmingUp = false;
+  bool _sleeping  = false;
+
+  // link health
+  PmsLinkState  _linkState          = LINK_OK;
+  unsigned long _lastFrameMs        = 0;     // last valid frame, or sensor wake up
+  unsigned long _maxFrameGapMs      = 0;
+  unsigned long _windowStartMs      = 0;
+  unsigned long _windowFrames       = 0;     // parser counters at the start of the window
+  unsigned long _windowErrors       = 0;
+  bool          _windowDegraded     = false; // too many bad frames inside the last window
+  unsigned long GetErrorCount();
+  void OnValidFrame(unsigned long now);
+  void UpdateLinkState(unsigned long now);
+  int  GetControlledSpeed(const FanControlProfile &profile, int pm25Avg);
   int AvgPM01Value  = -1;
   int AvgPM2_5Value = -1;
   int AvgPM10Value  = -1;
 
-  void updateList(LinkedList<int> *list, int newValue);
-
-  int GetAvgPM(LinkedList<int> *list);//ug/m3
-  LinkedList<int> ListAvgPM01  = LinkedList<int>();
-  LinkedList<int> ListAvgPM2_5 = LinkedList<int>();
-  LinkedList<int> ListAvgPM10  = LinkedList<int>();
+  void updateAverage(PmFilter *average, int newValue);
 
-  char checkValue(unsigned char *thebuf, char len);
-  int transmitPM01(unsigned char *thebuf);
-  int transmitPM2_5(unsigned char *thebuf);
-  int transmitPM10(unsigned char *thebuf);
+  PmFilter AvgPM01;
+  PmFilter AvgPM2_5;
+  PmFilter AvgPM10;
 
-  int FindFanSpeedInsideFanSpeedTranslationMap(IntTranslationMap *map, AirQualityStatus status);
-  AirQualityStatus ComputePm25ToAirQualitStatus(IntTranslationMap *map, int pm25);
+  void ApplyFrame(const PmsFrame &frame);
+  static void DecodeFrame(const PmsFrame &frame, PmsSample &sample);
 
 };
 #endif
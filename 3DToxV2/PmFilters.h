@@ -0,0 +1,250 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PMFILTERS
+#define _PMFILTERS
+
+#include <Arduino.h>
+#include "RunningAverage.h"
+
+// Smoothing filters of the PM values, selected with PM_FILTER (see Pm25.h).
+// Every filter has the same interface so CPm25 uses any of them through the PmFilter typedef:
+//   void Add(int value)          called for each sensor frame, computes the filtered value
+//   int  GetValue(int emptyValue) returns the last filtered value, emptyValue while nothing was added
+//   byte GetCount()              amount of values taken into account, at most the window size
+//   void Clear()
+// No floating point is used: the exponential filters keep their state in fixed point with
+// PM_FILTER_FRACTION_BITS fractional bits, the window filters work on integers.
+#define PM_FILTER_MEAN          0
+#define PM_FILTER_EWMA          1
+#define PM_FILTER_MEDIAN        2
+#define PM_FILTER_TRIMMED_MEAN  3
+#define PM_FILTER_ASYMMETRIC    4
+
+const byte PM_FILTER_FRACTION_BITS = 8;
+
+// sorting the few values of a window, insertion sort is the fastest for such sizes
+inline void SortPmValues(int *values, byte count)
+{
+  for(byte i = 1; i < count; i++)
+  {
+    int  value = values[i];
+    byte j     = i;
+    while(j > 0 && values[j - 1] > value)
+    {
+      values[j] = values[j - 1];
+      j--;
+    }
+    values[j] = value;
+  }
+}
+
+// Mean of the last SIZE values. Reacts linearly, a step needs SIZE frames to be fully applied
+// and an outlier is divided by SIZE but still passes through
+template <byte SIZE>
+class CMeanFilter
+{
+  public:
+  void Add(int value)              { _average.Add(value); }
+  int  GetValue(int emptyValue) const { return _average.GetAverage(emptyValue); }
+  byte GetCount() const            { return _average.GetCount(); }
+  void Clear()                     { _average.Clear(); }
+
+  private:
+  CRunningAverage<int, long, SIZE> _average;
+};
+
+// Exponential moving average: each new value weights 1/2^SHIFT.
+// Only the fixed point state is kept, so the window is unlimited without any memory cost
+template <byte SHIFT>
+class CEwmaFilter
+{
+  public:
+  void Add(int value)
+  {
+    long scaled = (long)value << PM_FILTER_FRACTION_BITS;
+    if(_count == 0)
+    {
+      _state = scaled;
+      _count = 1;
+    }
+    else
+    {
+      _state += (scaled - _state) >> SHIFT;
+      if(_count < (1 << SHIFT))
+      {
+        _count++;
+      }
+    }
+  }
+  int GetValue(int emptyValue) const
+  {
+    if(_count == 0)
+    {
+      return emptyValue;
+    }
+    return (int)((_state + (1L << (PM_FILTER_FRACTION_BITS - 1))) >> PM_FILTER_FRACTION_BITS);
+  }
+  long GetValueQ8() const { return _state; }   // without rounding, 0 while empty
+  byte GetCount() const { return _count; }
+  void Clear()          { _state = 0; _count = 0; }
+
+  private:
+  long _state = 0;
+  byte _count = 0;
+
+  static_assert(SHIFT > 0 && SHIFT < 8, "CEwmaFilter SHIFT must be between 1 and 7");
+};
+
+// Exponential moving average following rising values with ATTACK_SHIFT and falling values with DECAY_SHIFT.
+// With a small ATTACK_SHIFT fumes are detected within a few frames, while a large DECAY_SHIFT keeps
+// the fan running a while after they're gone
+template <byte ATTACK_SHIFT, byte DECAY_SHIFT>
+class CAsymmetricFilter
+{
+  public:
+  void Add(int value)
+  {
+    long scaled = (long)value << PM_FILTER_FRACTION_BITS;
+    if(_count == 0)
+    {
+      _state = scaled;
+      _count = 1;
+      return;
+    }
+    if(scaled > _state)
+    {
+      _state += (scaled - _state) >> ATTACK_SHIFT;
+    }
+    else
+    {
+      _state += (scaled - _state) >> DECAY_SHIFT;
+    }
+    if(_count < (1 << DECAY_SHIFT))
+    {
+      _count++;
+    }
+  }
+  int GetValue(int emptyValue) const
+  {
+    if(_count == 0)
+    {
+      return emptyValue;
+    }
+    return (int)((_state + (1L << (PM_FILTER_FRACTION_BITS - 1))) >> PM_FILTER_FRACTION_BITS);
+  }
+  byte GetCount() const { return _count; }
+  void Clear()          { _state = 0; _count = 0; }
+
+  private:
+  long _state = 0;
+  byte _count = 0;
+
+  static_assert(ATTACK_SHIFT < 8 && DECAY_SHIFT > 0 && DECAY_SHIFT < 8, "CAsymmetricFilter shifts must be lower than 8");
+};
+
+// Values of the last SIZE frames, base of the median and trimmed mean filters
+template <byte SIZE>
+class CPmWindow
+{
+  public:
+  void Add(int value)
+  {
+    _items[_next] = value;
+    _next         = (_next + 1 == SIZE) ? 0 : _next + 1;
+    if(_count < SIZE)
+    {
+      _count++;
+    }
+  }
+  // copying the stored values in ascending order, returns their amount
+  byte GetSorted(int *values) const
+  {
+    for(byte i = 0; i < _count; i++)
+    {
+      values[i] = _items[i];
+    }
+    SortPmValues(values, _count);
+    return _count;
+  }
+  byte GetCount() const { return _count; }
+  void Clear()          { _count = 0; _next = 0; }
+
+  private:
+  int  _items[SIZE];
+  byte _count = 0;
+  byte _next  = 0;
+
+  static_assert(SIZE > 0, "CPmWindow SIZE must be at least 1");
+};
+
+// Median of the last SIZE values: an outlier shorter than SIZE / 2 frames never passes through,
+// a step is applied after SIZE / 2 + 1 frames
+template <byte SIZE>
+class CMedianFilter
+{
+  public:
+  void Add(int value)
+  {
+    _window.Add(value);
+    int  sorted[SIZE];
+    byte count = _window.GetSorted(sorted);
+    _value = sorted[count / 2];
+  }
+  int  GetValue(int emptyValue) const { return _window.GetCount() == 0 ? emptyValue : _value; }
+  byte GetCount() const               { return _window.GetCount(); }
+  void Clear()                        { _window.Clear(); }
+
+  private:
+  CPmWindow<SIZE> _window;
+  int             _value = 0;
+};
+
+// Mean of the last SIZE values without the TRIM lowest and TRIM highest ones.
+// Outliers are removed like with the median, while the remaining values are still averaged
+template <byte SIZE, byte TRIM>
+class CTrimmedMeanFilter
+{
+  public:
+  void Add(int value)
+  {
+    _window.Add(value);
+    int  sorted[SIZE];
+    byte count = _window.GetSorted(sorted);
+    byte trim  = (count > 2 * TRIM) ? TRIM : 0;   // nothing is removed until the window holds enough values
+    long sum   = 0;
+    for(byte i = trim; i < count - trim; i++)
+    {
+      sum += sorted[i];
+    }
+    _value = (int)(sum / (count - 2 * trim));
+  }
+  int  GetValue(int emptyValue) const { return _window.GetCount() == 0 ? emptyValue : _value; }
+  byte GetCount() const               { return _window.GetCount(); }
+  void Clear()                        { _window.Clear(); }
+
+  private:
+  CPmWindow<SIZE> _window;
+  int             _value = 0;
+
+  static_assert(SIZE > 2 * TRIM, "CTrimmedMeanFilter must keep at least one value");
+};
+
+#endif
@@ -0,0 +1,87 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // The averaged PM2.5 driving the fan speed controller reacts several seconds after the fumes appear.
+ // This class detects a fast rise of the raw sensor values and boosts the fan ahead of time,
+ // so the fumes are extracted before they escape the nozzle area. Everything is Q8 fixed point.
+
+#include "PmTrend.h"
+
+const long PM_TREND_LAG_FRAMES = (1L << PM_TREND_SLOW_SHIFT) - (1L << PM_TREND_FAST_SHIFT);
+const int  PM_TREND_MAX_PM     = 1000;    // ug/m3, bounds the extrapolated value so the boost computation can't overflow
+
+void CPmTrend::Add(int pm25, int pm01)
+{
+  _fastPm25.Add(pm25);
+  _slowPm25.Add(pm25);
+  _fastPm01.Add(pm01);
+  _slowPm01.Add(pm01);
+}
+
+void CPmTrend::Clear()
+{
+  _risingS = 0;
+  _fastPm25.Clear();
+  _slowPm25.Clear();
+  _fastPm01.Clear();
+  _slowPm01.Clear();
+}
+
+long CPmTrend::GetSlopeQ8(const CEwmaFilter<PM_TREND_FAST_SHIFT> &fast, const CEwmaFilter<PM_TREND_SLOW_SHIFT> &slow)
+{
+  if(slow.GetCount() < (1 << PM_TREND_SLOW_SHIFT))   // the slow average still follows its first value
+  {
+    return 0;
+  }
+  return (fast.GetValueQ8() - slow.GetValueQ8()) / PM_TREND_LAG_FRAMES;
+}
+
+// PM1 is included as the 3D printer fumes are mostly made of ultra fine particles
+long CPmTrend::GetSlopeQ8()
+{
+  return max(GetSlopeQ8(_fastPm25, _slowPm25), GetSlopeQ8(_fastPm01, _slowPm01));
+}
+
+// the boost is the proportional term the fan speed controller will have once the averaged PM2.5
+// reaches the extrapolated value, so the fan already runs at that speed while the fumes arrive
+byte CPmTrend::UpdateBoost(const FanControlProfile &profile)
+{
+  long slopeQ8 = GetSlopeQ8();
+  // the sensor noise gives slopes above BoostSlope, they are ignored while the PM stays inside the dead band
+  bool rising  = slopeQ8 > profile.BoostSlope
+                 && _fastPm25.GetValueQ8() > ((long)profile.SetpointPm25 + profile.DeadBand + PM_TREND_MARGIN) << 8;
+  _risingS = rising ? min(_risingS + 1, 255) : 0;
+  if(_risingS >= PM_TREND_CONFIRM_S)
+  {
+    long predicted = min((_fastPm25.GetValueQ8() + slopeQ8 * PM_TREND_HORIZON_S) >> 8, (long)PM_TREND_MAX_PM);
+    long error     = predicted - profile.SetpointPm25 - profile.DeadBand;
+    long boost     = constrain(((long)profile.Kp * error) >> 8, 0, profile.MaxDuty - profile.MinDuty);
+    if(boost > _boost)
+    {
+      _boost = (byte)boost;
+    }
+  }
+  else
+  {
+    _boost = _boost > profile.BoostDecay ? _boost - profile.BoostDecay : 0;
+  }
+  return _boost;
+}
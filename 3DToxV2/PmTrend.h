@@ -0,0 +1,78 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PMTREND
+#define _PMTREND
+
+#include <Arduino.h>
+#include "PmFilters.h"
+#include "FanSpeedControl.h"
+
+// each setting can be overridden from the build flags
+#ifndef PM_TREND_FAST_SHIFT
+  #define PM_TREND_FAST_SHIFT  1    // fast moving average: each new frame weights 1/2^PM_TREND_FAST_SHIFT
+#endif
+#ifndef PM_TREND_SLOW_SHIFT
+  #define PM_TREND_SLOW_SHIFT  3    // slow moving average: each new frame weights 1/2^PM_TREND_SLOW_SHIFT
+#endif
+#ifndef PM_TREND_CONFIRM_S
+  #define PM_TREND_CONFIRM_S   2    // s, the rise must last this long to boost the fan, a single noisy frame doesn't
+#endif
+#ifndef PM_TREND_HORIZON_S
+  #define PM_TREND_HORIZON_S   10   // s, how far ahead a rising PM is extrapolated to compute the boost
+#endif
+#ifndef PM_TREND_MARGIN
+  #define PM_TREND_MARGIN      1    // ug/m3 (one sensor count), the PM2.5 must be this far above the dead band to boost the fan
+#endif
+
+// Slope of the PM1 and PM2.5 values measured by the sensor, from the difference of two moving averages:
+// on a steady rise of S ug/m3 per frame, an average of weight 1/2^N lags (2^N - 1) * S behind the values.
+// The difference of the fast and slow averages divided by the difference of their lags gives S,
+// without storing any history. The sensor sends about one frame per second.
+// UpdateBoost() converts a fast rise into a fan boost: the duty cycle the fan speed controller will need
+// if the PM2.5 keeps rising for PM_TREND_HORIZON_S. The boost is released at BoostDecay per second
+// once the rise is slower than the BoostSlope of the profile. BoostSlope is within the sensor noise on the
+// filtered profiles, so a rise is only taken into account once the fast average leaves the dead band by PM_TREND_MARGIN.
+class CPmTrend
+{
+  public:
+  void Add(int pm25, int pm01);
+  // restarts from the next frame, e.g. after the sensor slept
+  void Clear();
+  // ug/m3 per frame (Q8), the fastest of the PM1 and PM2.5 rises. 0 until the slow average is filled
+  long GetSlopeQ8();
+  // called once per second, returns the boost in % of duty cycle
+  byte UpdateBoost(const FanControlProfile &profile);
+  byte GetBoost() { return _boost; }
+
+  private:
+  static long GetSlopeQ8(const CEwmaFilter<PM_TREND_FAST_SHIFT> &fast, const CEwmaFilter<PM_TREND_SLOW_SHIFT> &slow);
+
+  CEwmaFilter<PM_TREND_FAST_SHIFT> _fastPm25;
+  CEwmaFilter<PM_TREND_SLOW_SHIFT> _slowPm25;
+  CEwmaFilter<PM_TREND_FAST_SHIFT> _fastPm01;
+  CEwmaFilter<PM_TREND_SLOW_SHIFT> _slowPm01;
+  byte _boost   = 0;
+  byte _risingS = 0;      // seconds since the slope is above the BoostSlope of the profile
+
+  static_assert(PM_TREND_FAST_SHIFT < PM_TREND_SLOW_SHIFT, "PM_TREND_FAST_SHIFT must be smaller than PM_TREND_SLOW_SHIFT");
+};
+
+#endif
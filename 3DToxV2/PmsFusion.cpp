@@ -0,0 +1,113 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class manages the air quality sensors of enclosures having a second sensor at the filter outlet.
+ // Each sensor has its own CPm25 object reading its own serial port. Both ports are read once per second,
+ // each read being bounded to the size of the serial receive buffer (PMS_READ_CHUNK), so a second sensor
+ // adds at most one chunk of parsing to the 1Hz task.
+
+#include "PmsFusion.h"
+#include "Constants.h"
+
+CPmsFusion::CPmsFusion(CPm25* inlet, CPm25* outlet)
+{
+  _inlet  = inlet;
+  _outlet = outlet;
+}
+
+void CPmsFusion::ReadValues()
+{
+  _inlet->ReadValues();
+  if(_outlet != NULL)
+  {
+    _outlet->ReadValues();
+  }
+}
+
+// falling back to the outlet sensor only when the inlet one is silent, a degraded link still gives values.
+// Going back to the inlet sensor once its link is fully recovered, or when the outlet sensor fails too
+void CPmsFusion::Update()
+{
+  if(_outlet == NULL)
+  {
+    return;
+  }
+  if(_source == PMS_INLET && _inlet->GetLinkState() == LINK_FAILED && _outlet->GetLinkState() != LINK_FAILED)
+  {
+    _source = PMS_OUTLET;
+    _failovers++;
+  }
+  else if(_source == PMS_OUTLET && (_inlet->GetLinkState() == LINK_OK || _outlet->GetLinkState() == LINK_FAILED))
+  {
+    _source = PMS_INLET;
+  }
+}
+
+void CPmsFusion::SetAQProfile(byte index)
+{
+  _inlet->SetAQProfile(index);
+  if(_outlet != NULL)
+  {
+    _outlet->SetAQProfile(index);
+  }
+}
+
+int CPmsFusion::GetFilterEfficiency()
+{
+  if(_outlet == NULL || _inlet->GetLinkState() != LINK_OK || _outlet->GetLinkState() != LINK_OK)
+  {
+    return -1;
+  }
+  int inletPm25  = _inlet->GetAvgPM2_5();
+  int outletPm25 = _outlet->GetAvgPM2_5();
+  if(inletPm25 < PMS_FUSION_MIN_INLET_PM25 || outletPm25 < 0)
+  {
+    return -1;
+  }
+  return constrain(100 - (int)((long)outletPm25 * 100 / inletPm25), 0, 100);
+}
+
+void CPmsFusion::Sleep()
+{
+  _inlet->Sleep();
+  if(_outlet != NULL)
+  {
+    _outlet->Sleep();
+  }
+}
+
+void CPmsFusion::WakeUp()
+{
+  _inlet->WakeUp();
+  if(_outlet != NULL)
+  {
+    _outlet->WakeUp();
+  }
+}
+
+void CPmsFusion::SetWarmingUp(bool warmingUp)
+{
+  _inlet->SetWarmingUp(warmingUp);
+  if(_outlet != NULL)
+  {
+    _outlet->SetWarmingUp(warmingUp);
+  }
+}
@@ -0,0 +1,82 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PMSFUSION
+#define _PMSFUSION
+
+#include <Arduino.h>
+#include "Pm25.h"
+
+// sensor providing the air quality status
+//have enum in sync and being able to get string from enum name
+#define FOREACH_PMS_SOURCE(SOURCE) \
+        SOURCE(PMS_INLET)   \
+        SOURCE(PMS_OUTLET)   \
+
+enum PmsSource {
+    FOREACH_PMS_SOURCE(GENERATE_ENUM)
+};
+
+static const char *PMS_SOURCE_STRING[] = {
+    FOREACH_PMS_SOURCE(GENERATE_STRING)
+};
+
+// Combines the air quality sensor at the nozzle (inlet) with the optional one at the filter outlet (see DUAL_PMS inside config.h)
+// - the inlet sensor drives the fan. When it goes silent (LINK_FAILED) the outlet sensor takes over the air quality
+//   status until the inlet link is OK again. The failover is status only: the fan speed still comes from the inlet
+//   sensor, which asks for the max speed of the mode while it has failed (see CPm25::GetControlledSpeed)
+// - the outlet sensor measures the filter efficiency
+// Both sensors use the air quality profile selected by the user.
+// Without DUAL_PMS, outlet is NULL and the inlet sensor is used alone.
+class CPmsFusion
+{
+  public:
+  CPmsFusion(CPm25* inlet, CPm25* outlet);
+  // reads the bytes received from both sensors
+  void ReadValues();
+  // called once per second, after the sensor data has been read
+  void Update();
+
+  CPm25* GetInlet()  { return _inlet; }
+  CPm25* GetOutlet() { return _outlet; }
+  // sensor to read the air quality status from. The fan speed always comes from the inlet sensor
+  CPm25* GetControlSensor() { return _source == PMS_OUTLET ? _outlet : _inlet; }
+  PmsSource GetSource() { return _source; }
+  // selects the air quality profile of both sensors (see CPm25::SetAQProfile)
+  void SetAQProfile(byte index);
+  // amount of times the outlet sensor took over since startup
+  unsigned int GetFailoverCount() { return _failovers; }
+  // share of the PM2.5 stopped by the filter in %, -1 when it can't be measured:
+  // no outlet sensor, unhealthy link, or inlet PM2.5 too low to give a meaningful ratio
+  int GetFilterEfficiency();
+
+  // both sensors share the duty cycle of the power manager
+  void Sleep();
+  void WakeUp();
+  void SetWarmingUp(bool warmingUp);
+
+  private:
+  CPm25*       _inlet;
+  CPm25*       _outlet;
+  PmsSource    _source    = PMS_INLET;
+  unsigned int _failovers = 0;
+};
+
+#endif
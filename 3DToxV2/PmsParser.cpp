@@ -0,0 +1,155 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Byte by byte parser of the frames sent by the PMS air quality sensor.
+ // CPm25::ReadValues() feeds it with the bytes already received by Serial3,
+ // so reading the sensor never blocks the main loop. See PmsParser.h for the frame format
+
+#include "PmsParser.h"
+
+bool CPmsParser::Parse(byte value)
+{
+  _bytes++;
+  _buffer[_position++] = value;
+  for(;;)
+  {
+    switch(Evaluate())
+    {
+      case prINCOMPLETE:
+        return false;
+      case prFRAME:
+        Publish();
+        _position = 0;
+        return true;
+      default:
+        Resync();                // the remaining bytes may hold the start of the next frame
+        if(_position == 0)
+        {
+          return false;
+        }
+        break;
+    }
+  }
+}
+
+// checking the buffered bytes against the frame format
+CPmsParser::eParseResult CPmsParser::Evaluate()
+{
+  if(_buffer[0] != PMS_START_BYTE_1)
+  {
+    return prINVALID;
+  }
+  if(_position < 2)
+  {
+    return prINCOMPLETE;
+  }
+  if(_buffer[1] != PMS_START_BYTE_2)
+  {
+    _framingErrors++;
+    return prINVALID;
+  }
+  if(_position < PMS_HEADER_SIZE)
+  {
+    return prINCOMPLETE;
+  }
+  unsigned int length = (_buffer[2] << 8) | _buffer[3];
+  if(length < PMS_MIN_LENGTH || length > PMS_MAX_LENGTH || (length & 1) != 0)
+  {
+    _framingErrors++;
+    return prINVALID;
+  }
+  if(_position < PMS_HEADER_SIZE + length)
+  {
+    return prINCOMPLETE;
+  }
+
+  unsigned int sum = 0;
+  for(byte i = 0; i < _position - 2; i++)
+  {
+    sum += _buffer[i];
+  }
+  if(sum != (unsigned int)((_buffer[_position - 2] << 8) | _buffer[_position - 1]))
+  {
+    if(HasFrameStart(2))
+    {
+      _shortReads++;      // the frame was cut, the next one started inside it
+    }
+    else
+    {
+      _checksumErrors++;
+    }
+    return prINVALID;
+  }
+  return prFRAME;
+}
+
+// checking if the start bytes of a frame are inside the buffer, after from
+bool CPmsParser::HasFrameStart(byte from)
+{
+  for(byte i = from; i + 1 < _position; i++)
+  {
+    if(_buffer[i] == PMS_START_BYTE_1 && _buffer[i + 1] == PMS_START_BYTE_2)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// dropping the first byte and every following byte up to the next start byte
+void CPmsParser::Resync()
+{
+  if(_buffer[0] == PMS_START_BYTE_1)   // a started frame is abandoned, not just a noise byte
+  {
+    _resyncs++;
+  }
+  byte start = 1;
+  while(start < _position && _buffer[start] != PMS_START_BYTE_1)
+  {
+    start++;
+  }
+  _discardedBytes += start;
+  _position       -= start;
+  memmove(_buffer, &_buffer[start], _position);
+}
+
+// the frame is copied in one go, so the previous frame stays available until the new one is valid
+void CPmsParser::Publish()
+{
+  byte wordCount = (_position - PMS_HEADER_SIZE - 2) / 2;
+  for(byte i = 0; i < wordCount; i++)
+  {
+    _frame.Words[i] = (_buffer[PMS_HEADER_SIZE + 2 * i] << 8) | _buffer[PMS_HEADER_SIZE + 2 * i + 1];
+  }
+  _frame.WordCount = wordCount;
+  _frames++;
+}
+
+void CPmsParser::ResetStatistics()
+{
+  _bytes          = 0;
+  _frames         = 0;
+  _checksumErrors = 0;
+  _framingErrors  = 0;
+  _discardedBytes = 0;
+  _resyncs        = 0;
+  _shortReads     = 0;
+}
@@ -0,0 +1,124 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PMSPARSER
+#define _PMSPARSER
+
+#include <Arduino.h>
+
+// Plantower PMSx003 frame: 0x42 0x4D | length (16 bits, big endian) | data words (16 bits, big endian) | checksum
+// length counts the data words and the checksum, the checksum is the sum of all the previous bytes
+const byte PMS_START_BYTE_1     = 0x42;
+const byte PMS_START_BYTE_2     = 0x4D;
+const byte PMS_HEADER_SIZE      = 4;
+const byte PMS_MIN_LENGTH       = 4;     // at least 1 data word and the checksum
+const byte PMS_MAX_LENGTH       = 28;    // PMS1003 / PMS5003 / PMS7003 frames: 13 data words and the checksum
+const byte PMS_MAX_FRAME_SIZE   = PMS_HEADER_SIZE + PMS_MAX_LENGTH;
+const byte PMS_MAX_DATA_WORDS   = (PMS_MAX_LENGTH - 2) / 2;
+
+// Complete frame whose checksum has been verified
+typedef struct {
+  byte         WordCount;
+  unsigned int Words[PMS_MAX_DATA_WORDS];
+} PmsFrame;
+
+// Particle count bins of the PMS1003 frame: particles per 0.1L of air beyond each diameter
+enum PmsParticleBin {
+  pbOVER_0_3UM,
+  pbOVER_0_5UM,
+  pbOVER_1_0UM,
+  pbOVER_2_5UM,
+  pbOVER_5_0UM,
+  pbOVER_10UM,
+  PMS_PARTICLE_BINS
+};
+
+// Every field of a PMS1003 frame, decoded by CPm25 (see CPm25::DecodeFrame).
+// Packed with fixed width fields so the layout is the same on the AVR and on host builds
+typedef struct __attribute__((packed)) {
+  uint32_t ReceivedMs;                    // millis() when the frame was completed
+  uint16_t Pm01Cf1;                       // ug/m3, CF=1 standard particles
+  uint16_t Pm25Cf1;
+  uint16_t Pm10Cf1;
+  uint16_t Pm01Atm;                       // ug/m3, atmospheric environment
+  uint16_t Pm25Atm;
+  uint16_t Pm10Atm;
+  uint16_t Particles[PMS_PARTICLE_BINS];  // see PmsParticleBin
+  uint16_t Reserved;                      // version and error code on PMS5003 / PMS7003
+} PmsSample;
+static_assert(sizeof(PmsSample) == 4 + 2 * PMS_MAX_DATA_WORDS, "PmsSample must hold every data word of the frame");
+
+// Health of the serial link with the sensor, filled by CPm25::GetLinkStatistics()
+typedef struct {
+  byte          State;            // PmsLinkState (see Pm25.h)
+  unsigned long Frames;           // valid frames received
+  unsigned int  ChecksumErrors;
+  unsigned int  FramingErrors;
+  unsigned int  Resyncs;
+  unsigned int  ShortReads;
+  unsigned long DiscardedBytes;
+  unsigned long MaxFrameGapMs;    // longest time between two valid frames while the sensor was awake
+} PmsLinkStatistics;
+
+// Incremental parser of the sensor stream, fed one byte at a time so it never waits for data.
+// The bytes of the frame being received are kept in a buffer. When the frame turns out to be invalid
+// (cut frame, wrong length or checksum), the parser restarts from the next 0x42 byte of that buffer,
+// so a frame starting inside a corrupted one isn't lost.
+// The last valid frame is only replaced once a new frame is complete and verified.
+class CPmsParser
+{
+  public:
+  // returns true when value completes a valid frame, available with GetFrame()
+  bool Parse(byte value);
+  const PmsFrame &GetFrame() { return _frame; }
+
+  unsigned long GetByteCount()      { return _bytes; }
+  unsigned long GetFrameCount()     { return _frames; }
+  unsigned int  GetChecksumErrors() { return _checksumErrors; }
+  // frames dropped because of a wrong second start byte or a wrong length
+  unsigned int  GetFramingErrors()  { return _framingErrors; }
+  // frames cut by the start of the next frame, the sensor or the line dropped bytes
+  unsigned int  GetShortReads()     { return _shortReads; }
+  // amount of started frames abandoned to look for the next start byte
+  unsigned int  GetResyncs()        { return _resyncs; }
+  // bytes skipped while looking for the start of a frame
+  unsigned long GetDiscardedBytes() { return _discardedBytes; }
+  void ResetStatistics();
+
+  private:
+  enum eParseResult { prINCOMPLETE, prFRAME, prINVALID };
+  eParseResult Evaluate();
+  bool HasFrameStart(byte from);
+  void Resync();
+  void Publish();
+
+  byte          _buffer[PMS_MAX_FRAME_SIZE];
+  byte          _position       = 0;     // amount of bytes inside _buffer
+  PmsFrame      _frame          = { 0, { 0 } };
+  unsigned long _bytes          = 0;
+  unsigned long _frames         = 0;
+  unsigned int  _checksumErrors = 0;
+  unsigned int  _framingErrors  = 0;
+  unsigned long _discardedBytes = 0;
+  unsigned int  _resyncs        = 0;
+  unsigned int  _shortReads     = 0;
+};
+
+#endif
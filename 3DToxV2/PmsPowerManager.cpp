@@ -0,0 +1,165 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class is dedicated to powering the air quality sensor only when it's needed.
+ // The PMS1003 laser is rated for a limited amount of hours, so when the air has been clean for a while
+ // and the 3D printer is known to be cold, the sensor is put to sleep with its SET pin:
+ //   PMS_ON ----(clean air for PMS_STABLE_BEFORE_SLEEP_S)----> PMS_SLEEPING
+ //   PMS_SLEEPING ----(PMS_SLEEP_S elapsed, hot end heating or printer link lost)----> PMS_WARMING_UP
+ //   PMS_WARMING_UP ----(PMS_WARMUP_S elapsed)----> PMS_ON
+ // While warming up, the frames sent by the sensor aren't accurate yet so CPm25 ignores them.
+ // Once the sensor is duty cycling, it goes back to sleep after PMS_DUTY_AWAKE_S of clean air.
+ // As soon as the air isn't clean anymore the sensor stays on.
+ // The fan speed keeps following the last averaged values while the sensor sleeps.
+ //
+ // The laser on duration is saved every tenth of hour (PMS_LASER_SAVE_PERIOD_S), so at most 6 minutes
+ // are lost at power off. This writes the tenths byte 10 times per laser hour, the EEPROM 100k writes
+ // lifespan then covers 10 000 laser hours, more than the sensor lifetime.
+
+#include "PmsPowerManager.h"
+
+CPmsPowerManager::CPmsPowerManager(CConfig* config)
+{
+  _config = config;
+}
+
+void CPmsPowerManager::LoadLaserDuration()
+{
+  _laserHours  = EEPROM.read(EEPROM_LASER_HOURS_ADDR) | (EEPROM.read(EEPROM_LASER_HOURS_ADDR + 1) << 8);
+  _laserTenths = EEPROM.read(EEPROM_LASER_TENTHS_ADDR);
+  if(_laserHours == 0xFFFF)   // never written
+  {
+    _laserHours = 0;
+  }
+  if(_laserTenths > 9)
+  {
+    _laserTenths = 0;
+  }
+}
+
+void CPmsPowerManager::Update()
+{
+  if(_state != PMS_SLEEPING)
+  {
+    CountLaserSecond();
+  }
+  _stateSeconds++;
+
+#ifdef PMS_DUTY_CYCLE
+  switch(_state)
+  {
+    case PMS_ON:
+      if(CanSleep() == false)
+      {
+        _cleanSeconds = 0;
+        _dutyCycling  = false;
+        break;
+      }
+      _cleanSeconds++;
+      if(_cleanSeconds >= (_dutyCycling ? PMS_DUTY_AWAKE_S : PMS_STABLE_BEFORE_SLEEP_S))
+      {
+        SetState(PMS_SLEEPING);
+      }
+      break;
+    case PMS_SLEEPING:
+      if(_stateSeconds >= PMS_SLEEP_S || !IsPrinterCold())
+      {
+        SetState(PMS_WARMING_UP);
+      }
+      break;
+    case PMS_WARMING_UP:
+      if(_stateSeconds >= PMS_WARMUP_S)
+      {
+        SetState(PMS_ON);
+      }
+      break;
+  }
+#endif
+}
+
+// both the averaged and the last values must be clean, so fresh fumes keep the sensor on right away.
+// A sensor whose link isn't healthy stays on so its state keeps being checked
+bool CPmsPowerManager::CanSleep()
+{
+  if(_config->IgnoreFirstValues > 0 || !IsPrinterCold() || _config->_pm25->GetLinkState() != LINK_OK)
+  {
+    return false;
+  }
+  CPm25* sensor = _config->_pmsFusion->GetControlSensor();
+  int pm25    = sensor->GetPM2_5();
+  int pm25Avg = sensor->GetAvgPM2_5();
+  if(pm25 < 0 || pm25Avg < 0)   // nothing measured yet
+  {
+    return false;
+  }
+  return sensor->ConvertPM2_5ToAirQualityStatus(pm25)    <= PMS_SLEEP_MAX_AQ
+      && sensor->ConvertPM2_5ToAirQualityStatus(pm25Avg) <= PMS_SLEEP_MAX_AQ;
+}
+
+// HotEndTemp is only known while the RS232 link with the printer works, it's -1 otherwise.
+// An unknown printer may be printing, so the sensor only sleeps when the temperature is known
+bool CPmsPowerManager::IsPrinterCold()
+{
+  return !_config->hasSerialComTimedOut
+      && _config->HotEndTemp >= 0
+      && _config->HotEndTemp <= PMS_SLEEP_MAX_HOTEND_TEMP;
+}
+
+void CPmsPowerManager::SetState(PmsPowerState state)
+{
+  _state        = state;
+  _stateSeconds = 0;
+  switch(state)
+  {
+    case PMS_SLEEPING:
+      _config->_pmsFusion->Sleep();
+      _sleepCount++;
+      break;
+    case PMS_WARMING_UP:
+      _config->_pmsFusion->SetWarmingUp(true);
+      _config->_pmsFusion->WakeUp();
+      break;
+    case PMS_ON:
+      _config->_pmsFusion->SetWarmingUp(false);
+      _cleanSeconds = 0;
+      _dutyCycling  = true;
+      break;
+  }
+}
+
+void CPmsPowerManager::CountLaserSecond()
+{
+  _laserSeconds++;
+  if(_laserSeconds < PMS_LASER_SAVE_PERIOD_S)
+  {
+    return;
+  }
+  _laserSeconds = 0;
+  _laserTenths++;
+  if(_laserTenths >= 10)
+  {
+    _laserTenths = 0;
+    _laserHours++;
+    CEEPROM::SafeWriteEEPROMData(EEPROM_LASER_HOURS_ADDR, lowByte(_laserHours));
+    CEEPROM::SafeWriteEEPROMData(EEPROM_LASER_HOURS_ADDR + 1, highByte(_laserHours));
+  }
+  CEEPROM::SafeWriteEEPROMData(EEPROM_LASER_TENTHS_ADDR, _laserTenths);
+}
@@ -0,0 +1,82 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PMSPOWERMANAGER
+#define _PMSPOWERMANAGER
+
+#include "EEPROM_functions.h"
+#include "config.h"
+
+//have enum in sync and being able to get string from enum name
+#define FOREACH_PMS_POWER_STATE(STATE) \
+        STATE(PMS_ON)   \
+        STATE(PMS_SLEEPING)   \
+        STATE(PMS_WARMING_UP)   \
+
+enum PmsPowerState {
+    FOREACH_PMS_POWER_STATE(GENERATE_ENUM)
+};
+
+static const char *PMS_POWER_STRING[] = {
+    FOREACH_PMS_POWER_STATE(GENERATE_STRING)
+};
+
+// the sensor is only put to sleep while the air quality is at this level or better
+const AirQualityStatus PMS_SLEEP_MAX_AQ = GOOD;
+
+// This class decides when the air quality sensor is powered (see PMS_DUTY_CYCLE inside config.h)
+// and keeps track of the laser on duration, saved inside EEPROM
+class CPmsPowerManager
+{
+  public:
+  CPmsPowerManager(CConfig* config);
+  // reading back the laser on duration. Should be called after the EEPROM version has been checked
+  void LoadLaserDuration();
+  // called once per second, after the sensor data has been read
+  void Update();
+
+  PmsPowerState GetState() { return _state; }
+  // seconds spent inside the current state
+  unsigned int GetStateSeconds() { return _stateSeconds; }
+  // amount of times the sensor has been put to sleep since startup
+  unsigned int GetSleepCount() { return _sleepCount; }
+  // laser on duration in tenths of hour
+  unsigned long GetLaserTenthsOfHour() { return (unsigned long)_laserHours * 10 + _laserTenths; }
+
+  protected:
+  CConfig* _config;
+
+  private:
+  bool CanSleep();
+  bool IsPrinterCold();
+  void SetState(PmsPowerState state);
+  void CountLaserSecond();
+
+  PmsPowerState _state        = PMS_ON;
+  unsigned int  _stateSeconds = 0;
+  unsigned int  _cleanSeconds = 0;      // duration the air has been clean while the sensor is on
+  bool          _dutyCycling  = false;  // true once the sensor has slept and the air is still clean
+  unsigned int  _sleepCount   = 0;
+  unsigned int  _laserHours   = 0;      // saved inside EEPROM
+  byte          _laserTenths  = 0;      // saved inside EEPROM
+  unsigned int  _laserSeconds = 0;      // counted since the last save, lost at power off
+};
+
+#endif
@@ -0,0 +1,117 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // -------------------------------Profile view-------------------
+ // this screen is dedicated into selecting the air quality profile, based on the filter installed.
+ // The profile is applied right away and saved into EEPROM with the "Save" menu of the settings.
+ // Like the Mode view, the amount of items exceeds 4 lines, so the visible window of indexes scrolls
+
+#include "ProfileView.h"
+#include "lcd.h"
+#include "config.h"
+#include "utility.h"
+#include "Constants.h"
+#include "Pm25.h"
+#include "MainSettingsView.h"
+
+ProfileView::ProfileView() //constructor
+{
+  _needUpdate = true;                                 // tag screen for refresh
+  lcd_init();                                         // resetting the LCD display. This allows to recover from any garbage screen
+  lcd_clear();                                        // clear the display
+}
+
+// Handle scroll index when know is turned "up"
+void ProfileView::Up()
+{
+  MenuSelectedIndex++;
+  if(MenuSelectedIndex > (MAX_MENU_ITEMS - 1))
+  {
+    MenuSelectedIndex = (MAX_MENU_ITEMS - 1);
+  }
+  // Handle the visible index window
+  if(MenuSelectedIndex > viewWindowMaxIndex)
+  {
+    viewWindowMinIndex += 1;
+    viewWindowMaxIndex += 1;
+  }
+  _needUpdate = true;                               // tag screen for refresh
+  Refresh();                                        // force refresh
+}
+
+// Handle scroll index when know is turned "down"
+void ProfileView::Down()
+{
+  MenuSelectedIndex--;
+  if(MenuSelectedIndex < 0)
+  {
+    MenuSelectedIndex = 0;
+  }
+
+  // Handle the visible index window
+  if(MenuSelectedIndex < viewWindowMinIndex)
+  {
+    viewWindowMinIndex -= 1;
+    viewWindowMaxIndex -= 1;
+  }
+  _needUpdate = true;                               // tag screen for refresh
+  Refresh();                                        // force refresh
+}
+
+// updating the air quality profile used by the sensor objects. Index 0 returns without any change
+ViewBase* ProfileView::Select()
+{
+  if(MenuSelectedIndex > 0)
+  {
+    _config->_pmsFusion->SetAQProfile(MenuSelectedIndex - 1);
+  }
+  return new MainSettingsView();        // Once a profile is selected, We return to previous screen
+}
+
+// Main refresh function for this screen
+void ProfileView::Refresh()
+{
+  if( _needUpdate == false)           // prevent refresh if no changes were done
+  {
+      return;
+  }
+  lcd_clear();                        // clear display
+
+  lcd_setCursor(0,MenuSelectedIndex - viewWindowMinIndex);      // Draw menu arrow
+  lcd_print(">");
+
+  // Only 4 items can be displayed, so viewWindowMinIndex is in use here
+  for( int i= 0 ;i < 4; i++) // max 4 lines
+  {
+    int index = i + viewWindowMinIndex;
+    lcd_setCursor(1,i);
+    if(index == 0)
+    {
+      lcd_print("..");
+      continue;
+    }
+    lcd_print(String(AQ_PROFILE_STRING[index - 1]));
+    if(index - 1 == _config->_pm25->GetAQProfileIndex())
+    {
+      lcd_print(" (*)");
+    }
+  }
+  _needUpdate = false;
+}
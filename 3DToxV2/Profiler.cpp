@@ -0,0 +1,148 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Main loop profiler. Each stage wrapped by PROFILE_STAGE() is timed using micros()
+ // min / max / mean and a log2 histogram of the durations are kept for each stage.
+ // This file is empty unless PROFILER is defined inside config.h
+
+#include "Profiler.h"
+
+#ifdef PROFILER
+
+static const char *PROFILE_STAGE_STRING[] = {
+    FOREACH_PROFILE_STAGE(GENERATE_STRING)
+};
+
+ProfileStageStats CProfiler::_stats[PROFILE_STAGE_COUNT];
+
+// adding one measurement to the stage statistics
+void CProfiler::Record(byte stage, unsigned long durationUs)
+{
+  if(stage >= PROFILE_STAGE_COUNT)
+  {
+    return;
+  }
+  ProfileStageStats* stats = &_stats[stage];
+
+  if(stats->Count == 0 || durationUs < stats->MinUs)
+  {
+    stats->MinUs = durationUs;
+  }
+  if(durationUs > stats->MaxUs)
+  {
+    stats->MaxUs = durationUs;
+  }
+
+  // preventing the sum from overflowing by halving sum and count, the mean is kept
+  if(stats->SumUs + durationUs < stats->SumUs)
+  {
+    stats->SumUs /= 2;
+    stats->Count /= 2;
+  }
+  stats->SumUs += durationUs;
+  stats->Count++;
+
+  // finding the log2 bucket of the duration
+  byte bucket = 0;
+  while((durationUs >>= 1) != 0 && bucket < (PROFILE_HISTOGRAM_SIZE - 1))
+  {
+    bucket++;
+  }
+  if(stats->Histogram[bucket] < 0xFFFF)   // saturating counter
+  {
+    stats->Histogram[bucket]++;
+  }
+}
+
+void CProfiler::Reset()
+{
+  memset(_stats, 0, sizeof(_stats));
+}
+
+unsigned long CProfiler::GetMeanUs(byte stage)
+{
+  if(stage >= PROFILE_STAGE_COUNT || _stats[stage].Count == 0)
+  {
+    return 0;
+  }
+  return _stats[stage].SumUs / _stats[stage].Count;
+}
+
+const ProfileStageStats* CProfiler::GetStats(byte stage)
+{
+  if(stage >= PROFILE_STAGE_COUNT)
+  {
+    return NULL;
+  }
+  return &_stats[stage];
+}
+
+const char* CProfiler::GetStageName(byte stage)
+{
+  if(stage >= PROFILE_STAGE_COUNT)
+  {
+    return "";
+  }
+  return PROFILE_STAGE_STRING[stage];
+}
+
+// one line per stage: name count min max mean followed by histogram buckets
+void CProfiler::PrintStatistics(Print &output)
+{
+  output.println(F("STAGE COUNT MIN_US MAX_US MEAN_US | LOG2 HISTOGRAM 1us..32ms+"));
+  for(byte i = 0; i < PROFILE_STAGE_COUNT; i++)
+  {
+    output.print(GetStageName(i));
+    output.print(' ');
+    output.print(_stats[i].Count);
+    output.print(' ');
+    output.print(_stats[i].MinUs);
+    output.print(' ');
+    output.print(_stats[i].MaxUs);
+    output.print(' ');
+    output.print(GetMeanUs(i));
+    output.print(F(" |"));
+    for(byte j = 0; j < PROFILE_HISTOGRAM_SIZE; j++)
+    {
+      output.print(' ');
+      output.print(_stats[i].Histogram[j]);
+    }
+    output.println();
+  }
+}
+
+// compact summary used inside the SD card log: PROFILE|STAGE:mean/max|...
+void CProfiler::PrintSummary(Print &output)
+{
+  output.print(F("PROFILE"));
+  for(byte i = 0; i < PROFILE_STAGE_COUNT; i++)
+  {
+    output.print('|');
+    output.print(GetStageName(i));
+    output.print(':');
+    output.print(GetMeanUs(i));
+    output.print('/');
+    output.print(_stats[i].MaxUs);
+  }
+  output.println();
+}
+
+#endif
@@ -0,0 +1,90 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROFILER
+#define _PROFILER
+
+#include <Arduino.h>
+#include "config.h"
+#include "utility.h"
+
+// main loop stages measured by the profiler
+//have enum in sync and being able to get string from enum name
+#define FOREACH_PROFILE_STAGE(STAGE) \
+        STAGE(RESET_COM)   \
+        STAGE(ROTARY_ENCODER)   \
+        STAGE(VIEW_REFRESH)  \
+        STAGE(SD_LOG)   \
+        STAGE(COM_MESSAGES)  \
+        STAGE(SAVE_DURATION)  \
+
+enum ProfileStage {
+    FOREACH_PROFILE_STAGE(GENERATE_ENUM)
+    PROFILE_STAGE_COUNT
+};
+
+#ifdef PROFILER
+
+// amount of log2 buckets of the histogram. bucket i counts durations in [2^i, 2^(i+1)[ us
+// the last bucket also counts all the longer durations
+const byte PROFILE_HISTOGRAM_SIZE = 16;
+
+typedef struct {
+  unsigned long MinUs;
+  unsigned long MaxUs;
+  unsigned long SumUs;
+  unsigned long Count;
+  unsigned int  Histogram[PROFILE_HISTOGRAM_SIZE];
+} ProfileStageStats;
+
+// Static profiler storing the statistics of every stage inside a fixed SRAM table
+class CProfiler
+{
+  public:
+  static void Record(byte stage, unsigned long durationUs);
+  static void Reset();
+  static unsigned long GetMeanUs(byte stage);
+  static const ProfileStageStats* GetStats(byte stage);
+  static const char* GetStageName(byte stage);
+  // prints the whole table, one line per stage
+  static void PrintStatistics(Print &output);
+  // writes a one line summary (mean/max per stage)
+  static void PrintSummary(Print &output);
+
+  private:
+  static ProfileStageStats _stats[PROFILE_STAGE_COUNT];
+};
+
+// executes statement and records its duration into the given stage
+#define PROFILE_STAGE(stage, statement) \
+  do { \
+    unsigned long __profileStartUs = micros(); \
+    statement; \
+    CProfiler::Record(stage, micros() - __profileStartUs); \
+  } while(0)
+
+#else
+
+// profiler compiled out: only the statement is executed
+#define PROFILE_STAGE(stage, statement) do { statement; } while(0)
+
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This file decodes the LCD knob rotary encoder and push button inside an interrupt
+ // so that no rotation is lost while the main loop is busy with the SD card or the RS232 port
+
+#include "RotaryEncoder.h"
+#include "digitalWriteFast.h"
+
+// Quadrature transition table indexed by (previous A/B state << 2) | current A/B state
+// +1 is a clockwise quarter step, -1 counter clockwise. 0 is no move or an invalid (bouncing) transition
+static const int8_t QUADRATURE_TABLE[16] = {
+   0, -1,  1,  0,
+   1,  0,  0, -1,
+  -1,  0,  0,  1,
+   0,  1, -1,  0
+};
+
+// digitalReadFast returns the masked port bit, not 0 or 1
+static inline byte ReadAB()
+{
+  return (digitalReadFast(BTN_EN1) ? 2 : 0) | (digitalReadFast(BTN_EN2) ? 1 : 0);
+}
+
+CEventQueue<InputEvent, INPUT_EVENT_QUEUE_SIZE> CRotaryEncoder::_events;
+byte   CRotaryEncoder::_abState           = 0;
+int8_t CRotaryEncoder::_transitions       = 0;
+int8_t CRotaryEncoder::_pendingDetents    = 0;
+bool   CRotaryEncoder::_buttonState       = HIGH;
+byte   CRotaryEncoder::_buttonStableCount = 0;
+
+void CRotaryEncoder::Begin()
+{
+  _abState     = ReadAB();
+  _buttonState = digitalReadFast(BTN_ENC);
+
+  // timer0 is already running for millis() and PWM, its compare A match happens once per overflow.
+  // OCR0A is not used for PWM here (pin 13 is free), so the interrupt doesn't change any output
+  uint8_t oldSREG = SREG;
+  cli();
+  OCR0A   = 0x80;
+  TIMSK0 |= (1 << OCIE0A);
+  SREG    = oldSREG;
+}
+
+// queuing the detents counted so far. If the queue is full they are kept and merged with the next ones
+void CRotaryEncoder::PushPendingDetents()
+{
+  if(_pendingDetents == 0)
+  {
+    return;
+  }
+  InputEvent event;
+  event.Type  = ieROTATION;
+  event.Steps = _pendingDetents;
+  if(_events.Push(event))
+  {
+    _pendingDetents = 0;
+  }
+}
+
+void CRotaryEncoder::Sample()
+{
+  byte abState = ReadAB();
+  if(abState != _abState)
+  {
+    _transitions += QUADRATURE_TABLE[(_abState << 2) | abState];
+    _abState      = abState;
+    if(_transitions >= ROTATION_DIVIDER)
+    {
+      _transitions = 0;
+      if(_pendingDetents < 127)
+      {
+        _pendingDetents++;
+      }
+    }
+    else if(_transitions <= -ROTATION_DIVIDER)
+    {
+      _transitions = 0;
+      if(_pendingDetents > -127)
+      {
+        _pendingDetents--;
+      }
+    }
+  }
+  PushPendingDetents();
+
+  // the button level must stay stable for BUTTON_DEBOUNCE_SAMPLES samples before an edge is reported
+  bool buttonState = digitalReadFast(BTN_ENC);
+  if(buttonState == _buttonState)
+  {
+    _buttonStableCount = 0;
+    return;
+  }
+  if(++_buttonStableCount < BUTTON_DEBOUNCE_SAMPLES)
+  {
+    return;
+  }
+  if(_pendingDetents != 0)       // keeping events ordered: rotations before the button edge
+  {
+    return;
+  }
+  InputEvent event;
+  event.Type  = buttonState == LOW ? ieBUTTON_PRESSED : ieBUTTON_RELEASED;
+  event.Steps = 0;
+  if(_events.Push(event))
+  {
+    _buttonState       = buttonState;
+    _buttonStableCount = 0;
+  }
+}
+
+// sampling the encoder once per timer0 period (1.024ms)
+ISR(TIMER0_COMPA_vect)
+{
+  CRotaryEncoder::Sample();
+}
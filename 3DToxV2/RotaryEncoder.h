@@ -0,0 +1,70 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ROTARYENCODER
+#define _ROTARYENCODER
+
+#include <Arduino.h>
+#include "Constants.h"
+#include "EventQueue.h"
+
+// user inputs posted by the encoder interrupt
+enum eInputEvent
+{
+  ieROTATION,          // Steps holds the signed amount of detents, positive when turning clockwise
+  ieBUTTON_PRESSED,
+  ieBUTTON_RELEASED
+};
+
+typedef struct {
+  byte   Type;
+  int8_t Steps;
+} InputEvent;
+
+// Quadrature decoder of the LCD knob.
+// The encoder pins (PORTC on the Mega) don't support pin change interrupts, so they are
+// sampled by the timer0 compare A interrupt every 1.024ms, whatever the main loop is doing.
+// Each A/B transition is decoded with a state transition table, detents and debounced
+// button edges are pushed into a lock-free queue drained by HandleRotaryEncoder().
+// Edges must be at least one sample apart, that's 500 detents/s with ROTATION_DIVIDER 2, far above a hand spin.
+class CRotaryEncoder
+{
+  public:
+  // reads the initial pins state and enables the sampling interrupt
+  static void Begin();
+  // called from the timer interrupt only
+  static void Sample();
+  // called from the main loop only. returns false when no input is pending
+  static bool PopEvent(InputEvent &event) { return _events.Pop(event); }
+  // amount of times an event couldn't be queued right away (detents are kept and merged, never lost)
+  static byte GetQueueFullCount() { return _events.GetDroppedCount(); }
+
+  private:
+  static void PushPendingDetents();
+
+  static CEventQueue<InputEvent, INPUT_EVENT_QUEUE_SIZE> _events;
+  static byte   _abState;            // last A/B levels: bit 1 = BTN_EN1, bit 0 = BTN_EN2
+  static int8_t _transitions;        // valid transitions not yet forming a full detent
+  static int8_t _pendingDetents;     // detents waiting for room inside the queue
+  static bool   _buttonState;        // debounced button level, LOW when pressed
+  static byte   _buttonStableCount;  // amount of samples the raw level differed from _buttonState
+};
+
+#endif
@@ -0,0 +1,79 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RUNNINGAVERAGE
+#define _RUNNINGAVERAGE
+
+#include <Arduino.h>
+
+// Moving average over the last SIZE values, stored inside a fixed ring buffer.
+// The sum of the stored values is updated on each Add(), so adding a value and reading
+// the average both take a constant time, without any heap allocation.
+// SUM must be able to hold SIZE times the largest value
+template <class T, class SUM, byte SIZE>
+class CRunningAverage
+{
+  public:
+  // once SIZE values are stored, the oldest one is replaced
+  void Add(T value)
+  {
+    if(_count == SIZE)
+    {
+      _sum -= _items[_next];
+    }
+    else
+    {
+      _count++;
+    }
+    _items[_next] = value;
+    _sum         += value;
+    _next         = (_next + 1 == SIZE) ? 0 : _next + 1;
+  }
+
+  // returns emptyValue while no value has been added
+  T GetAverage(T emptyValue) const
+  {
+    if(_count == 0)
+    {
+      return emptyValue;
+    }
+    return (T)(_sum / _count);
+  }
+
+  byte GetCount() const { return _count; }
+  SUM  GetSum() const   { return _sum; }
+
+  void Clear()
+  {
+    _sum   = 0;
+    _count = 0;
+    _next  = 0;
+  }
+
+  private:
+  T    _items[SIZE];
+  SUM  _sum   = 0;
+  byte _count = 0;
+  byte _next  = 0;      // slot written by the next Add()
+
+  static_assert(SIZE > 0, "CRunningAverage SIZE must be at least 1");
+};
+
+#endif
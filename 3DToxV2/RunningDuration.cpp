@@ -19,6 +19,7 @@
  */
 
 #include "RunningDuration.h"
+#include "Watchdog.h"
 
 // This class is dedicated into tracking running duration data and formating it in order to spread the data overthe whole EEPROM Memory
 // This class mainly optimizes the lifespan of the EEPROM of your board.
@@ -73,8 +74,8 @@ CRunningDuration::CRunningDuration(CConfig* config)
    // calculating here the epprom memory capacity in minutes.
    // we we store minutes corresponding in 1 day only then we are using only 1440 bytes over the whole memory capacity.
    // the other remaining bytes will never be used
-   // recalculating here the max memory capacity based on real EEPROM size and EEPPROM_START_ADDR
-   int maxMemorySize = EEPROM.length() - EEPPROM_START_ADDR - 1;
+   // recalculating here the max memory capacity based on spread memory size and EEPPROM_START_ADDR
+   int maxMemorySize = EEPROM_SPREAD_END_ADDR - EEPPROM_START_ADDR - 1;
    this->_config->maxMemoryDays    = (int)(maxMemorySize / this->_config->MinutesInDay);
    this->_config->maxMemoryHours   = (int)((maxMemorySize - this->_config->maxMemoryDays * this->_config->MinutesInDay) / this->_config->MinutesInHour);
    this->_config->maxMemoryMinutes = (int)(maxMemorySize - (this->_config->maxMemoryDays * this->_config->MinutesInDay) - (this->_config->maxMemoryHours * this->_config->MinutesInHour));
@@ -127,7 +128,7 @@ int CRunningDuration::SpreadReadMinutes(int startAddr)
 // this sections is only used for serial debugging
 #ifdef DEBUG
     Serial.print ("Available EEPROM size:");
-    Serial.print (EEPROM.length() - startAddr, DEC);
+    Serial.print (EEPROM_SPREAD_END_ADDR - startAddr, DEC);
     Serial.print (" Bytes\r\nStart Read Addr: ");
     Serial.print (resumeWriteAddr, DEC);
     Serial.print ("\r\nLoaded HDay:0x");
@@ -142,7 +143,7 @@ int CRunningDuration::SpreadReadMinutes(int startAddr)
 #endif
 
 //update minutes by directly reading bytes from EEPROM
-    for (int i = (startAddr); i < EEPROM.length(); i++)
+    for (int i = (startAddr); i < EEPROM_SPREAD_END_ADDR; i++)
     {
       currentByte = EEPROM.read(i);
 #ifdef DEBUG
@@ -233,9 +234,11 @@ bool CRunningDuration::CheckAndUpdateSpreadMemoryLoop()
     CEEPROM::SafeWriteEEPROMData(EEPROM_DAYS_L_ADDR,LDays);
 
     // resetting spread memory
-    for(int i = EEPPROM_START_ADDR; i < EEPROM.length(); i++)//cleaning minutes data
+    CWatchdog::Checkpoint(WD_EEPROM_ROLLOVER);
+    for(int i = EEPPROM_START_ADDR; i < EEPROM_SPREAD_END_ADDR; i++)//cleaning minutes data
     {
       CEEPROM::SafeWriteEEPROMData(i,0x00);
+      CWatchdog::Kick();                  // the whole spread memory takes about 13 seconds to clear
     }
 
     //resetting EEPROM variables
@@ -268,7 +271,7 @@ int CRunningDuration::SpreadSaveIncrementMinutes(int startAddr)
 
   byte currentByte = EEPROM.read(currentAddr);
   CEEPROM::SafeWriteEEPROMData(currentAddr,currentByte + 1);
-  if( currentAddr == (EEPROM.length() - 1) )
+  if( currentAddr == (EEPROM_SPREAD_END_ADDR - 1) )
   {
     currentAddr = EEPPROM_START_ADDR;//skip location for days
   }
@@ -356,7 +359,7 @@ void CRunningDuration::IncrementTime(int seconds)
 void CRunningDuration::TestNewDay()
 {
   const int TotalMinutesIn1DayMin1 = (24 * 60) - 1;
-  const int AvailableEEPROMSize = (EEPROM.length() - EEPPROM_START_ADDR);
+  const int AvailableEEPROMSize = (EEPROM_SPREAD_END_ADDR - EEPPROM_START_ADDR);
   int MemoryLimitIndex          =  TotalMinutesIn1DayMin1 % AvailableEEPROMSize;//TotalMinutesIn1DayMin1 - AvailableEEPROMSize + 4;
   int LoopCount                 = (int)(TotalMinutesIn1DayMin1 / AvailableEEPROMSize);
 
@@ -376,7 +379,7 @@ void CRunningDuration::TestNewDay()
   this->PrintRunningDuration();
 #endif
 
-  for (int i = EEPPROM_START_ADDR; i < EEPROM.length(); i++)
+  for (int i = EEPPROM_START_ADDR; i < EEPROM_SPREAD_END_ADDR; i++)
   {
       if((i - EEPPROM_START_ADDR) < MemoryLimitIndex)
       {
@@ -0,0 +1,214 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class is dedicated to running the main loop jobs based on a static task table.
+ // Each task has its own period, so the LCD refresh, SD logging or RS232 polling
+ // no longer share the same loop counter.
+ // Timings are computed using unsigned subtractions so that millis() rollover is handled.
+
+#include "Scheduler.h"
+#include "config.h"
+#ifdef IDLE_SLEEP
+#include <avr/sleep.h>
+#endif
+
+CScheduler::CScheduler(SchedulerTask* tasks, byte taskCount)
+{
+  _tasks     = tasks;
+  _taskCount = taskCount;
+}
+
+// releasing every task right now
+void CScheduler::Start()
+{
+  unsigned long now = millis();
+  for(byte i = 0; i < _taskCount; i++)
+  {
+    _tasks[i].NextReleaseMs = now;
+  }
+  _windowStartMs = now;
+}
+
+// picking the most urgent task among the due ones and executing it
+// when several tasks share the same priority, the one released first wins
+bool CScheduler::RunNextTask()
+{
+  unsigned long now = millis();
+  SchedulerTask* selectedTask = NULL;
+
+  for(byte i = 0; i < _taskCount; i++)
+  {
+    SchedulerTask* task = &_tasks[i];
+    if((long)(now - task->NextReleaseMs) < 0)               // task not released yet
+    {
+      continue;
+    }
+    if(selectedTask == NULL
+      || task->Priority < selectedTask->Priority
+      || (task->Priority == selectedTask->Priority
+          && (long)(task->NextReleaseMs - selectedTask->NextReleaseMs) < 0))
+    {
+      selectedTask = task;
+    }
+  }
+
+  if(selectedTask == NULL)
+  {
+    return false;
+  }
+
+  // checking if the task is starting too late
+  unsigned long lateness = now - selectedTask->NextReleaseMs;
+  if(lateness > selectedTask->DeadlineMs)
+  {
+    selectedTask->DeadlineMisses++;
+  }
+
+  unsigned long startUs = micros();
+  selectedTask->Callback();
+  unsigned long runUs = micros() - startUs;
+
+  selectedTask->RunCount++;
+  if(runUs > selectedTask->MaxRunUs)
+  {
+    selectedTask->MaxRunUs = runUs;
+  }
+  if(runUs > selectedTask->BudgetUs)
+  {
+    selectedTask->Overruns++;
+  }
+
+  // computing next release without drifting.
+  // if the task is more than one period late, we don't try to catch up missed runs
+  selectedTask->NextReleaseMs += selectedTask->PeriodMs;
+  if((long)(millis() - selectedTask->NextReleaseMs) >= (long)selectedTask->PeriodMs)
+  {
+    selectedTask->NextReleaseMs = millis() + selectedTask->PeriodMs;
+  }
+  UpdateLoadWindow();
+  return true;
+}
+
+// waiting for the next interrupt when no task is due.
+// In SLEEP_MODE_IDLE the timers, UARTs and external/pin change interrupts keep running,
+// so the MCU wakes up on the timer0 millis() tick (every 1.024ms), the 1Hz timer, serial data,
+// encoder or fan tachometer edges. The loop then checks again for due tasks.
+void CScheduler::Idle()
+{
+  cli();
+  if(GetMsUntilNextRelease() == 0)   // a task got released in the meantime
+  {
+    sei();
+    return;
+  }
+  unsigned long startUs = micros();
+#ifdef IDLE_SLEEP
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  sei();          // the instruction following sei is always executed before any pending interrupt
+  sleep_cpu();    // so no wake up interrupt can be missed between the check above and the sleep
+  sleep_disable();
+#else
+  sei();
+  delay(1);
+#endif
+  _windowIdleUs += micros() - startUs;
+  _windowWakeUps++;
+  UpdateLoadWindow();
+}
+
+// computing the share of time spent running tasks once per measurement window
+void CScheduler::UpdateLoadWindow()
+{
+  unsigned long windowMs = millis() - _windowStartMs;
+  if(windowMs < IDLE_STATS_WINDOW_MS)
+  {
+    return;
+  }
+  unsigned long idleMs = _windowIdleUs / 1000;
+  if(idleMs > windowMs)
+  {
+    idleMs = windowMs;
+  }
+  _activePercent       = (byte)(((windowMs - idleMs) * 100 + windowMs / 2) / windowMs);
+  _windowWakeUpsResult = _windowWakeUps;
+  _windowStartMs      += windowMs;
+  _windowIdleUs        = 0;
+  _windowWakeUps       = 0;
+}
+
+// returns 0 if a task is already due
+unsigned long CScheduler::GetMsUntilNextRelease()
+{
+  unsigned long now = millis();
+  unsigned long minDelay = 0xFFFFFFFF;
+  for(byte i = 0; i < _taskCount; i++)
+  {
+    long delayMs = (long)(_tasks[i].NextReleaseMs - now);
+    if(delayMs <= 0)
+    {
+      return 0;
+    }
+    if((unsigned long)delayMs < minDelay)
+    {
+      minDelay = delayMs;
+    }
+  }
+  return minDelay;
+}
+
+const SchedulerTask* CScheduler::GetTask(byte index)
+{
+  if(index >= _taskCount)
+  {
+    return NULL;
+  }
+  return &_tasks[index];
+}
+
+unsigned int CScheduler::GetOverruns(byte index)
+{
+  if(index >= _taskCount)
+  {
+    return 0;
+  }
+  return _tasks[index].Overruns;
+}
+
+unsigned int CScheduler::GetDeadlineMisses(byte index)
+{
+  if(index >= _taskCount)
+  {
+    return 0;
+  }
+  return _tasks[index].DeadlineMisses;
+}
+
+void CScheduler::ResetStatistics()
+{
+  for(byte i = 0; i < _taskCount; i++)
+  {
+    _tasks[i].Overruns       = 0;
+    _tasks[i].DeadlineMisses = 0;
+    _tasks[i].MaxRunUs       = 0;
+    _tasks[i].RunCount       = 0;
+  }
+}
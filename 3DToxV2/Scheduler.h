@@ -0,0 +1,90 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHEDULER
+#define _SCHEDULER
+
+#include <Arduino.h>
+
+typedef void (*SchedulerCallback)();
+
+// Description of one periodic job of the main loop.
+// The first fields are set once inside the static task table (see main.cpp)
+// the remaining ones are maintained by CScheduler at runtime
+typedef struct {
+  const char*       Name;
+  SchedulerCallback Callback;
+  unsigned long     PeriodMs;       // time between two releases of the task
+  unsigned long     DeadlineMs;     // max lateness allowed between release and start of the task
+  byte              Priority;       // 0 is the most urgent priority
+  unsigned long     BudgetUs;       // max run time allowed for one execution of the task
+
+  unsigned long     NextReleaseMs;  // next time the task has to run
+  unsigned int      Overruns;       // amount of executions that took longer than BudgetUs
+  unsigned int      DeadlineMisses; // amount of executions that started after NextReleaseMs + DeadlineMs
+  unsigned long     MaxRunUs;       // longest execution measured so far
+  unsigned long     RunCount;       // amount of executions since startup
+} SchedulerTask;
+
+// Helper used to declare a task inside the static task table
+#define SCHEDULER_TASK(name, callback, periodMs, deadlineMs, priority, budgetUs) \
+        { name, callback, periodMs, deadlineMs, priority, budgetUs, 0, 0, 0, 0, 0 }
+
+// Cooperative scheduler replacing the fixed order main loop.
+// Every call to RunNextTask() executes at most one due task, choosing the most urgent one.
+// This way a slow task (SD card, RS232 round trip) can only delay the next urgent task
+// (rotary encoder, fan control) by its own duration instead of by the whole loop duration.
+// Time is read from millis() and micros() so the same code runs with a virtual clock on host builds.
+class CScheduler
+{
+  public:
+  CScheduler(SchedulerTask* tasks, byte taskCount);
+  // releases every task now. Should be called once at the end of setup()
+  void Start();
+  // runs the most urgent due task. returns false if no task was due
+  bool RunNextTask();
+  // returns the amount of milliseconds before the next task release
+  unsigned long GetMsUntilNextRelease();
+  // waits for the next interrupt when no task is due (see IDLE_SLEEP inside config.h)
+  void Idle();
+
+  byte GetTaskCount() { return _taskCount; }
+  const SchedulerTask* GetTask(byte index);
+  unsigned int GetOverruns(byte index);
+  unsigned int GetDeadlineMisses(byte index);
+  void ResetStatistics();
+  // CPU load measured over the last IDLE_STATS_WINDOW_MS window
+  byte GetActivePercent() { return _activePercent; }
+  unsigned int GetWakeUpsPerWindow() { return _windowWakeUpsResult; }
+
+  private:
+  void UpdateLoadWindow();
+
+  SchedulerTask* _tasks;
+  byte _taskCount;
+
+  unsigned long _windowStartMs    = 0;    // start of the current load measurement window
+  unsigned long _windowIdleUs     = 0;    // time spent inside Idle() during the current window
+  unsigned int  _windowWakeUps    = 0;
+  unsigned int  _windowWakeUpsResult = 0;
+  byte          _activePercent    = 100;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SEQLOCK
+#define _SEQLOCK
+
+#include <Arduino.h>
+#include "EventQueue.h"
+
+// Sequence lock sharing a multi-byte value between one writer and the readers, without disabling interrupts.
+// The writer makes the sequence odd while it copies the value, then even again.
+// A reader copies the value and retries if the sequence was odd or changed during its copy.
+// - the writer can be an interrupt or the main loop, but there must be a single writer
+// - Read() must not be called from an interrupt when the writer is the main loop:
+//   it would retry forever on an interrupted write, use TryRead() there
+// The sequence is a single byte so it is read and written atomically on AVR.
+template <class T>
+class CSeqLock
+{
+  public:
+  // called from the writer side only
+  void Publish(const T &value)
+  {
+    _sequence++;                // odd: write in progress
+    EVENTQUEUE_BARRIER();
+    _value = value;
+    EVENTQUEUE_BARRIER();
+    _sequence++;                // even: value is consistent
+  }
+
+  // copies a consistent value, retrying while the writer is interrupting the copy
+  void Read(T &value) const
+  {
+    while(!TryRead(value))
+    {
+    }
+  }
+
+  // single copy attempt. returns false if a write was in progress
+  bool TryRead(T &value) const
+  {
+    byte sequence = _sequence;
+    if(sequence & 1)
+    {
+      return false;
+    }
+    EVENTQUEUE_BARRIER();
+    value = _value;
+    EVENTQUEUE_BARRIER();
+    return sequence == _sequence;
+  }
+
+  // amount of values published so far, modulo 128
+  byte GetVersion() const { return _sequence >> 1; }
+
+  private:
+  T             _value;       // the barriers force the copies to be done between the sequence accesses
+  volatile byte _sequence = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TELEMETRY
+#define _TELEMETRY
+
+#include <Arduino.h>
+#include "SeqLock.h"
+#include "PmsParser.h"
+
+// Values measured during one 1Hz tick, published once per tick by PublishTelemetry() (see main.cpp).
+// The LCD views, the SD card log and the console read the same sample, so they never mix
+// values from two different ticks. The settings edited from the LCD (mode, fan speed) are read from CConfig
+typedef struct {
+  unsigned long Tick;             // amount of 1Hz ticks processed since startup
+  int           Days;             // running duration, including the minutes spread inside EEPROM
+  byte          Hours;
+  byte          Minutes;
+  byte          Seconds;
+  int           Pm01;             // last values read from the air quality sensor
+  int           Pm25;
+  int           Pm10;
+  int           Pm25Avg;
+  PmsSample     Pms;              // whole last sensor frame, zeroed until the first frame (Pm25 is -1)
+  byte          AQStatus;         // AirQualityStatus computed from Pm25Avg
+  byte          AQProfile;        // AQProfileIndex giving the levels of AQStatus
+  PmsLinkStatistics PmsLink;      // health of the serial link with the inlet sensor
+  byte          PmsSource;        // PmsSource of the PM values above and of AQStatus
+  byte          OutletLink;       // PmsLinkState of the outlet sensor, LINK_FAILED without DUAL_PMS
+  int           OutletPm25Avg;    // -1 without outlet sensor or until its first frame
+  int           FilterEfficiency; // %, -1 when it can't be measured (see CPmsFusion::GetFilterEfficiency)
+  byte          PmsPower;         // PmsPowerState of the sensor, the PM values are the last measured ones while it sleeps
+  unsigned long LaserTenthsOfHour;
+  byte          FanBoost;         // %, fan boost given by the PM trend (see PmTrend.h)
+  int           Rpm;
+  byte          FanState;         // FanState and latched FanFault of the fan supervisor (see FanSupervisor.h)
+  byte          FanFault;
+  bool          FanCalibrating;   // the fan curve calibration sweep is driving the fan (see FanCurve.h)
+  int           HotEndTemp;       // -1 until received from the 3D printer
+  bool          ComTimedOut;
+  byte          StartupCountDown; // amount of values still ignored at startup, 0 once the measures are valid
+} TelemetrySample;
+
+// 1Hz interrupt statistics, published by the interrupt itself
+typedef struct {
+  unsigned long Ticks;
+  unsigned long LastTickMs;
+  unsigned int  MaxDurationUs;    // worst case duration of the interrupt
+} TickStatistics;
+
+#endif
@@ -27,6 +27,7 @@
 #include "utility.h"
 #include "Constants.h"
 #include "MainSettingsView.h"
+#include "FanSupervisor.h"
 
 //constructor
 ViewMain::ViewMain()
@@ -94,19 +95,11 @@ ViewBase* ViewMain::Select()
 }
 
 // main function that will format and print running duration data on LCD screen
-void ViewMain::DisplayCurrentDuration(char* cStringBuffer)
+void ViewMain::DisplayCurrentDuration(char* cStringBuffer, const TelemetrySample &sample)
 {
     lcd_setCursor(0,0);                                                 // displays the data on the first LCD row
-    int totalMinutes = _config->Minutes +  _config->EEPROMMinutes;
-    int hoursToReport = (int)(totalMinutes / 60);
-    int minutes =  (totalMinutes) % 60;
-    int TotalHours = hoursToReport + _config->Hours +  _config->EEPROMHours;
-    int daysToReport = (TotalHours) / 24;
-    int hours = (TotalHours) % 24;
-    int days = daysToReport + _config->Days + _config->EEPROMDays;
-
     // formats the data to something readable
-    sprintf(cStringBuffer,"  %04dJ %02dH:%02dm:%02ds",days, hours, minutes, _config->Seconds);
+    sprintf(cStringBuffer,"  %04dJ %02dH:%02dm:%02ds",sample.Days, sample.Hours, sample.Minutes, sample.Seconds);
     lcd_print(cStringBuffer);
 }
 
@@ -121,22 +114,34 @@ void ViewMain::DisplayCurrentAQ(char* cStringBuffer)
 }
 
 // formats and display Air quality status on lcd screen
-void ViewMain::DisplayCurrentPM(char* cStringBuffer)
+void ViewMain::DisplayCurrentPM(char* cStringBuffer, const TelemetrySample &sample)
 {
-  int pm25Avg = _config->_pm25->GetAvgPM2_5();
-
   // formats and display air quality status as a level from 0 to 7
   lcd_print("Air Quality    ");
   lcd_setCursor(14,1);
   lcd_print(" (");
-  int currentLevel = 7 - _config->_pm25->ConvertPM2_5ToAirQualityStatus(pm25Avg);
+  int currentLevel = 7 - sample.AQStatus;
   lcd_print(String(currentLevel));
   lcd_print("/7)");
 
   // displays here the textual representation of the air quality level
+  // it is replaced during the fan calibration, by the latched fan fault, or by the fan state while the fan isn't running properly
   lcd_setCursor(0,2);
+  const char* status = AQ_STRING[sample.AQStatus];
+  if(sample.FanCalibrating)
+  {
+    status = "FAN CALIBRATION";
+  }
+  else if(sample.FanFault != FAN_OK)
+  {
+    status = FAN_FAULT_STRING[sample.FanFault];
+  }
+  else if(sample.FanState >= FAN_DEGRADED)
+  {
+    status = FAN_STATE_STRING[sample.FanState];
+  }
   sprintf(cStringBuffer,"%-20s",
-         AQ_STRING[_config->_pm25->ConvertPM2_5ToAirQualityStatus(pm25Avg)]);
+         status);
   lcd_print(cStringBuffer);
 }
 
@@ -145,13 +150,13 @@ void ViewMain::DisplayCurrentPM(char* cStringBuffer)
 // this screen will be displayed untill IgnoreFirstValuesInitValue goes to 0.
 // so to increase or decrease this period, just update this value
 // the screen can also be removed if used is pressing the knob to go directly into settings view
-void ViewMain::DisplayBootScreen(char* cStringBuffer)
+void ViewMain::DisplayBootScreen(char* cStringBuffer, const TelemetrySample &sample)
 {
   lcd_setCursor(0,0);
   lcd_print("      3DTox V2");
 
   lcd_setCursor(0,2);
-  unsigned int percent = (_config->IgnoreFirstValuesInitValue - _config->IgnoreFirstValues) * 100 / _config->IgnoreFirstValuesInitValue;
+  unsigned int percent = (_config->IgnoreFirstValuesInitValue - sample.StartupCountDown) * 100 / _config->IgnoreFirstValuesInitValue;
   sprintf(cStringBuffer, "   ANALYSING %3d%%", percent);
   lcd_print(cStringBuffer);
 
@@ -167,28 +172,28 @@ void ViewMain::DisplayBootScreen(char* cStringBuffer)
   lcd_print(cStringBuffer);
 }
 
-void ViewMain::DisplayFanSpeedOrHotEndTemperatureIfAvailable(char* cStringBuffer)
+void ViewMain::DisplayFanSpeedOrHotEndTemperatureIfAvailable(char* cStringBuffer, const TelemetrySample &sample)
 {
   lcd_setCursor(15,2);
   // in RS232 mode HotEndTemp will be set and different from -1
   // in other modes HotEndTemp will be set to -1
   // displays the current hot end temperature received from RS232 when Available
   // displays T:--- when not available
-  if(_config->HotEndTemp > -1) // in RS232 mode
+  if(sample.HotEndTemp > -1) // in RS232 mode
   {
     sprintf(cStringBuffer,"T:%3d",
-               (int)(_config->HotEndTemp));
+               sample.HotEndTemp);
     lcd_print(cStringBuffer);
   }
   else if((_config->CurrentAQMode == RS_232)
-    && (_config->hasSerialComTimedOut == true))
+    && (sample.ComTimedOut == true))
   {
       lcd_print("T:---");
   }
   else                        // in other modes we display fan RPM instead
   {
     sprintf(cStringBuffer,"%5d",
-           _config->Rpm1);
+           sample.Rpm);
     lcd_print(cStringBuffer);
   }
 }
@@ -198,21 +203,23 @@ void ViewMain::DisplayFanSpeedOrHotEndTemperatureIfAvailable(char* cStringBuffer
 void ViewMain::Refresh()
 {
   char cStringBuffer[20];
+  TelemetrySample sample;
+  _config->Telemetry.Read(sample);     // all the values displayed come from the same tick
 
   lcd_setCursor(0,1);                 // resets cursot position to the top left corner of the screen
   // checks wether we are still in the initializing sequence
-  if(_config->IgnoreFirstValues > 0)
+  if(sample.StartupCountDown > 0)
   {
-    DisplayBootScreen(&cStringBuffer[0]);
+    DisplayBootScreen(&cStringBuffer[0], sample);
     return;
   }
 
   // Displays after initializing period has elapsed
   // part of Air quality textual status and Température or fan speed are displayed on the same LCD line
-  DisplayCurrentPM(&cStringBuffer[0]);
-  DisplayFanSpeedOrHotEndTemperatureIfAvailable(&cStringBuffer[0]);
+  DisplayCurrentPM(&cStringBuffer[0], sample);
+  DisplayFanSpeedOrHotEndTemperatureIfAvailable(&cStringBuffer[0], sample);
 
   DisplayCurrentAQ(&cStringBuffer[0]);
 
-  DisplayCurrentDuration(&cStringBuffer[0]);
+  DisplayCurrentDuration(&cStringBuffer[0], sample);
 }
@@ -32,10 +32,10 @@ ViewMain(); //constructor
   ViewBase* Select() override;
   void Refresh() override;
 private:
-  void DisplayCurrentDuration(char* cStringBuffer);
+  void DisplayCurrentDuration(char* cStringBuffer, const TelemetrySample &sample);
   void DisplayCurrentAQ(char* cStringBuffer);
-  void DisplayCurrentPM(char* cStringBuffer);
-  void DisplayBootScreen(char* cStringBuffer);
-  void DisplayFanSpeedOrHotEndTemperatureIfAvailable(char* cStringBuffer);
+  void DisplayCurrentPM(char* cStringBuffer, const TelemetrySample &sample);
+  void DisplayBootScreen(char* cStringBuffer, const TelemetrySample &sample);
+  void DisplayFanSpeedOrHotEndTemperatureIfAvailable(char* cStringBuffer, const TelemetrySample &sample);
 };
 #endif  //_VIEWMAIN
@@ -0,0 +1,210 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // This class detects main loop stalls using the hardware watchdog.
+ // The watchdog runs in interrupt + reset mode: when the main loop doesn't restart it within
+ // WATCHDOG_TIMEOUT, the interrupt saves the last checkpointed stage into the EEPROM stall history
+ // then lets the watchdog reboot the board.
+ // If the stall happens with interrupts disabled, the interrupt can't run: the stage is then
+ // recovered at the next boot from the .noinit RAM, which isn't cleared by a watchdog reset.
+ // The bootloader may clear MCUSR before starting the firmware, so the reset flags can't always tell
+ // a watchdog reset: without any flag, the reboot is a stall when the .noinit RAM is still armed
+ // and the last stage was a main loop task (an external reset mostly hits the idle sleep).
+ //
+ // EEPROM stall history layout, starting at EEPROM_STALL_HISTORY_ADDR:
+ // | magic (1) | stall count (2) | reserved (1) | STALL_HISTORY_RECORDS x StallRecord (ring buffer) |
+
+#include "Watchdog.h"
+#include "config.h"
+#include "Constants.h"
+#include "EEPROM_functions.h"
+
+#ifdef HOST_BUILD
+#define NOINIT
+#else
+#define NOINIT __attribute__((section(".noinit")))
+#endif
+
+static const byte STALL_HISTORY_MAGIC  = 0x57;  // tells the history area has been initialized
+static const byte STALL_RECORDED_MAGIC = 0xA5;  // WatchdogState::Recorded value once the interrupt saved the stall
+static const byte WATCHDOG_ARMED_MAGIC = 0x3C;  // WatchdogState::Armed value while the firmware runs
+
+static const int  EEPROM_STALL_COUNT_ADDR   = EEPROM_STALL_HISTORY_ADDR + 1;
+static const int  EEPROM_STALL_RECORDS_ADDR = EEPROM_STALL_HISTORY_ADDR + 4;
+static_assert(4 + STALL_HISTORY_RECORDS * sizeof(StallRecord) <= EEPROM_STALL_HISTORY_SIZE, "stall history doesn't fit inside its EEPROM area");
+
+static const char *WATCHDOG_STAGE_STRING[] = {
+    FOREACH_WATCHDOG_STAGE(GENERATE_STRING)
+};
+
+WatchdogState CWatchdog::_state NOINIT;
+bool CWatchdog::_wasStallReset  = false;
+byte CWatchdog::_lastStallStage = WATCHDOG_STAGE_COUNT;
+
+static uint8_t _resetFlags NOINIT;   // MCUSR content saved at startup
+
+#ifndef HOST_BUILD
+// runs before the RAM initialization and the constructors.
+// after a watchdog reset, the watchdog stays enabled with its shortest timeout (16ms)
+// so it must be stopped before the slow initialization of the firmware
+void WatchdogEarlyInit() __attribute__((naked, used, section(".init3")));
+void WatchdogEarlyInit()
+{
+  _resetFlags = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+#endif
+
+void CWatchdog::Begin()
+{
+#ifdef HOST_BUILD
+  _resetFlags = MCUSR;
+  MCUSR = 0;
+#endif
+  // checking the noinit RAM is still consistent, otherwise the stage is unknown
+  byte stage = _state.Stage;
+  if(stage != (byte)~_state.StageCheck || stage >= WATCHDOG_STAGE_COUNT)
+  {
+    stage = WATCHDOG_STAGE_COUNT;
+  }
+  bool stallReset = _resetFlags & (1 << WDRF);
+  if(_resetFlags == 0)                              // flags cleared by the bootloader
+  {
+    stallReset = _state.Armed == WATCHDOG_ARMED_MAGIC
+                 && (_state.Recorded == STALL_RECORDED_MAGIC || (stage < WATCHDOG_STAGE_COUNT && stage != WD_IDLE));
+  }
+  if(stallReset)
+  {
+    if(_state.Recorded != STALL_RECORDED_MAGIC)   // the interrupt couldn't save the stall
+    {
+      SaveRecord(stage, ssBOOT, _state.LastLoopMs, _state.LoopCount);
+    }
+    _wasStallReset  = true;
+    _lastStallStage = stage;
+  }
+
+  _state.Recorded   = 0;
+  _state.Armed      = WATCHDOG_ARMED_MAGIC;
+  _state.LoopCount  = 0;
+  _state.LastLoopMs = 0;
+  Checkpoint(WD_SETUP);
+
+#ifdef STALL_WATCHDOG
+  wdt_enable(WATCHDOG_TIMEOUT);
+  WDTCSR |= (1 << WDIE);          // first timeout calls the interrupt, the next one resets the board
+#endif
+}
+
+void CWatchdog::OnTimeout()
+{
+  if(_state.Recorded != STALL_RECORDED_MAGIC)
+  {
+    SaveRecord(_state.Stage, ssINTERRUPT, millis(), _state.LoopCount);
+    _state.Recorded = STALL_RECORDED_MAGIC;
+  }
+  // rebooting right away instead of waiting for a second timeout
+  wdt_enable(WDTO_15MS);
+  for(;;)
+  {
+    delayMicroseconds(100);
+  }
+}
+
+// writing the record over the oldest one. takes about 40ms (EEPROM write time)
+void CWatchdog::SaveRecord(byte stage, byte source, uint32_t uptimeMs, uint32_t loopCount)
+{
+  uint16_t count = GetStallCount();
+  StallRecord record;
+  record.Stage     = stage;
+  record.Source    = source;
+  record.UptimeMs  = uptimeMs;
+  record.LoopCount = loopCount;
+  EEPROM.put(EEPROM_STALL_RECORDS_ADDR + (count % STALL_HISTORY_RECORDS) * sizeof(StallRecord), record);
+  count++;
+  EEPROM.put(EEPROM_STALL_COUNT_ADDR, count);
+  CEEPROM::SafeWriteEEPROMData(EEPROM_STALL_HISTORY_ADDR, STALL_HISTORY_MAGIC);
+}
+
+unsigned int CWatchdog::GetStallCount()
+{
+  if(EEPROM.read(EEPROM_STALL_HISTORY_ADDR) != STALL_HISTORY_MAGIC)
+  {
+    return 0;
+  }
+  uint16_t count;
+  EEPROM.get(EEPROM_STALL_COUNT_ADDR, count);
+  return count;
+}
+
+bool CWatchdog::GetRecord(byte index, StallRecord &record)
+{
+  uint16_t count = GetStallCount();
+  if(index >= STALL_HISTORY_RECORDS || index >= count)
+  {
+    return false;
+  }
+  byte slot = (count - 1 - index) % STALL_HISTORY_RECORDS;
+  EEPROM.get(EEPROM_STALL_RECORDS_ADDR + slot * sizeof(StallRecord), record);
+  return true;
+}
+
+void CWatchdog::ClearHistory()
+{
+  uint16_t count = 0;
+  EEPROM.put(EEPROM_STALL_COUNT_ADDR, count);
+  CEEPROM::SafeWriteEEPROMData(EEPROM_STALL_HISTORY_ADDR, STALL_HISTORY_MAGIC);
+}
+
+// stage names without the WD_ prefix
+const char* CWatchdog::GetStageName(byte stage)
+{
+  if(stage >= WATCHDOG_STAGE_COUNT)
+  {
+    return "UNKNOWN";
+  }
+  return WATCHDOG_STAGE_STRING[stage] + 3;
+}
+
+// prints the stall history, most recent first
+void CWatchdog::PrintHistory(Print &output)
+{
+  output.print(F("STALLS "));
+  output.println(GetStallCount());
+  output.println(F("STAGE UPTIME_MS LOOPS SOURCE"));
+  StallRecord record;
+  for(byte i = 0; GetRecord(i, record); i++)
+  {
+    output.print(GetStageName(record.Stage));
+    output.print(' ');
+    output.print(record.UptimeMs);
+    output.print(' ');
+    output.print(record.LoopCount);
+    output.print(' ');
+    output.println(record.Source == ssINTERRUPT ? F("INTERRUPT") : F("BOOT"));
+  }
+}
+
+// watchdog timeout: the main loop didn't run for WATCHDOG_TIMEOUT
+ISR(WDT_vect)
+{
+  CWatchdog::OnTimeout();
+}
@@ -0,0 +1,127 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WATCHDOG
+#define _WATCHDOG
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include "utility.h"
+
+// main loop stages reported by the stall detector
+//have enum in sync and being able to get string from enum name
+#define FOREACH_WATCHDOG_STAGE(STAGE) \
+        STAGE(WD_SETUP)   \
+        STAGE(WD_SCHEDULER)   \
+        STAGE(WD_IDLE)   \
+        STAGE(WD_ENCODER)   \
+        STAGE(WD_FAN)   \
+        STAGE(WD_EVENTS)   \
+        STAGE(WD_PMS_READ)   \
+        STAGE(WD_DISPLAY)   \
+        STAGE(WD_BUTTON)   \
+        STAGE(WD_COM_WRITE)   \
+        STAGE(WD_COM_READ)   \
+        STAGE(WD_SD_INIT)   \
+        STAGE(WD_SD_WRITE)   \
+        STAGE(WD_CONSOLE)   \
+        STAGE(WD_EEPROM_SAVE)   \
+        STAGE(WD_EEPROM_ROLLOVER)   \
+        STAGE(WD_TEST)   \
+        STAGE(WD_FAN_SUPERVISOR)   \
+
+enum WatchdogStage {
+    FOREACH_WATCHDOG_STAGE(GENERATE_ENUM)
+    WATCHDOG_STAGE_COUNT
+};
+
+// how a stall record was saved
+enum eStallSource
+{
+  ssINTERRUPT,    // by the watchdog interrupt, while the firmware was stuck
+  ssBOOT          // at the next boot from the noinit RAM: interrupts were disabled during the stall
+};
+
+// one entry of the stall history stored in EEPROM (fixed size types, same layout on host builds)
+typedef struct {
+  uint8_t  Stage;
+  uint8_t  Source;
+  uint32_t UptimeMs;    // millis() when the stall was detected (last loop iteration for ssBOOT records)
+  uint32_t LoopCount;   // main loop iterations since boot
+} __attribute__((packed)) StallRecord;
+
+// state kept in the .noinit RAM section so it survives the watchdog reset
+typedef struct {
+  volatile uint8_t  Stage;
+  volatile uint8_t  StageCheck;   // ~Stage, tells whether the RAM content survived the reset
+  volatile uint8_t  Recorded;     // set by the interrupt once the stall is saved into EEPROM
+  volatile uint8_t  Armed;        // set by Begin(), tells a warm reboot from a power up when the reset flags are lost
+  volatile uint32_t LoopCount;
+  volatile uint32_t LastLoopMs;
+} WatchdogState;
+
+// Stall detector based on the hardware watchdog in interrupt + reset mode.
+// loop() restarts the watchdog on each iteration and every stage of the main loop stores its
+// stage ID with Checkpoint(). If no loop iteration happens within WATCHDOG_TIMEOUT, the watchdog
+// interrupt saves the current stage, uptime and loop counter into the EEPROM stall history and reboots.
+// The history is kept at the end of the EEPROM (see EEPROM_functions.h) and printed by the STALLS console command.
+class CWatchdog
+{
+  public:
+  // recovers the stall state left by the previous run and starts the watchdog (see STALL_WATCHDOG inside config.h)
+  static void Begin();
+  // called once per main loop iteration
+  static void LoopTick()
+  {
+    wdt_reset();
+    _state.LoopCount++;
+    _state.LastLoopMs = millis();
+  }
+  // marks the main loop stage currently running
+  static void Checkpoint(byte stage)
+  {
+    _state.Stage      = stage;
+    _state.StageCheck = ~stage;
+  }
+  // restarts the watchdog inside long but bounded jobs (full EEPROM clearing)
+  static void Kick() { wdt_reset(); }
+  // called from the watchdog interrupt only
+  static void OnTimeout();
+
+  // true when the previous run ended with a stall
+  static bool WasStallReset() { return _wasStallReset; }
+  static byte GetLastStallStage() { return _lastStallStage; }
+  // amount of stalls recorded since the history was cleared
+  static unsigned int GetStallCount();
+  // index 0 is the most recent stall. returns false if there is no such record
+  static bool GetRecord(byte index, StallRecord &record);
+  static void ClearHistory();
+  static const char* GetStageName(byte stage);
+  static void PrintHistory(Print &output);
+
+  private:
+  static void SaveRecord(byte stage, byte source, uint32_t uptimeMs, uint32_t loopCount);
+
+  static WatchdogState _state;
+  static bool _wasStallReset;
+  static byte _lastStallStage;
+};
+
+#endif
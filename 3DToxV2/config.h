@@ -29,7 +29,9 @@
 #ifndef _CONFIG
 #define _CONFIG
 #include "Pm25.h"
+#include "PmsFusion.h"
 #include "Constants.h"
+#include "Telemetry.h"
 
 
 // Uncomment this line if you are performing your first run
@@ -39,6 +41,54 @@
 //#define FIRSTRUN
 //#define DEBUG
 
+// Uncomment this line to measure the duration of each main loop stage
+// Statistics are printed with the PROFILE console command and periodically written to the SD card log
+// When commented, the profiler doesn't use any flash, SRAM or CPU time
+//#define PROFILER
+
+// Uncomment this line to record every external input into the INPUT_TRACE_FILE file of the SD card
+// (sensor frames, 3D printer replies, knob, fan tachometer). The trace can be replayed by the native build
+// with the --replay option to reproduce a field behaviour. Uses INPUT_TRACE_BUFFER_SIZE bytes of SRAM
+//#define INPUT_RECORDER
+
+// Comment this line to busy wait instead of sleeping when no main loop task is due
+// The MCU is put in idle sleep mode and woken up by any interrupt (timer0 tick every 1ms, 1Hz timer,
+// serial ports, rotary encoder, fan tachometer), so the loop reaction time doesn't change
+#define IDLE_SLEEP
+
+// Comment this line to keep the air quality sensor always on
+// When enabled, the sensor is put to sleep with its SET pin when the air has been clean for PMS_STABLE_BEFORE_SLEEP_S
+// and the 3D printer is known to be cold (RS232 link with the printer working), then woken up PMS_DUTY_AWAKE_S + PMS_WARMUP_S every PMS_SLEEP_S to measure again.
+// This saves the laser lifetime. The laser on hours are counted in both cases (STATUS console command)
+#define PMS_DUTY_CYCLE
+
+// Comment this line to only drive the fan from the averaged PM2.5 in AUTO and QUIET modes
+// When enabled, the fan is boosted as soon as the raw PM values rise fast, before the average catches up (see PmTrend.h)
+#define PM_TREND_BOOST
+
+// Comment this line to measure the fan speed by counting the tachometer pulses during MEASUREMENT_PERIOD_MS
+// When enabled, each pulse is timestamped and the speed is computed from the median period of the last pulses
+// (see FanController.cpp): it follows the fan within a few pulses and ignores the glitches of the Hall sensor wire
+#define FAN_TACH_PERIOD
+
+// Uncomment this line if a second air quality sensor is installed at the filter outlet
+// The sensor at the nozzle keeps driving the fan, the outlet one measures the filter efficiency (STATUS console command)
+// and takes over the air quality status when the nozzle sensor goes silent (see PmsFusion.h). Its SET and RESET pins are PMS_OUTLET_SET_PIN / PMS_OUTLET_RESET_PIN.
+// Note: on the RAMPS wiring of this firmware, the RX pin of each free hardware serial port is already used
+// (Serial1: fan tachometer on pin 19, Serial2: LCD on pins 16/17), so one of them has to be rewired first
+// and given to the outlet sensor, e.g. #define PMS_OUTLET_SERIAL Serial1 (there is no default port)
+//#define DUAL_PMS
+//#define PMS_OUTLET_SERIAL Serial1
+
+#if defined(DUAL_PMS) && !defined(PMS_OUTLET_SERIAL)
+#error "rewire a serial port and define PMS_OUTLET_SERIAL"
+#endif
+
+// Comment this line to disable the watchdog stall detector (e.g. while debugging)
+// When enabled, a main loop blocked for more than WATCHDOG_TIMEOUT reboots the board and the blocked
+// stage is saved into the EEPROM stall history, printed by the STALLS console command
+#define STALL_WATCHDOG
+
 
 enum eStatus
 {
@@ -66,8 +116,11 @@ public:
   // Initial RPM at startup
   // this value is updated every seconds or so from the Main class once a new computed value is available
   int Rpm1 = 0;
-  // Pointer to Cpm25 class used to read information from the Air Quality device
+  // Pointer to Cpm25 class used to read information from the Air Quality device (at the nozzle)
+  // Its air quality profile is the one selected by the user
   CPm25* _pm25;
+  // Inlet and optional outlet sensors, the fan speed follows GetControlSensor()
+  CPmsFusion* _pmsFusion;
   // Boolean used to check if the SD card has already been initialized
   bool SDCARD_INITIALIZED = false;
   eStatus Status          = sIDLE;
@@ -121,6 +174,10 @@ public:
  // Variable used to handle the cases when data hasn't been received from COM port for some times
  // It is used to update the display information and notice the user that the COM has been lost
  bool hasSerialComTimedOut = true;
+
+ // Coherent copy of the measured values, published once per second by the main loop
+ // and read by the views, the SD card log and the console
+ CSeqLock<TelemetrySample> Telemetry;
 private:
 
 };
@@ -30,13 +30,15 @@
 #include "utility.h"
 #include "ViewBase.h"
 #include "ViewMain.h"
+#include "RotaryEncoder.h"
+#include "InputRecorder.h"
 #include "CmdParser/CmdBuffer.hpp"
 #include "CmdParser/CmdCallback.hpp"
 #include "CmdParser/CmdParser.hpp"
 
 
 // Setting up FanController here
-FanController fan(PWM_FAN_INPUT_PIN_1, MEASUREMENT_PERIOD_MS, RPM_SPEED_DEVIDER, PWM_OUTPUT_CONTROL_PIN);
+FanController fan(PWM_FAN_INPUT_PIN_1, MEASUREMENT_PERIOD_MS, RPM_SPEED_DEVIDER, PWM_OUTPUT_CONTROL_PIN, MAX_FAN_RPM);
 
 // setup all IO pins here
 void SetupPins()
@@ -86,6 +88,9 @@ void SetupInitialRunningDuration ()
 void LoadDataFromEeprom ()
 {
     _runningDuration->LoadRunningDuration();
+    _pmsPower->LoadLaserDuration();
+    _fanSupervisor->LoadFault();
+    _fanCurve->Load();
     byte AqMode       = EEPROM.read(EEPROM_MODE);           // possible modes: AUTO;//QUIET; // MANUAL;
     byte BaudrateMode = EEPROM.read(EEPROM_BAUDRATE);       // possible values {"9600", "57600", "115200", "250000"};
 
@@ -99,12 +104,21 @@ void LoadDataFromEeprom ()
     else if(BaudrateMode == 2){_config->RxTxBaudrate = 57600;}
     else if(BaudrateMode == 3){_config->RxTxBaudrate = 115200;}
     else if(BaudrateMode == 4){_config->RxTxBaudrate = 250000;}
+    //-------------------Loading air quality profile (an unknown value loads CLEAN_FILTER)
+    _config->_pmsFusion->SetAQProfile(EEPROM.read(EEPROM_AQ_PROFILE_ADDR));
 }
 
 
 void setup() {
+  CWatchdog::Begin();                                             // saving the previous stall if any, then starting the watchdog
 
-  _config->_pm25 = new CPm25((int)SET_PIN, (int)RESET_PIN);       // setup Air quality sensor pins
+  _config->_pm25 = new CPm25(&Serial3, (int)SET_PIN, (int)RESET_PIN, itPMS_DATA);   // setup Air quality sensor pins, Serial3 is mapped on special pins
+#ifdef DUAL_PMS
+  _config->_pmsFusion = new CPmsFusion(_config->_pm25,
+                                       new CPm25(&PMS_OUTLET_SERIAL, PMS_OUTLET_SET_PIN, PMS_OUTLET_RESET_PIN, itPMS_OUTLET_DATA));
+#else
+  _config->_pmsFusion = new CPmsFusion(_config->_pm25, NULL);
+#endif
   _currentView   = new ViewMain();                                // loading main view
   _currentView->SetConfig(_config);                               // providing current config to main view
   SetupPins();                                                    // setup IO pins
@@ -112,10 +126,8 @@ void setup() {
   lcd_init();                                                     // Init LCD display
   lcd_clear();                                                    // clear LCD
 
-// initialize rotary encoder state
-  LastStateBTN_ENC = digitalReadFast(BTN_ENC);
-  LastStateBTN_EN1 = digitalReadFast(BTN_EN1);
-  LastStateBTN_EN2 = digitalReadFast(BTN_EN2);
+// initialize rotary encoder state and start sampling it from the timer0 interrupt
+  CRotaryEncoder::Begin();
 
   // using software Serial because Hardware serial won't work using the RS232 modules
   _SoftwareSerial.begin(_config->RxTxBaudrate);
@@ -125,8 +137,14 @@ void setup() {
   ConfigureRegisters();                                            // COnfigure registers for timings
 
   fan.begin();                                                     // Startup the fan
-  _config->CurrentPwmDutyCyclePercent = 100;                       // setting default fan speed to 100% speed
-  SetFanSpeed(_config->CurrentPwmDutyCyclePercent);
+  _config->CurrentPwmDutyCyclePercent = 100;                       // setting default fan speed to 100% speed, the fan task ramps it up
+
+  SetupConsole();                                                  // USB serial diagnostics console
+#ifdef INPUT_RECORDER
+  CInputRecorder::Begin();                                         // starting a new session inside the input trace
+#endif
+  PublishTelemetry();                                              // first sample for the views, before the first tick
+  _scheduler.Start();                                              // releasing all main loop tasks
 }
 
 // function dedidacted to configureing registers mainly for 1Hz interrupt
@@ -206,12 +224,15 @@ void MonitorAttachedDevices()
   double ticker1 = _config->TickCounter1;
   ResetCounters();
 
-  _config->_pm25->ReadValues();
+  CWatchdog::Checkpoint(WD_PMS_READ);
+  _config->_pmsFusion->ReadValues();
 
   if(_config->IgnoreFirstValues > 0)// ignoring the very first measurements to prevent false alarm;
   {
     _config->IgnoreFirstValues--;
   }
+  _config->_pmsFusion->Update();   // selecting the sensor driving the fan
+  _pmsPower->Update();             // putting the sensors to sleep or waking them up
 }
 
 // checking if Baudrate settings has changed and applying new settings if needed
@@ -227,45 +248,143 @@ void ResetComIfNeeded()
 // checking if fan speed has been updated and applying new speed to it
 void UpdateFanSpeedIfNeeded()
 {
-  // adjust fan speed based on current settings
-  if( _config->waitCyclesBeforeUpdatingSpeed == 0)
+  // adjust fan speed based on current settings, the duty cycle is ramped towards it,
+  // then the fan supervisor overrides it while kick starting the fan.
+  // The calibration sweep applies its steps at once: it measures the fan, not the ramp
+  if(_fanCurve->IsCalibrating())
   {
-    byte currentFanSpeed = GetPWMFanDutyCycle();
-
-    if(currentFanSpeed != _config->CurrentPwmDutyCyclePercent)
-    {
-      SetFanSpeed(_config->CurrentPwmDutyCyclePercent);
-    }
+    _fanRamp->SetDutyCycle(_fanCurve->GetCalibrationDuty());
+  }
+  else if( _config->waitCyclesBeforeUpdatingSpeed == 0)
+  {
+    _fanRamp->SetTarget(_fanRpmControl->GetDutyCycle(_config->CurrentPwmDutyCyclePercent), millis());
   }
   else {
     _config->waitCyclesBeforeUpdatingSpeed -= 1;
   }
+
+  byte dutyCycle = _fanRamp->Update(millis());
+  if(!_fanCurve->IsCalibrating())
+  {
+    dutyCycle = _fanSupervisor->GetDutyCycle(dutyCycle);
+  }
+  if(GetPWMFanDutyCycle() != dutyCycle)
+  {
+    SetFanSpeed(dutyCycle);
+  }
 }
 
-// logging current telemetry stored in config object into to SD card
-void LogDataToSdIfAvailable(AirQualityStatus currentAQStatus)
+// copying the values measured during the last tick into the telemetry snapshot
+// called once per tick, so the views, the SD card log and the console display the same sample
+void PublishTelemetry()
 {
-  char cdataString[128];
-  sprintf(cdataString,"%04dJ %02dH:%02dm:%02ds|MODE:%-09s|PM1:%3i| PM2.5:%3i| PM10:%3i| SPEED:%3i%%| RPM:%5i| AQ:%14s|T:%3i",
-                      _config->Days, _config->Hours, _config->Minutes, _config->Seconds,
+  static unsigned long tick = 0;
+  TelemetrySample sample;
+  sample.Tick = tick++;
+
+  // running duration including the minutes spread inside EEPROM
+  int totalMinutes  = _config->Minutes + _config->EEPROMMinutes;
+  int totalHours    = totalMinutes / 60 + _config->Hours + _config->EEPROMHours;
+  sample.Days       = totalHours / 24 + _config->Days + _config->EEPROMDays;
+  sample.Hours      = totalHours % 24;
+  sample.Minutes    = totalMinutes % 60;
+  sample.Seconds    = _config->Seconds;
+
+  CPm25* sensor     = _config->_pmsFusion->GetControlSensor();
+  sample.Pm01       = sensor->GetPM01();
+  sample.Pm25       = sensor->GetPM2_5();
+  sample.Pm10       = sensor->GetPM10();
+  sample.Pm25Avg    = sensor->GetAvgPM2_5();
+  sample.Pms        = sensor->GetSample();
+  _config->_pm25->GetLinkStatistics(sample.PmsLink);
+  sample.PmsSource  = _config->_pmsFusion->GetSource();
+  sample.OutletLink = LINK_FAILED;
+  sample.OutletPm25Avg    = -1;
+  if(_config->_pmsFusion->GetOutlet() != NULL)
+  {
+    sample.OutletLink    = _config->_pmsFusion->GetOutlet()->GetLinkState();
+    sample.OutletPm25Avg = _config->_pmsFusion->GetOutlet()->GetAvgPM2_5();
+  }
+  sample.FilterEfficiency = _config->_pmsFusion->GetFilterEfficiency();
+  sample.PmsPower   = _pmsPower->GetState();
+  sample.LaserTenthsOfHour = _pmsPower->GetLaserTenthsOfHour();
+  sample.AQStatus   = sensor->ConvertPM2_5ToAirQualityStatus(sample.Pm25Avg);
+  sample.AQProfile  = sensor->GetAQProfileIndex();
+  sample.FanBoost   = sensor->GetTrend().GetBoost();
+  sample.Rpm        = _config->Rpm1;
+  sample.FanState   = _fanSupervisor->GetState();
+  sample.FanFault   = _fanSupervisor->GetFault();
+  sample.FanCalibrating = _fanCurve->IsCalibrating();
+  sample.HotEndTemp = (int)_config->HotEndTemp;
+  sample.ComTimedOut      = _config->hasSerialComTimedOut;
+  sample.StartupCountDown = _config->IgnoreFirstValues;
+  _config->Telemetry.Publish(sample);
+}
+
+// logging the current telemetry sample into to SD card
+void LogDataToSdIfAvailable()
+{
+  TelemetrySample sample;
+  _config->Telemetry.Read(sample);
+  char cdataString[336];
+  sprintf(cdataString,"%04dJ %02dH:%02dm:%02ds|MODE:%-09s|PM1:%3i| PM2.5:%3i| PM10:%3i| SPEED:%3i%%| RPM:%5i| AQ:%14s|T:%3i|N:%u,%u,%u,%u,%u,%u"
+                      "|%s|FR:%lu|CS:%u|FE:%u|RS:%u|SR:%u|DB:%lu|GAP:%lu|FAN:%s|%s",
+                      sample.Days, sample.Hours, sample.Minutes, sample.Seconds,
                       AQMODE_STRING[_config->CurrentAQMode],
-                      _config->_pm25->GetPM01(),
-                      _config->_pm25->GetPM2_5(),
-                      _config->_pm25->GetPM10(),
+                      sample.Pm01,
+                      sample.Pm25,
+                      sample.Pm10,
                       _config->CurrentPwmDutyCyclePercent,
-                      _config->Rpm1,
-                      AQ_STRING[currentAQStatus],
-                     (int)_config->HotEndTemp);
+                      sample.Rpm,
+                      AQ_STRING[sample.AQStatus],
+                      sample.HotEndTemp,
+                      sample.Pms.Particles[pbOVER_0_3UM],
+                      sample.Pms.Particles[pbOVER_0_5UM],
+                      sample.Pms.Particles[pbOVER_1_0UM],
+                      sample.Pms.Particles[pbOVER_2_5UM],
+                      sample.Pms.Particles[pbOVER_5_0UM],
+                      sample.Pms.Particles[pbOVER_10UM],
+                      PMS_LINK_STRING[sample.PmsLink.State],
+                      sample.PmsLink.Frames,
+                      sample.PmsLink.ChecksumErrors,
+                      sample.PmsLink.FramingErrors,
+                      sample.PmsLink.Resyncs,
+                      sample.PmsLink.ShortReads,
+                      sample.PmsLink.DiscardedBytes,
+                      sample.PmsLink.MaxFrameGapMs,
+                      FAN_STATE_STRING[sample.FanState],
+                      FAN_FAULT_STRING[sample.FanFault]);
+#ifdef DUAL_PMS
+  // outlet sensor: averaged PM2.5, filter efficiency and sensor driving the fan
+  sprintf(cdataString + strlen(cdataString), "|OPM:%i|EFF:%i|%s|%s",
+          sample.OutletPm25Avg, sample.FilterEfficiency,
+          PMS_LINK_STRING[sample.OutletLink], PMS_SOURCE_STRING[sample.PmsSource]);
+#endif
   String dataString = String(cdataString);
-  if(digitalRead(SD_DETECT_PIN) == LOW)//check if sd card is present
+  byte sdDetect = digitalRead(SD_DETECT_PIN);
+#ifdef INPUT_RECORDER
+  CInputRecorder::RecordSdDetect(sdDetect);
+#endif
+  if(sdDetect == LOW)//check if sd card is present
   {
+    CWatchdog::Checkpoint(WD_SD_INIT);
     if(InitializeSDCard())
     {
+      CWatchdog::Checkpoint(WD_SD_WRITE);
       SDFile dataFile = SD.open("datalog.txt", FILE_WRITE);
       // if the file is available, write to it:
       if (dataFile)
       {
         dataFile.println(dataString);
+#ifdef PROFILER
+        // adding periodically the profiler summary to the log
+        ProfilerSdSummaryCountDown--;
+        if(ProfilerSdSummaryCountDown <= 0)
+        {
+          CProfiler::PrintSummary(dataFile);
+          ProfilerSdSummaryCountDown = PROFILER_SD_SUMMARY_PERIOD_S;
+        }
+#endif
         dataFile.close();
         // print to the serial port too:
       }
@@ -277,12 +396,34 @@ void LogDataToSdIfAvailable(AirQualityStatus currentAQStatus)
   }
 }
 
+#ifdef INPUT_RECORDER
+// appending the recorded inputs to the trace file of the SD card
+// the inputs stay in RAM while the card is missing, new records are dropped once the buffer is full
+void FlushInputTrace()
+{
+  if(CInputRecorder::IsEmpty() || digitalRead(SD_DETECT_PIN) == HIGH)
+  {
+    return;
+  }
+  if(InitializeSDCard())
+  {
+    SDFile traceFile = SD.open(INPUT_TRACE_FILE, FILE_WRITE);
+    if(traceFile)
+    {
+      CInputRecorder::Flush(traceFile);
+      traceFile.close();
+    }
+  }
+}
+#endif
+
 // Norml mode speed management
-void HandleFanSpeedForNonManualModes(AirQualityStatus currentAQStatus)
+void HandleFanSpeedForNonManualModes()
 {
   if(_config->CurrentAQMode !=  MANUAL)
   {
-    _config->CurrentPwmDutyCyclePercent = _config->_pm25->GetSpeedBasedOnAQMode(_config->CurrentAQMode, currentAQStatus);
+    CPm25* inlet = _config->_pmsFusion->GetInlet();
+    _config->CurrentPwmDutyCyclePercent = inlet->GetSpeedBasedOnAQMode(_config->CurrentAQMode, inlet->GetAvgPM2_5());
 
     if( ((_config->HotEndTemp > -1.0 && _config->HotEndTemp < 100)
           && (_config->CurrentAQMode != MANUAL))
@@ -290,7 +431,6 @@ void HandleFanSpeedForNonManualModes(AirQualityStatus currentAQStatus)
           && (_config->hasSerialComTimedOut == true)))
     {
       _config->CurrentPwmDutyCyclePercent = 0;
-      SetFanSpeed(_config->CurrentPwmDutyCyclePercent);
     }
   }
 }
@@ -325,10 +465,13 @@ void HandleEncoderButtonPress()
 // Then 3D printer replies with temprature data
 void HandleComMessages()
 {
+  CWatchdog::Checkpoint(WD_COM_WRITE);
   SerialPrint("M105");
 
+    CWatchdog::Checkpoint(WD_COM_READ);
     if(serialBuffer.readFromSerial(&_SoftwareSerial, MAIN_LOOP_DELAY))
     {
+      RECORD_INPUT_BYTES(itCOM_REPLY, serialBuffer.getStringFromBuffer(), strlen(serialBuffer.getStringFromBuffer()));
       if (serialParser.parseCmd(serialBuffer.getStringFromBuffer()) != CMDPARSER_ERROR)
       {
         int parameterCount = serialParser.getParamCount();
@@ -368,6 +511,7 @@ void HandleComMessages()
       }
     }else
     {
+      RECORD_INPUT(itCOM_TIMEOUT, NULL, 0);
       serialTimeout++;
     }
 
@@ -382,26 +526,86 @@ void HandleComMessages()
 }
 
 
-// main loop
-void loop()
+// static task table of the main loop
+// Each task is executed by the scheduler based on its own period and priority
+// so that slow tasks (SD card, RS232 round trip) can't delay the rotary encoder or fan handling
+SchedulerTask _tasks[] = {
+  SCHEDULER_TASK("ENCODER", TaskHandleRotaryEncoder,         TASK_ENCODER_PERIOD_MS, TASK_ENCODER_DEADLINE_MS, TASK_ENCODER_PRIORITY, TASK_ENCODER_BUDGET_US),
+  SCHEDULER_TASK("FAN",     TaskUpdateFanSpeed,              TASK_FAN_PERIOD_MS,     TASK_FAN_DEADLINE_MS,     TASK_FAN_PRIORITY,     TASK_FAN_BUDGET_US),
+  SCHEDULER_TASK("FAN_SUP", TaskSuperviseFan,                TASK_FAN_SUP_PERIOD_MS, TASK_FAN_SUP_DEADLINE_MS, TASK_FAN_SUP_PRIORITY, TASK_FAN_SUP_BUDGET_US),
+  SCHEDULER_TASK("EVENTS",  TaskProcessDeviceEvents,         TASK_EVENTS_PERIOD_MS,  TASK_EVENTS_DEADLINE_MS,  TASK_EVENTS_PRIORITY,  TASK_EVENTS_BUDGET_US),
+  SCHEDULER_TASK("DISPLAY", TaskRefreshDisplayAndAirQuality, TASK_DISPLAY_PERIOD_MS, TASK_DISPLAY_DEADLINE_MS, TASK_DISPLAY_PRIORITY, TASK_DISPLAY_BUDGET_US),
+  SCHEDULER_TASK("BUTTON",  TaskHandleEncoderButtonPress,    TASK_BUTTON_PERIOD_MS,  TASK_BUTTON_DEADLINE_MS,  TASK_BUTTON_PRIORITY,  TASK_BUTTON_BUDGET_US),
+  SCHEDULER_TASK("COM",     TaskHandleComMessages,           TASK_COM_PERIOD_MS,     TASK_COM_DEADLINE_MS,     TASK_COM_PRIORITY,     TASK_COM_BUDGET_US),
+  SCHEDULER_TASK("SD_LOG",  TaskLogDataToSd,                 TASK_SD_LOG_PERIOD_MS,  TASK_SD_LOG_DEADLINE_MS,  TASK_SD_LOG_PRIORITY,  TASK_SD_LOG_BUDGET_US),
+  SCHEDULER_TASK("CONSOLE", TaskHandleConsole,               TASK_CONSOLE_PERIOD_MS, TASK_CONSOLE_DEADLINE_MS, TASK_CONSOLE_PRIORITY, TASK_CONSOLE_BUDGET_US),
+  SCHEDULER_TASK("EEPROM",  TaskSaveRunningDuration,         TASK_EEPROM_PERIOD_MS,  TASK_EEPROM_DEADLINE_MS,  TASK_EEPROM_PRIORITY,  TASK_EEPROM_BUDGET_US),
+};
+CScheduler _scheduler(&_tasks[0], COUNT(_tasks));
+
+// determining if LCD screen needs to be updated because user has pushed or rotated the rotary encoder
+void TaskHandleRotaryEncoder()
+{
+  CWatchdog::Checkpoint(WD_ENCODER);
+  PROFILE_STAGE(ROTARY_ENCODER, HandleRotaryEncoder());
+}
+
+// depending on working mode, the fan speed is adjusted here
+void TaskUpdateFanSpeed()
 {
-  // checking config and reset Com settings if used has updated baudarate
-  ResetComIfNeeded();
-  // depending on working mode, the fan speed is adjusted here
+  CWatchdog::Checkpoint(WD_FAN);
   UpdateFanSpeedIfNeeded();
-  RefreshRateDividerValue -= 1; // counter to limit LCD screen updates
+}
 
-  // determining if LCD screen needs to be updated because user has pushe the rotary encoder
-  bool needsDisplayRefresh = HandleRotaryEncoder();
-  //checking if we need to update the Display
-  //checking if either the rotary encoder has changed or display time has elapsed
-  if(RefreshRateDividerValue > 0 )//&& needsDisplayRefresh == false) // uncomment this piece of code if you need refresh right after user rotates encoder
+// comparing the measured fan speed with the applied duty cycle, a newly latched fault beeps
+// then correcting the duty cycle to track the target speed. The calibration sweep pauses both
+void TaskSuperviseFan()
+{
+  CWatchdog::Checkpoint(WD_FAN_SUPERVISOR);
+  unsigned int rpm = GetPWMFanSpeed();
+  if(_fanCurve->IsCalibrating())
   {
-    delay(MAIN_LOOP_DELAY);//simple delay for next loop to happen
+    _fanCurve->UpdateCalibration(rpm);
+    _fanRpmControl->Reset();
     return;
   }
-  RefreshRateDividerValue = REFRESH_RATE_DIVIDER;
+  FanFault fault = _fanSupervisor->GetFault();
+  _fanSupervisor->Update(_fanRamp->GetDutyCycle(), rpm);
+  _fanRpmControl->Update(rpm, _fanSupervisor->IsSettled());
+  if(_fanSupervisor->GetFault() != fault && _fanSupervisor->GetFault() != FAN_OK)
+  {
+    Beep();
+  }
+}
 
+// processing events posted by interrupts
+// heavy work like reading the air quality sensor is done here instead of inside the interrupt
+void TaskProcessDeviceEvents()
+{
+  CWatchdog::Checkpoint(WD_EVENTS);
+  DeviceEvent event;
+  while(_deviceEvents.Pop(event))
+  {
+    switch(event.Type)
+    {
+      case evTICK_1HZ:
+        MonitorAttachedDevices();
+        if(_config->CurrentPwmDutyCyclePercent > 0)
+        {
+          _runningDuration->IncrementTime(1);
+        }
+        PublishTelemetry();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// reading fan speed, refreshing the current view and adjusting fan speed based on air quality
+void TaskRefreshDisplayAndAirQuality()
+{
+  CWatchdog::Checkpoint(WD_DISPLAY);
   // handle Fan speed readings
   _config->Rpm1 = GetPWMFanSpeed();
   // capping RPM values in order to prevent unexpected behavior
@@ -412,21 +616,300 @@ void loop()
   // refresh current view
   if( _currentView != NULL)
   {
-    _currentView->Refresh();
+    PROFILE_STAGE(VIEW_REFRESH, _currentView->Refresh());
   }
 
-  // Handle Other features here
   if(_config->IgnoreFirstValues == 0)
   {
-    int pm25Avg = _config->_pm25->GetAvgPM2_5(); // read Air quality data
-    AirQualityStatus currentAQStatus = _config->_pm25->ConvertPM2_5ToAirQualityStatus(pm25Avg); // Compute Air Quality Status based on Air quality data
-    HandleFanSpeedForNonManualModes(currentAQStatus); // adjust fan speed based on Air quality level
-    LogDataToSdIfAvailable(currentAQStatus);          // Data logging into SD card when possible
+    CPm25* sensor = _config->_pmsFusion->GetControlSensor();
+    int pm25Avg = sensor->GetAvgPM2_5(); // read Air quality data
+    _currentAQStatus = sensor->ConvertPM2_5ToAirQualityStatus(pm25Avg); // Compute Air Quality Status based on Air quality data
+    HandleFanSpeedForNonManualModes(); // adjust fan speed based on Air quality level
   }
+}
 
-  HandleEncoderButtonPress(); // checking if encoder button has been pressed
-  HandleComMessages();        // check COM messages to retrieve Hot end temperature when available
-  _runningDuration->CheckAndSaveRunningDuration();  // update running duration when needed
+// checking if encoder button has been pressed for a long time
+void TaskHandleEncoderButtonPress()
+{
+  CWatchdog::Checkpoint(WD_BUTTON);
+  HandleEncoderButtonPress();
+}
+
+// checking config and reset Com settings if user has updated baudrate
+// then check COM messages to retrieve Hot end temperature when available
+void TaskHandleComMessages()
+{
+  CWatchdog::Checkpoint(WD_COM_WRITE);
+  PROFILE_STAGE(RESET_COM, ResetComIfNeeded());
+  PROFILE_STAGE(COM_MESSAGES, HandleComMessages());
+}
+
+// Data logging into SD card when possible
+void TaskLogDataToSd()
+{
+#ifdef INPUT_RECORDER
+  CWatchdog::Checkpoint(WD_SD_WRITE);
+  FlushInputTrace();
+#endif
+  if(_config->IgnoreFirstValues == 0)
+  {
+    PROFILE_STAGE(SD_LOG, LogDataToSdIfAvailable());
+  }
+}
+
+// update running duration when needed
+void TaskSaveRunningDuration()
+{
+  CWatchdog::Checkpoint(WD_EEPROM_SAVE);
+  PROFILE_STAGE(SAVE_DURATION, _runningDuration->CheckAndSaveRunningDuration());
+}
+
+// reading commands received on the USB serial console
+// the buffer keeps partial lines between two calls, so this only waits 1ms at most
+void TaskHandleConsole()
+{
+  CWatchdog::Checkpoint(WD_CONSOLE);
+  if(Serial.available() == 0)
+  {
+    return;
+  }
+  if(consoleBuffer.readFromSerial(&Serial, 1))
+  {
+    if(consoleParser.parseCmd(&consoleBuffer) != CMDPARSER_ERROR)
+    {
+      if(!consoleCallback.processCmd(&consoleParser))
+      {
+        Serial.println(F("Unknown command"));
+      }
+    }
+    consoleBuffer.clear();
+  }
+}
+
+// registering console commands
+void SetupConsole()
+{
+  Serial.begin(CONSOLE_BAUDRATE);
+  consoleCallback.addCmd("TASKS", &ConsoleTasks);
+  consoleCallback.addCmd("STALLS", &ConsoleStalls);
+  consoleCallback.addCmd("STATUS", &ConsoleStatus);
+  consoleCallback.addCmd("AQPROFILE", &ConsoleAQProfile);
+  consoleCallback.addCmd("FANFAULT", &ConsoleFanFault);
+  consoleCallback.addCmd("FANCAL", &ConsoleFanCalibration);
+#ifdef PROFILER
+  consoleCallback.addCmd("PROFILE", &ConsoleProfile);
+#endif
+  if(CWatchdog::WasStallReset())
+  {
+    Serial.print(F("STALL_RESET "));
+    Serial.println(CWatchdog::GetStageName(CWatchdog::GetLastStallStage()));
+  }
+}
+
+// TASKS command: prints scheduler statistics. "TASKS RESET" clears them
+void ConsoleTasks(CmdParser *parser)
+{
+  if(parser->getParamCount() > 1 && parser->equalCmdParam(1, "RESET"))
+  {
+    _scheduler.ResetStatistics();
+  }
+  Serial.println(F("TASK RUNS MAX_US OVERRUNS DEADLINE_MISSES"));
+  for(byte i = 0; i < _scheduler.GetTaskCount(); i++)
+  {
+    const SchedulerTask* task = _scheduler.GetTask(i);
+    Serial.print(task->Name);
+    Serial.print(' ');
+    Serial.print(task->RunCount);
+    Serial.print(' ');
+    Serial.print(task->MaxRunUs);
+    Serial.print(' ');
+    Serial.print(task->Overruns);
+    Serial.print(' ');
+    Serial.println(task->DeadlineMisses);
+  }
+  Serial.print(F("TIMER_ISR_MAX_US "));
+  Serial.println(GetTimerIsrMaxDurationUs());
+  Serial.print(F("CPU_ACTIVE_PERCENT "));
+  Serial.println(_scheduler.GetActivePercent());
+  Serial.print(F("IDLE_WAKEUPS "));
+  Serial.println(_scheduler.GetWakeUpsPerWindow());
+#ifdef INPUT_RECORDER
+  Serial.print(F("INPUT_TRACE_DROPPED "));
+  Serial.println(CInputRecorder::GetDroppedCount());
+#endif
+}
+
+// STALLS command: prints the watchdog stall history. "STALLS CLEAR" erases it
+// "STALLS TEST" blocks the main loop to check the watchdog is working
+void ConsoleStalls(CmdParser *parser)
+{
+  if(parser->getParamCount() > 1 && parser->equalCmdParam(1, "CLEAR"))
+  {
+    CWatchdog::ClearHistory();
+  }
+#ifdef STALL_WATCHDOG
+  else if(parser->getParamCount() > 1 && parser->equalCmdParam(1, "TEST"))
+  {
+    Serial.println(F("Blocking the main loop..."));
+    CWatchdog::Checkpoint(WD_TEST);
+    for(;;)
+    {
+      delay(1);
+    }
+  }
+#endif
+  CWatchdog::PrintHistory(Serial);
+}
+
+// STATUS command: prints the last telemetry sample
+void ConsoleStatus(CmdParser *parser)
+{
+  (void)parser;
+  TelemetrySample sample;
+  _config->Telemetry.Read(sample);
+  char line[96];
+  sprintf(line, "TICK %lu\r\nDURATION %04dJ %02dH:%02dm:%02ds", sample.Tick, sample.Days, sample.Hours, sample.Minutes, sample.Seconds);
+  Serial.println(line);
+  sprintf(line, "PM %d %d %d AVG %d", sample.Pm01, sample.Pm25, sample.Pm10, sample.Pm25Avg);
+  Serial.println(line);
+  sprintf(line, "PM_ATM %u %u %u", sample.Pms.Pm01Atm, sample.Pms.Pm25Atm, sample.Pms.Pm10Atm);
+  Serial.println(line);
+  sprintf(line, "PARTICLES %u %u %u %u %u %u", sample.Pms.Particles[pbOVER_0_3UM], sample.Pms.Particles[pbOVER_0_5UM],
+          sample.Pms.Particles[pbOVER_1_0UM], sample.Pms.Particles[pbOVER_2_5UM],
+          sample.Pms.Particles[pbOVER_5_0UM], sample.Pms.Particles[pbOVER_10UM]);
+  Serial.println(line);
+  sprintf(line, "AQ %s PROFILE %s", AQ_STRING[sample.AQStatus], AQ_PROFILE_STRING[sample.AQProfile]);
+  Serial.println(line);
+  sprintf(line, "%s FRAMES %lu MAX_GAP_MS %lu", PMS_LINK_STRING[sample.PmsLink.State],
+          sample.PmsLink.Frames, sample.PmsLink.MaxFrameGapMs);
+  Serial.println(line);
+  sprintf(line, "CHECKSUM %u FRAMING %u RESYNC %u SHORT %u DISCARDED %lu", sample.PmsLink.ChecksumErrors,
+          sample.PmsLink.FramingErrors, sample.PmsLink.Resyncs, sample.PmsLink.ShortReads, sample.PmsLink.DiscardedBytes);
+  Serial.println(line);
+#ifdef DUAL_PMS
+  sprintf(line, "OUTLET %s PM2.5_AVG %d FILTER_EFFICIENCY %d SOURCE %s FAILOVERS %u", PMS_LINK_STRING[sample.OutletLink],
+          sample.OutletPm25Avg, sample.FilterEfficiency, PMS_SOURCE_STRING[sample.PmsSource], _config->_pmsFusion->GetFailoverCount());
+  Serial.println(line);
+#endif
+  Serial.print(F("PMS_POWER "));
+  Serial.println(PMS_POWER_STRING[sample.PmsPower]);
+  sprintf(line, "LASER_HOURS %lu.%lu", sample.LaserTenthsOfHour / 10, sample.LaserTenthsOfHour % 10);
+  Serial.println(line);
+  Serial.print(F("FAN_BOOST "));
+  Serial.println(sample.FanBoost);
+  Serial.print(F("RPM "));
+  Serial.println(sample.Rpm);
+#ifdef FAN_TACH_PERIOD
+  Serial.print(F("TACH_GLITCHES "));
+  Serial.println(fan.getGlitchCount());
+#endif
+  sprintf(line, "FAN %s FAULT %s", FAN_STATE_STRING[sample.FanState], FAN_FAULT_STRING[sample.FanFault]);
+  Serial.println(line);
+  sprintf(line, "FAN_TARGET_RPM %u CORRECTION %d", _fanRpmControl->GetTargetRpm(), _fanRpmControl->GetCorrection());
+  Serial.println(line);
+  sprintf(line, "FAN_RAMP %u%%/S DUTY %u TARGET %u LATENCY_MS %lu MAX %lu RAMPS %u", _fanRamp->GetRate(), _fanRamp->GetDutyCycle(),
+          _fanRamp->GetTarget(), _fanRamp->GetLastLatencyMs(), _fanRamp->GetMaxLatencyMs(), _fanRamp->GetRampCount());
+  Serial.println(line);
+  Serial.print(F("HOTEND "));
+  Serial.println(sample.HotEndTemp);
+}
+
+// FANFAULT command: prints the fan supervisor state and counters. "FANFAULT CLEAR" clears the latched fault
+void ConsoleFanFault(CmdParser *parser)
+{
+  if(parser->getParamCount() > 1 && parser->equalCmdParam(1, "CLEAR"))
+  {
+    _fanSupervisor->ClearFault();
+  }
+  char line[80];
+  sprintf(line, "FAN %s FAULT %s LATCHED %u", FAN_STATE_STRING[_fanSupervisor->GetState()],
+          FAN_FAULT_STRING[_fanSupervisor->GetFault()], _fanSupervisor->GetFaultCount());
+  Serial.println(line);
+  sprintf(line, "STALLS %u KICKS %u RECOVERIES %u LAST_STALL_MS %lu", _fanSupervisor->GetStallCount(),
+          _fanSupervisor->GetKickCount(), _fanSupervisor->GetRecoveryCount(), _fanSupervisor->GetLastStallMs());
+  Serial.println(line);
+}
+
+// FANCAL command: prints the fan curve, duty cycle and speed of each point.
+// "FANCAL START" measures and saves a new curve, "FANCAL STOP" aborts the measure, "FANCAL CLEAR" goes back to the linear curve
+void ConsoleFanCalibration(CmdParser *parser)
+{
+  if(parser->getParamCount() > 1)
+  {
+    if(parser->equalCmdParam(1, "START"))
+    {
+      _fanCurve->StartCalibration();
+    }
+    else if(parser->equalCmdParam(1, "STOP"))
+    {
+      _fanCurve->StopCalibration();
+    }
+    else if(parser->equalCmdParam(1, "CLEAR"))
+    {
+      _fanCurve->Clear();
+      _fanRpmControl->Reset();
+    }
+  }
+  if(_fanCurve->IsCalibrating())
+  {
+    Serial.print(F("CALIBRATING "));
+    Serial.print(_fanCurve->GetCalibrationDuty());
+    Serial.println('%');
+    return;
+  }
+  Serial.print(_fanCurve->IsCalibrated() ? F("CALIBRATED") : F("LINEAR"));
+  Serial.println(_fanCurve->HasCalibrationFailed() ? F(" LAST_CALIBRATION_FAILED") : F(""));
+  char line[24];
+  for(byte duty = 0; duty <= 100; duty += FAN_CURVE_STEP_PERCENT)
+  {
+    sprintf(line, "%3u%% %5u", duty, _fanCurve->GetRpm(duty));
+    Serial.println(line);
+  }
+}
+// AQPROFILE command: prints the PM2.5 limits of the air quality profile in use.
+// "AQPROFILE <name>" selects another profile, saved into EEPROM by the "Save" menu of the settings
+void ConsoleAQProfile(CmdParser *parser)
+{
+  for(byte i = 0; parser->getParamCount() > 1 && i < AQ_PROFILE_COUNT; i++)
+  {
+    if(parser->equalCmdParam(1, AQ_PROFILE_STRING[i]))
+    {
+      _config->_pmsFusion->SetAQProfile(i);
+    }
+  }
+  const AQProfile &profile = _config->_pm25->GetAQProfile();
+  Serial.println(AQ_PROFILE_STRING[_config->_pm25->GetAQProfileIndex()]);
+  for(byte i = 0; i < AQ_LIMIT_COUNT; i++)
+  {
+    Serial.print(AQ_STRING[i]);
+    Serial.print(F(" <= "));
+    Serial.println(profile.Limits[i]);
+  }
+}
+
+#ifdef PROFILER
+// PROFILE command: prints main loop stages statistics. "PROFILE RESET" clears them
+void ConsoleProfile(CmdParser *parser)
+{
+  if(parser->getParamCount() > 1 && parser->equalCmdParam(1, "RESET"))
+  {
+    CProfiler::Reset();
+  }
+  CProfiler::PrintStatistics(Serial);
+}
+#endif
+
+// main loop
+// all the work is performed by the scheduler, one task per loop iteration
+void loop()
+{
+  CWatchdog::LoopTick();
+  CWatchdog::Checkpoint(WD_SCHEDULER);
+  if(!_scheduler.RunNextTask())
+  {
+    CWatchdog::Checkpoint(WD_IDLE);
+    _scheduler.Idle();   // nothing to do: sleeping until the next interrupt
+  }
 }
 
 // reset counter used to compute fan speed
@@ -447,47 +930,59 @@ byte GetPWMFanDutyCycle()
 }
 
 // setting fan speed here
+// the fan power supply is only switched when the fan starts or stops, the PWM input changes the speed
 void SetFanSpeed(unsigned int SpeedPercentage)
 {
   fan.setDutyCycle(max(min(SpeedPercentage, 100), 0));
-  // need to reset fan power supply in order for RPM to be applied
-  digitalWrite(PWM_FAN_POWER_OUTPUT_PIN, LOW);
-  if(SpeedPercentage > 0)
-  {
-    delay(1);
-    digitalWrite(PWM_FAN_POWER_OUTPUT_PIN, HIGH);
-  }
+  digitalWrite(PWM_FAN_POWER_OUTPUT_PIN, SpeedPercentage > 0 ? HIGH : LOW);
 }
 
 // interrupt called every 1 second. used to track running duration.
 // !!!!!!!!!!!!!!!!WARNING!!!!!!!!!!!!!!!!!!!!
 // it's ISR interrupt so don't put any heavy work in here as it may result in unexpected behavior
+// The interrupt only posts an event, the work is done by TaskProcessDeviceEvents()
 //interrupt @ 1Hz
 ISR(TIMER1_COMPA_vect){
-  MonitorAttachedDevices();
-  if(_config->CurrentPwmDutyCyclePercent > 0)
+  static TickStatistics statistics;     // only written here, published for the main loop
+  unsigned long startUs = micros();
+  DeviceEvent event;
+  event.Type        = evTICK_1HZ;
+  event.TimestampMs = millis();
+  _deviceEvents.Push(event);            // event is dropped if the main loop was blocked for more than DEVICE_EVENT_QUEUE_SIZE seconds
+
+  statistics.Ticks++;
+  statistics.LastTickMs = event.TimestampMs;
+  unsigned int durationUs = micros() - startUs;
+  if(durationUs > statistics.MaxDurationUs)
   {
-    _runningDuration->IncrementTime(1);
+    statistics.MaxDurationUs = durationUs;
   }
+  _tickStatistics.Publish(statistics);
+}
+
+// returns the worst case duration of the 1Hz interrupt in microseconds
+unsigned int GetTimerIsrMaxDurationUs()
+{
+  TickStatistics statistics;
+  _tickStatistics.Read(statistics);
+  return statistics.MaxDurationUs;
 }
 
 // check if any action were performed on the knob: Either pressed, or rotated Clock wise or Counter clock wise
+// The knob is decoded by the timer0 interrupt (see RotaryEncoder.cpp), here we only apply the queued events
 bool HandleRotaryEncoder()
 {
   bool hasStatusChanged = false;
-  //read current state of encoder before use.
-  //maker sure the state doesn't change during this process
-  bool currentStateEnc = digitalReadFast(BTN_ENC);
-  bool currentStateEn1 = digitalReadFast(BTN_EN1);
-  bool currentStateEn2 = digitalReadFast(BTN_EN2);
+  InputEvent event;
 
-  //button was pressed
-  if(currentStateEnc != LastStateBTN_ENC)
+  while(CRotaryEncoder::PopEvent(event))
   {
+    RECORD_INPUT(itKNOB, &event, sizeof(event));
+    hasStatusChanged = true;
     // when knob is pressed we handle, calling the Select from current view will
     // return a pointer to a new view
     // In that case we need to delete the previous view and display the new one
-    if(currentStateEnc == true)//button released
+    if(event.Type == ieBUTTON_RELEASED)
     {
         Beep();
         ViewBase* newView = _currentView->Select();
@@ -501,87 +996,33 @@ bool HandleRotaryEncoder()
           _currentView->Refresh();
         }
     }
-    LastStateBTN_ENC = currentStateEnc;
-    hasStatusChanged = true;
-  }
-      //checking if the encoder has turned and forwarding the event to the selected view
-    if(currentStateEn1 != LastStateBTN_EN1 || currentStateEn2 != LastStateBTN_EN2)
+    //forwarding every detent of the rotation to the selected view
+    else if(event.Type == ieROTATION && _currentView != NULL)
     {
-        //checking clockwise direction-------------------------
-        //determining the rotation direction
-        if(_currentView != NULL)
-        {
-          if(IsTurningdCW(currentStateEn1, currentStateEn2, LastStateBTN_EN1, LastStateBTN_EN2) == true)
-          {
-            if(lastRotationWasCW == true)
-            {
-              rotationDivider -=1;
-              if(rotationDivider == 0)
-              {
-                Beep();
+      Beep();
+      int8_t steps = event.Steps;
+      while(steps > 0)  // clockwise
+      {
 #ifdef INVERT_ENCODER
-                _currentView->Up();     // forwarding event to current view
+        _currentView->Up();     // forwarding event to current view
 #else
-                _currentView->Down();   // forwarding event to current view
+        _currentView->Down();   // forwarding event to current view
 #endif
-                rotationDivider = ROTATION_DIVIDER;
-                hasStatusChanged = true;
-              }
-            }
-            else
-            {
-              lastRotationWasCW = true;
-              rotationDivider   = ROTATION_DIVIDER;
-            }
-          }
-          else{
-            if(lastRotationWasCW == false)
-            {
-              rotationDivider -= 1;
-              if(rotationDivider == 0)
-              {
-                Beep();
+        steps--;
+      }
+      while(steps < 0)  // counter clockwise
+      {
 #ifdef INVERT_ENCODER
-                _currentView->Down(); // forwarding event to current view
+        _currentView->Down();   // forwarding event to current view
 #else
-                _currentView->Up();   // forwarding event to current view
+        _currentView->Up();     // forwarding event to current view
 #endif
-                rotationDivider = ROTATION_DIVIDER;
-                hasStatusChanged = true;
-              }
-            }
-            else
-            {
-              lastRotationWasCW = false;
-              rotationDivider   = ROTATION_DIVIDER;
-            }
-          }
-        }
-        //updating last state
-        LastStateBTN_EN1 = currentStateEn1;
-        LastStateBTN_EN2 = currentStateEn2;
-    }
-    return hasStatusChanged;
-  }
-
-  // Computing encoder states to determine the rotation direction
-  bool IsTurningdCW(bool currentStateEnc1,
-                    bool currentStateEnc2,
-                    bool previousStateEnc1,
-                    bool previousStateEnc2)
-  {
-    if((currentStateEnc1 == false && currentStateEnc2 == true && previousStateEnc1 == true && previousStateEnc2 == true)
-      || (currentStateEnc1 == false && currentStateEnc2 == false && previousStateEnc1 == false && previousStateEnc2 == true)
-      || (currentStateEnc1 == true && currentStateEnc2 == false && previousStateEnc1 == false && previousStateEnc2 == false)
-      || (currentStateEnc1 == true && currentStateEnc2 == true && previousStateEnc1 == true && previousStateEnc2 == false)
-      )
-    {
-      return true;
-    }
-    else {
-      return false;
+        steps++;
+      }
     }
   }
+  return hasStatusChanged;
+}
 
   // setting baudrate
   void SetNewBaudrate(long baudrate)
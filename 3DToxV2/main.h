@@ -35,6 +35,16 @@
 #include "digitalWriteFast.h"
 #include "FanController.h"
 #include "RunningDuration.h"
+#include "PmsPowerManager.h"
+#include "FanSupervisor.h"
+#include "FanCurve.h"
+#include "FanRpmControl.h"
+#include "FanRamp.h"
+#include "Scheduler.h"
+#include "EventQueue.h"
+#include "Telemetry.h"
+#include "Profiler.h"
+#include "Watchdog.h"
 
 #include "CmdParser/CmdParser.hpp"
 #include "CmdParser/CmdCallback.hpp"
@@ -56,23 +66,74 @@ void LoadDataFromEeprom();
 void ConfigureRegisters();
 void ResetComIfNeeded();
 void UpdateFanSpeedIfNeeded();
-void HandleFanSpeedForNonManualModes(AirQualityStatus currentAQStatus);
-void LogDataToSdIfAvailable(AirQualityStatus currentAQStatus);
+void HandleFanSpeedForNonManualModes();
+void LogDataToSdIfAvailable();
+void PublishTelemetry();
+#ifdef INPUT_RECORDER
+void FlushInputTrace();
+#endif
 
 void HandleEncoderButtonPress();
 void HandleComMessages();
 
+// main loop tasks executed by the scheduler
+void TaskHandleRotaryEncoder();
+void TaskUpdateFanSpeed();
+void TaskSuperviseFan();
+void TaskProcessDeviceEvents();
+void TaskRefreshDisplayAndAirQuality();
+void TaskHandleEncoderButtonPress();
+void TaskHandleComMessages();
+void TaskLogDataToSd();
+void TaskSaveRunningDuration();
+void TaskHandleConsole();
+extern CScheduler _scheduler;   // defined in main.cpp, next to its task table
+
 void(* resetFunc) (void) = 0;//declare reset function at address 0
 
 int ResetDownTick = 0;
 
 CConfig* _config = new CConfig();
 CRunningDuration* _runningDuration = new CRunningDuration(_config);
+CPmsPowerManager* _pmsPower = new CPmsPowerManager(_config);
+CFanCurve* _fanCurve = new CFanCurve();
+CFanSupervisor* _fanSupervisor = new CFanSupervisor(_fanCurve);
+CFanRpmControl* _fanRpmControl = new CFanRpmControl(_fanCurve);
+CFanRamp* _fanRamp = new CFanRamp(FAN_RAMP_PERCENT_PER_S);
 ViewBase* _currentView;
 volatile uint8_t portbhistory = 0xFF;     // default is high because the pull-up
-int RefreshRateDividerValue = 10;
-
-CmdCallback<1> cmdCallback;
+// events posted by interrupts and processed later inside the main loop
+enum eDeviceEvent
+{
+  evTICK_1HZ          // 1 second elapsed, posted by TIMER1_COMPA interrupt
+};
+
+typedef struct {
+  byte          Type;
+  unsigned long TimestampMs;
+} DeviceEvent;
+
+CEventQueue<DeviceEvent, DEVICE_EVENT_QUEUE_SIZE> _deviceEvents;
+CSeqLock<TickStatistics> _tickStatistics;        // published by the 1Hz interrupt, read without disabling interrupts
+unsigned int GetTimerIsrMaxDurationUs();
+
+AirQualityStatus _currentAQStatus = COMPUTING;   // last computed air quality status, shared between control and logging tasks
+
+// USB serial console
+CmdCallback<CONSOLE_MAX_COMMANDS> consoleCallback;
+CmdParser consoleParser;
+CmdBuffer<32> consoleBuffer;
+void SetupConsole();
+void ConsoleTasks(CmdParser *parser);
+void ConsoleStalls(CmdParser *parser);
+void ConsoleStatus(CmdParser *parser);
+void ConsoleAQProfile(CmdParser *parser);
+void ConsoleFanFault(CmdParser *parser);
+void ConsoleFanCalibration(CmdParser *parser);
+#ifdef PROFILER
+void ConsoleProfile(CmdParser *parser);
+int  ProfilerSdSummaryCountDown = PROFILER_SD_SUMMARY_PERIOD_S;
+#endif
 char strTemp[] = "ok T:";
 
 SoftwareSerial _SoftwareSerial(sSerialRxPin, sSerialTxPin);
@@ -84,17 +145,7 @@ unsigned int GetPWMFanSpeed();
 byte GetPWMFanDutyCycle();
 void SetFanSpeed(unsigned int);
 
-bool LastStateBTN_EN1 = 0;
-bool LastStateBTN_EN2 = 0;
-bool LastStateBTN_ENC = 0;
-
 bool HandleRotaryEncoder(); // returns true if Rotary encoder has changed
-bool IsTurningdCW(bool currentStateEnc1,
-                  bool currentStateEnc2,
-                  bool previousStateEnc1,
-                  bool previousStateEnc2);
-int rotationDivider = ROTATION_DIVIDER;
-bool lastRotationWasCW = true;
 void Beep();
 void SetNewBaudrate(long baudrate);
 void SerialPrint(const String &s);
@@ -35,6 +35,7 @@
 #define NOINLINE __attribute__((noinline,unused))
 #define UNUSEDOK __attribute__((unused))
 //------------------------------------------------------------------------------
+#ifndef HOST_BUILD  // relies on the AVR linker symbols
 /** Return the number of bytes currently free in RAM. */
 static UNUSEDOK int FreeRam(void) {
   extern int  __bss_end;
@@ -51,6 +52,7 @@ static UNUSEDOK int FreeRam(void) {
   }
   return free_memory;
 }
+#endif  // HOST_BUILD
 #ifdef __AVR__
 //------------------------------------------------------------------------------
 /**
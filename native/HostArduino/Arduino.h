@@ -0,0 +1,148 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Minimal Arduino core used by the native (host) build.
+ // Only the API used by the firmware is provided. Time is virtual (see HostHal.h)
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <math.h>
+#include <type_traits>
+
+#include "HostHal.h"
+#include "avr/pgmspace.h"
+
+typedef uint8_t  byte;
+typedef bool     boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define F_CPU 16000000UL
+
+// Arduino Mega SPI pins
+#define SS   53
+#define MOSI 51
+#define MISO 50
+#define SCK  52
+
+// same behaviour as the Arduino macros without evaluating parameters twice
+// both values are converted to their common type first, as the macros do, so mixed types don't warn
+template <class A, class B> inline typename std::common_type<A, B>::type min(A a, B b)
+{
+  typedef typename std::common_type<A, B>::type T;
+  return (T)a < (T)b ? (T)a : (T)b;
+}
+template <class A, class B> inline typename std::common_type<A, B>::type max(A a, B b)
+{
+  typedef typename std::common_type<A, B>::type T;
+  return (T)a > (T)b ? (T)a : (T)b;
+}
+template <class T, class L, class H> inline T constrain(T x, L low, H high) { return x < low ? low : (x > high ? high : x); }
+
+#define lowByte(w)  ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bit(b) (1UL << (b))
+#define _BV(b) (1 << (b))
+
+// digital and analog pins
+void    pinMode(uint8_t pin, uint8_t mode);
+void    digitalWrite(uint8_t pin, uint8_t value);
+int     digitalRead(uint8_t pin);
+void    analogWrite(uint8_t pin, int value);
+int     analogRead(uint8_t pin);
+
+// the fast versions from digitalWriteFast.h rely on AVR registers
+#define digitalWriteFast(P, V) digitalWrite((P), (V))
+#define digitalReadFast(P)     ((byte)digitalRead((P)))
+#define pinModeFast(P, V)      pinMode((P), (V))
+
+// virtual time
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// interrupts
+int  digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interruptNumber, void (*callback)(void), int mode);
+void detachInterrupt(uint8_t interruptNumber);
+void cli();
+void sei();
+#define interrupts()   sei()
+#define noInterrupts() cli()
+
+// AVR status register. Restoring a value with the I bit set delivers pending interrupts
+class HostStatusRegister
+{
+  public:
+  operator uint8_t() const { return HostInterruptsEnabled() ? 0x80 : 0x00; }
+  HostStatusRegister& operator=(uint8_t value) { HostSetInterruptsEnabled((value & 0x80) != 0); return *this; }
+};
+extern HostStatusRegister SREG;
+
+// interrupt vectors are plain C functions on the host, called by the virtual clock
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+#define TIMER0_COMPA_vect HostVectorTimer0CompA
+#define TIMER1_COMPA_vect HostVectorTimer1CompA
+#define PCINT0_vect       HostVectorPcint0
+#define WDT_vect          HostVectorWdt
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+
+#include "HostRegisters.h"
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#endif
@@ -0,0 +1,109 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass()
+{
+  memset(_data, 0xFF, sizeof(_data));
+  memset(_writeCounts, 0, sizeof(_writeCounts));
+  _file = 0;
+}
+
+bool EEPROMClass::HostOpen(const char *path)
+{
+  _file = fopen(path, "r+b");
+  if(_file != 0)
+  {
+    size_t readCount = fread(_data, 1, sizeof(_data), _file);
+    (void)readCount;   // a shorter file keeps the blank value for the remaining bytes
+    return true;
+  }
+  _file = fopen(path, "w+b");
+  if(_file == 0)
+  {
+    return false;
+  }
+  fwrite(_data, 1, sizeof(_data), _file);
+  fflush(_file);
+  return true;
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+  if(address < 0 || address >= HOST_EEPROM_SIZE)
+  {
+    return 0xFF;
+  }
+  // an EEPROM read takes 4 CPU cycles, negligible on the virtual clock
+  return _data[address];
+}
+
+// an EEPROM byte write takes about 3.3ms on the AVR
+void EEPROMClass::write(int address, uint8_t value)
+{
+  if(address < 0 || address >= HOST_EEPROM_SIZE)
+  {
+    return;
+  }
+  delayMicroseconds(3300);
+  _data[address] = value;
+  _writeCounts[address]++;
+  if(_file != 0)
+  {
+    fseek(_file, address, SEEK_SET);
+    fputc(value, _file);
+    fflush(_file);
+  }
+}
+
+uint32_t EEPROMClass::HostGetWriteCount(int address)
+{
+  if(address < 0 || address >= HOST_EEPROM_SIZE)
+  {
+    return 0;
+  }
+  return _writeCounts[address];
+}
+
+uint32_t EEPROMClass::HostGetTotalWriteCount()
+{
+  uint32_t total = 0;
+  for(uint16_t i = 0; i < HOST_EEPROM_SIZE; i++)
+  {
+    total += _writeCounts[i];
+  }
+  return total;
+}
+
+uint32_t EEPROMClass::HostGetMaxWriteCount()
+{
+  uint32_t maxCount = 0;
+  for(uint16_t i = 0; i < HOST_EEPROM_SIZE; i++)
+  {
+    if(_writeCounts[i] > maxCount)
+    {
+      maxCount = _writeCounts[i];
+    }
+  }
+  return maxCount;
+}
@@ -0,0 +1,74 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host EEPROM: 4KB as on the ATmega2560, optionally backed by a file so the
+// content survives between simulations. Writes are counted per address to check wear leveling.
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+const uint16_t HOST_EEPROM_SIZE = 4096;
+
+class EEPROMClass
+{
+  public:
+  EEPROMClass();
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  void update(int address, uint8_t value) { if(read(address) != value) { write(address, value); } }
+  uint16_t length() { return HOST_EEPROM_SIZE; }
+
+  template <typename T> T &get(int address, T &value)
+  {
+    uint8_t *data = (uint8_t *)&value;
+    for(size_t i = 0; i < sizeof(T); i++)
+    {
+      data[i] = read(address + i);
+    }
+    return value;
+  }
+
+  template <typename T> const T &put(int address, const T &value)
+  {
+    const uint8_t *data = (const uint8_t *)&value;
+    for(size_t i = 0; i < sizeof(T); i++)
+    {
+      update(address + i, data[i]);
+    }
+    return value;
+  }
+
+  // simulated world side
+  bool HostOpen(const char *path);           // loads the file content, blank (0xFF) EEPROM if missing
+  uint32_t HostGetWriteCount(int address);
+  uint32_t HostGetTotalWriteCount();
+  uint32_t HostGetMaxWriteCount();
+
+  private:
+  uint8_t  _data[HOST_EEPROM_SIZE];
+  uint32_t _writeCounts[HOST_EEPROM_SIZE];
+  FILE    *_file;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
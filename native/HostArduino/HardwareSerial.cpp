@@ -0,0 +1,107 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+HardwareSerial Serial("Serial");
+HardwareSerial Serial1("Serial1");
+HardwareSerial Serial2("Serial2");
+HardwareSerial Serial3("Serial3");
+
+// 1 start bit, 8 data bits and 1 stop bit per byte
+void HostSerialPort::HostInject(const uint8_t *data, size_t length)
+{
+  if(_baudrate == 0)
+  {
+    return;   // port closed, the bytes are lost
+  }
+  uint64_t byteUs = (10ULL * 1000000ULL + _baudrate - 1) / _baudrate;
+  uint64_t arrivalUs = HostNowUs();
+  if(!_pending.empty() && _pending.back().ArrivalUs > arrivalUs)
+  {
+    arrivalUs = _pending.back().ArrivalUs;   // the line is still busy with previous bytes
+  }
+  for(size_t i = 0; i < length; i++)
+  {
+    arrivalUs += byteUs;
+    PendingByte pendingByte = { arrivalUs, data[i] };
+    _pending.push_back(pendingByte);
+  }
+}
+
+// moving the bytes already received by the UART into the RX buffer
+void HostSerialPort::ReceiveArrivedBytes()
+{
+  uint64_t now = HostNowUs();
+  while(!_pending.empty() && _pending.front().ArrivalUs <= now)
+  {
+    if(_rxBuffer.size() < HOST_SERIAL_RX_BUFFER_SIZE - 1)   // one slot kept free, like the AVR ring buffer
+    {
+      _rxBuffer.push_back(_pending.front().Value);
+    }
+    else
+    {
+      _overflows++;
+    }
+    _pending.pop_front();
+  }
+}
+
+int HostSerialPort::available()
+{
+  HostAdvanceUs(HostGetClockStepUs());
+  ReceiveArrivedBytes();
+  return (int)_rxBuffer.size();
+}
+
+int HostSerialPort::read()
+{
+  ReceiveArrivedBytes();
+  if(_rxBuffer.empty())
+  {
+    return -1;
+  }
+  uint8_t value = _rxBuffer.front();
+  _rxBuffer.pop_front();
+  return value;
+}
+
+int HostSerialPort::peek()
+{
+  ReceiveArrivedBytes();
+  if(_rxBuffer.empty())
+  {
+    return -1;
+  }
+  return _rxBuffer.front();
+}
+
+size_t HostSerialPort::write(uint8_t value)
+{
+  if(_listener != 0)
+  {
+    _listener->OnTransmit(value);
+  }
+  if(_echo)
+  {
+    fputc(value, stdout);
+  }
+  return 1;
+}
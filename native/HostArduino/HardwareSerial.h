@@ -0,0 +1,90 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host serial ports. Bytes sent by simulated devices are time stamped with the
+// UART transfer time and only become available once the virtual clock reached them.
+// The receive buffer has the same size as on the AVR core and drops bytes on overflow.
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <deque>
+#include "Stream.h"
+
+const uint8_t HOST_SERIAL_RX_BUFFER_SIZE = 64;
+
+// receives the bytes written by the firmware on a port
+class HostSerialListener
+{
+  public:
+  virtual ~HostSerialListener() {}
+  virtual void OnTransmit(uint8_t value) = 0;
+};
+
+class HostSerialPort : public Stream
+{
+  public:
+  HostSerialPort(const char *name) : _name(name) {}
+
+  void begin(unsigned long baudrate) { _baudrate = baudrate; }
+  void begin(unsigned long baudrate, uint8_t config) { (void)config; begin(baudrate); }
+  void end() { _baudrate = 0; }
+  int available();
+  int read();
+  int peek();
+  int availableForWrite() { return HOST_SERIAL_RX_BUFFER_SIZE; }
+  size_t write(uint8_t value);
+  using Print::write;
+  void flush() {}
+  operator bool() { return true; }
+
+  // simulated world side
+  void HostInject(const uint8_t *data, size_t length);   // bytes start arriving now, back to back
+  void SetListener(HostSerialListener *listener) { _listener = listener; }
+  void SetEcho(bool echo) { _echo = echo; }             // copying transmitted bytes to stdout
+  unsigned long GetBaudrate() { return _baudrate; }
+  uint32_t GetOverflowCount() { return _overflows; }
+  const char *GetName() { return _name; }
+
+  private:
+  void ReceiveArrivedBytes();
+
+  struct PendingByte
+  {
+    uint64_t ArrivalUs;
+    uint8_t  Value;
+  };
+  const char               *_name;
+  unsigned long             _baudrate = 0;
+  std::deque<PendingByte>   _pending;
+  std::deque<uint8_t>       _rxBuffer;
+  uint32_t                  _overflows = 0;
+  HostSerialListener       *_listener  = 0;
+  bool                      _echo      = false;
+};
+
+typedef HostSerialPort HardwareSerial;
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif
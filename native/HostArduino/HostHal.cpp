@@ -0,0 +1,642 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Virtual clock, interrupt controller and GPIO model of the native build.
+
+#include <Arduino.h>
+
+static uint64_t    _nowUs       = 0;
+static uint32_t    _clockStepUs = 1;
+static HostDevice* _devices     = 0;
+static bool        _dispatching = false;
+
+static bool        _interruptsEnabled = true;
+static bool        _insideInterrupt   = false;
+static uint32_t    _interruptCount    = 0;
+
+static void (*_externalCallbacks[HOST_INTERRUPT_COUNT])(void);
+static bool        _externalPending[HOST_INTERRUPT_COUNT];
+static const uint8_t HOST_MAX_PENDING_VECTORS = 8;
+static void (*_pendingVectors[HOST_MAX_PENDING_VECTORS])(void);
+
+static uint8_t     _pinModes[HOST_PIN_COUNT];
+static uint8_t     _outputLevels[HOST_PIN_COUNT];
+static uint8_t     _inputLevels[HOST_PIN_COUNT];
+static int         _analogOutputs[HOST_PIN_COUNT];
+static bool        _inputLevelsInitialized = false;
+
+HostStatusRegister SREG;
+
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t PINB, PINC, PIND;
+volatile uint8_t SPCR, SPSR, SPDR;
+volatile uint8_t  TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+volatile uint8_t  TCCR2A, TCCR2B;
+volatile uint8_t EICRA, EICRB, EIMSK, PCICR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t WDTCSR, MCUSR, SMCR;
+
+extern "C" void HostVectorTimer0CompA(void) __attribute__((weak));
+extern "C" void HostVectorTimer1CompA(void) __attribute__((weak));
+extern "C" void HostVectorWdt(void) __attribute__((weak));
+
+// ----------------------------------------------------------------------------
+// Interrupt controller
+// ----------------------------------------------------------------------------
+
+// running every pending interrupt, as the AVR core does as soon as the I bit is set.
+// interrupts raised by devices are delivered once all the devices due at the same time are called
+// so an interrupt routine waiting on the clock (busy loop, EEPROM write) still sees device events
+static void DeliverPendingInterrupts()
+{
+  if(!_interruptsEnabled || _insideInterrupt || _dispatching)
+  {
+    return;
+  }
+  bool delivered = true;
+  while(delivered && _interruptsEnabled)
+  {
+    delivered = false;
+    for(uint8_t i = 0; i < HOST_MAX_PENDING_VECTORS; i++)
+    {
+      void (*vector)(void) = _pendingVectors[i];
+      if(vector != 0)
+      {
+        _pendingVectors[i] = 0;
+        _insideInterrupt   = true;
+        _interruptsEnabled = false;   // the AVR core clears I when entering an ISR
+        vector();
+        _interruptsEnabled = true;
+        _insideInterrupt   = false;
+        _interruptCount++;
+        delivered = true;
+      }
+    }
+    for(uint8_t i = 0; i < HOST_INTERRUPT_COUNT; i++)
+    {
+      if(_externalPending[i])
+      {
+        _externalPending[i] = false;
+        if(_externalCallbacks[i] != 0)
+        {
+          _insideInterrupt   = true;
+          _interruptsEnabled = false;
+          _externalCallbacks[i]();
+          _interruptsEnabled = true;
+          _insideInterrupt   = false;
+          _interruptCount++;
+          delivered = true;
+        }
+      }
+    }
+  }
+}
+
+bool HostInterruptsEnabled()
+{
+  return _interruptsEnabled;
+}
+
+void HostSetInterruptsEnabled(bool enabled)
+{
+  _interruptsEnabled = enabled;
+  DeliverPendingInterrupts();
+}
+
+void HostRaiseExternalInterrupt(uint8_t interruptNumber)
+{
+  if(interruptNumber >= HOST_INTERRUPT_COUNT)
+  {
+    return;
+  }
+  _externalPending[interruptNumber] = true;   // the flag is latched like EIFR
+  DeliverPendingInterrupts();
+}
+
+void HostRaiseVectorInterrupt(void (*vector)(void))
+{
+  if(vector == 0)
+  {
+    return;
+  }
+  for(uint8_t i = 0; i < HOST_MAX_PENDING_VECTORS; i++)
+  {
+    if(_pendingVectors[i] == vector)           // already pending, flags don't count
+    {
+      DeliverPendingInterrupts();
+      return;
+    }
+  }
+  for(uint8_t i = 0; i < HOST_MAX_PENDING_VECTORS; i++)
+  {
+    if(_pendingVectors[i] == 0)
+    {
+      _pendingVectors[i] = vector;
+      break;
+    }
+  }
+  DeliverPendingInterrupts();
+}
+
+uint32_t HostGetInterruptCount()
+{
+  return _interruptCount;
+}
+
+void cli()
+{
+  _interruptsEnabled = false;
+}
+
+void sei()
+{
+  HostSetInterruptsEnabled(true);
+}
+
+// Arduino Mega mapping between pins and INTx
+int digitalPinToInterrupt(uint8_t pin)
+{
+  switch(pin)
+  {
+    case 2:  return 0;
+    case 3:  return 1;
+    case 21: return 2;
+    case 20: return 3;
+    case 19: return 4;
+    case 18: return 5;
+    default: return -1;
+  }
+}
+
+void attachInterrupt(uint8_t interruptNumber, void (*callback)(void), int mode)
+{
+  (void)mode;   // simulated devices decide themselves which edges are raised
+  if(interruptNumber < HOST_INTERRUPT_COUNT)
+  {
+    _externalCallbacks[interruptNumber] = callback;
+  }
+}
+
+void detachInterrupt(uint8_t interruptNumber)
+{
+  if(interruptNumber < HOST_INTERRUPT_COUNT)
+  {
+    _externalCallbacks[interruptNumber] = 0;
+    _externalPending[interruptNumber]   = false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Virtual clock
+// ----------------------------------------------------------------------------
+
+void HostAddDevice(HostDevice* device)
+{
+  device->NextDevice = _devices;
+  _devices = device;
+}
+
+uint64_t HostNextDeviceEventUs()
+{
+  uint64_t next = UINT64_MAX;
+  for(HostDevice* device = _devices; device != 0; device = device->NextDevice)
+  {
+    uint64_t eventUs = device->NextEventUs();
+    if(eventUs < next)
+    {
+      next = eventUs;
+    }
+  }
+  return next;
+}
+
+// moving the clock event by event so devices always see a consistent time
+void HostAdvanceToUs(uint64_t timeUs)
+{
+  if(_dispatching)
+  {
+    // a device reading the clock from its own callback: no nested dispatch
+    if(timeUs > _nowUs)
+    {
+      _nowUs = timeUs;
+    }
+    return;
+  }
+  _dispatching = true;
+  for(;;)
+  {
+    uint64_t next = HostNextDeviceEventUs();
+    if(next > timeUs)
+    {
+      break;
+    }
+    if(next > _nowUs)
+    {
+      _nowUs = next;
+    }
+    for(HostDevice* device = _devices; device != 0; device = device->NextDevice)
+    {
+      if(device->NextEventUs() <= _nowUs)
+      {
+        device->OnEvent(_nowUs);
+      }
+    }
+    _dispatching = false;
+    DeliverPendingInterrupts();
+    _dispatching = true;
+  }
+  if(timeUs > _nowUs)
+  {
+    _nowUs = timeUs;
+  }
+  _dispatching = false;
+  DeliverPendingInterrupts();
+}
+
+void HostAdvanceUs(uint64_t deltaUs)
+{
+  HostAdvanceToUs(_nowUs + deltaUs);
+}
+
+uint64_t HostNowUs()
+{
+  return _nowUs;
+}
+
+void HostSetClockStepUs(uint32_t stepUs)
+{
+  _clockStepUs = stepUs;
+}
+
+uint32_t HostGetClockStepUs()
+{
+  return _clockStepUs;
+}
+
+// the AVR counters are 32 bits wide, so the host rolls over at the same time
+unsigned long millis()
+{
+  HostAdvanceUs(_clockStepUs);
+  return (uint32_t)(_nowUs / 1000);
+}
+
+unsigned long micros()
+{
+  HostAdvanceUs(_clockStepUs);
+  return (uint32_t)_nowUs;
+}
+
+// timer0 overflow period used by millis() on the AVR core (prescaler 64, 8 bits).
+// its interrupt wakes the MCU up from idle sleep even if no other device is active
+static const uint64_t HOST_TIMER0_OVERFLOW_US = 1024;
+static uint64_t _sleepUs = 0;
+
+void HostSleepCpu()
+{
+  if((SMCR & 0x01) == 0)        // SE bit cleared: the sleep instruction is ignored
+  {
+    return;
+  }
+  uint64_t wakeUpUs = (_nowUs / HOST_TIMER0_OVERFLOW_US + 1) * HOST_TIMER0_OVERFLOW_US;
+  uint64_t nextEventUs = HostNextDeviceEventUs();
+  if(nextEventUs < wakeUpUs)
+  {
+    wakeUpUs = nextEventUs > _nowUs ? nextEventUs : _nowUs;
+  }
+  _sleepUs += wakeUpUs - _nowUs;
+  HostAdvanceToUs(wakeUpUs);
+}
+
+uint64_t HostGetSleepUs()
+{
+  return _sleepUs;
+}
+
+void delay(unsigned long ms)
+{
+  HostAdvanceUs((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  HostAdvanceUs(us);
+}
+
+void yield()
+{
+  HostAdvanceUs(_clockStepUs);
+}
+
+// ----------------------------------------------------------------------------
+// Timer0: free running for millis(), its compare match A interrupt happens once per overflow
+// period, OCR0A ticks (4us each) after the overflow
+// ----------------------------------------------------------------------------
+
+class HostTimer0 : public HostDevice
+{
+  public:
+  HostTimer0() { HostAddDevice(this); }
+
+  uint64_t NextEventUs()
+  {
+    if((TIMSK0 & (1 << OCIE0A)) == 0)
+    {
+      _nextUs = UINT64_MAX;
+      return _nextUs;
+    }
+    if(_nextUs == UINT64_MAX)           // interrupt just enabled
+    {
+      uint64_t offsetUs = (uint64_t)OCR0A * HOST_TIMER0_OVERFLOW_US / 256;
+      _nextUs = (HostNowUs() / HOST_TIMER0_OVERFLOW_US) * HOST_TIMER0_OVERFLOW_US + offsetUs;
+      if(_nextUs <= HostNowUs())
+      {
+        _nextUs += HOST_TIMER0_OVERFLOW_US;
+      }
+    }
+    return _nextUs;
+  }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    (void)nowUs;                        // the next overflow is derived from the previous one, not from the event time
+    _nextUs += HOST_TIMER0_OVERFLOW_US;
+    HostRaiseVectorInterrupt(HostVectorTimer0CompA);
+  }
+
+  private:
+  uint64_t _nextUs = UINT64_MAX;
+};
+
+static HostTimer0 _timer0;
+
+// ----------------------------------------------------------------------------
+// Timer1: compare match A interrupt, the only timer mode used by the firmware (CTC)
+// ----------------------------------------------------------------------------
+
+class HostTimer1 : public HostDevice
+{
+  public:
+  HostTimer1() { HostAddDevice(this); }
+
+  uint64_t NextEventUs()
+  {
+    uint64_t periodUs = GetPeriodUs();
+    if(periodUs == 0)
+    {
+      _nextUs = UINT64_MAX;
+      return _nextUs;
+    }
+    if(_nextUs == UINT64_MAX || periodUs != _periodUs)
+    {
+      _periodUs = periodUs;
+      _nextUs   = HostNowUs() + periodUs;   // timer (re)configured
+    }
+    return _nextUs;
+  }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    _nextUs = nowUs + _periodUs;
+    if(TIMSK1 & (1 << OCIE1A))
+    {
+      HostRaiseVectorInterrupt(HostVectorTimer1CompA);
+    }
+  }
+
+  private:
+  // prescaler selected with the CS1x bits of TCCR1B
+  uint64_t GetPeriodUs()
+  {
+    static const uint16_t prescalers[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    uint16_t prescaler = prescalers[TCCR1B & 0x07];
+    if(prescaler == 0)
+    {
+      return 0;
+    }
+    return ((uint64_t)OCR1A + 1) * prescaler * 1000000ULL / F_CPU;
+  }
+
+  uint64_t _nextUs   = UINT64_MAX;
+  uint64_t _periodUs = 0;
+};
+
+static HostTimer1 _timer1;
+
+// ----------------------------------------------------------------------------
+// Watchdog: interrupt and/or system reset mode, timed by the 128kHz watchdog oscillator
+// ----------------------------------------------------------------------------
+
+static void DefaultResetHandler()
+{
+  fprintf(stderr, "watchdog reset at %.3f s\n", _nowUs / 1000000.0);
+  exit(0);
+}
+
+static void (*_resetHandler)() = DefaultResetHandler;
+
+class HostWatchdog : public HostDevice
+{
+  public:
+  HostWatchdog() { HostAddDevice(this); }
+
+  void Restart() { _startUs = _nowUs; }
+
+  uint64_t NextEventUs()
+  {
+    if((WDTCSR & ((1 << WDE) | (1 << WDIE))) == 0)
+    {
+      return UINT64_MAX;
+    }
+    return _startUs + GetTimeoutUs();
+  }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    _startUs = nowUs;
+    if(WDTCSR & (1 << WDIE))
+    {
+      if(WDTCSR & (1 << WDE))
+      {
+        WDTCSR &= ~(1 << WDIE);     // interrupt and reset mode: the next timeout resets
+      }
+      HostRaiseVectorInterrupt(HostVectorWdt);
+      return;
+    }
+    MCUSR |= (1 << WDRF);
+    _resetHandler();
+  }
+
+  private:
+  // 2K oscillator cycles (16ms) for WDTO_15MS, doubled for each prescaler step
+  uint64_t GetTimeoutUs()
+  {
+    uint8_t prescaler = (WDTCSR & 0x07) | (((WDTCSR >> WDP3) & 0x01) << 3);
+    return 16000ULL << prescaler;
+  }
+
+  uint64_t _startUs = 0;
+};
+
+static HostWatchdog _watchdog;
+
+void HostWatchdogEnable(uint8_t timeout)
+{
+  WDTCSR = (1 << WDE) | (timeout & 0x07) | ((timeout & 0x08) ? (1 << WDP3) : 0);
+  _watchdog.Restart();
+}
+
+void HostWatchdogDisable()
+{
+  WDTCSR = 0;
+}
+
+void HostWatchdogRestart()
+{
+  _watchdog.Restart();
+}
+
+void HostSetResetHandler(void (*handler)())
+{
+  _resetHandler = handler != 0 ? handler : DefaultResetHandler;
+}
+
+// ----------------------------------------------------------------------------
+// GPIO
+// ----------------------------------------------------------------------------
+
+// inputs are pulled up by default, matching the idle level of buttons and serial lines
+static void InitInputLevels()
+{
+  if(_inputLevelsInitialized)
+  {
+    return;
+  }
+  for(uint8_t i = 0; i < HOST_PIN_COUNT; i++)
+  {
+    _inputLevels[i] = HIGH;
+  }
+  _inputLevelsInitialized = true;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  InitInputLevels();
+  if(pin < HOST_PIN_COUNT)
+  {
+    _pinModes[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  InitInputLevels();
+  if(pin < HOST_PIN_COUNT)
+  {
+    _outputLevels[pin]  = value ? HIGH : LOW;
+    _analogOutputs[pin] = value ? 255 : 0;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  InitInputLevels();
+  if(pin >= HOST_PIN_COUNT)
+  {
+    return LOW;
+  }
+  if(_pinModes[pin] == OUTPUT)
+  {
+    return _outputLevels[pin];
+  }
+  return _inputLevels[pin];
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+  InitInputLevels();
+  if(pin < HOST_PIN_COUNT)
+  {
+    _analogOutputs[pin] = constrain(value, 0, 255);
+    _outputLevels[pin]  = value >= 128 ? HIGH : LOW;
+  }
+}
+
+int analogRead(uint8_t pin)
+{
+  InitInputLevels();
+  return pin < HOST_PIN_COUNT && _inputLevels[pin] ? 1023 : 0;
+}
+
+void HostSetInputPin(uint8_t pin, uint8_t value)
+{
+  InitInputLevels();
+  if(pin < HOST_PIN_COUNT)
+  {
+    _inputLevels[pin] = value ? HIGH : LOW;
+  }
+}
+
+uint8_t HostGetOutputPin(uint8_t pin)
+{
+  return pin < HOST_PIN_COUNT ? _outputLevels[pin] : LOW;
+}
+
+int HostGetAnalogOutput(uint8_t pin)
+{
+  return pin < HOST_PIN_COUNT ? _analogOutputs[pin] : 0;
+}
+
+uint8_t HostGetPinMode(uint8_t pin)
+{
+  return pin < HOST_PIN_COUNT ? _pinModes[pin] : INPUT;
+}
+
+// ----------------------------------------------------------------------------
+// Random numbers
+// ----------------------------------------------------------------------------
+
+static uint32_t _randomState = 1;
+
+static uint32_t NextRandom()
+{
+  // xorshift32, deterministic across hosts so simulations are reproducible
+  _randomState ^= _randomState << 13;
+  _randomState ^= _randomState >> 17;
+  _randomState ^= _randomState << 5;
+  return _randomState;
+}
+
+long random(long max)
+{
+  return max <= 0 ? 0 : (long)(NextRandom() % (uint32_t)max);
+}
+
+long random(long min, long max)
+{
+  return min >= max ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+  _randomState = seed ? (uint32_t)seed : 1;
+}
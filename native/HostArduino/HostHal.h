@@ -0,0 +1,80 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Host (native) hardware abstraction: virtual clock, pins and interrupts.
+ // The virtual clock only moves forward when the firmware reads it or waits (delay, serial timeouts...)
+ // so a simulation runs as fast as the host CPU allows, whatever the simulated duration.
+ // Simulated peripherals (timers, fan tachometer, sensors...) are HostDevice objects
+ // that are called back when the virtual clock reaches their next event.
+
+#ifndef _HOSTHAL
+#define _HOSTHAL
+
+#include <stdint.h>
+
+const uint8_t HOST_PIN_COUNT       = 70;   // Arduino Mega digital + analog pins
+const uint8_t HOST_INTERRUPT_COUNT = 6;    // INT0..INT5 on the Mega
+
+// simulated peripheral driven by the virtual clock
+class HostDevice
+{
+  public:
+  virtual ~HostDevice() {}
+  // absolute virtual time in microseconds of the next event. UINT64_MAX if none
+  virtual uint64_t NextEventUs() = 0;
+  // called once the virtual clock reached NextEventUs()
+  virtual void OnEvent(uint64_t nowUs) = 0;
+
+  HostDevice* NextDevice = 0;
+};
+
+void     HostAddDevice(HostDevice* device);
+
+// virtual clock
+uint64_t HostNowUs();
+void     HostAdvanceUs(uint64_t deltaUs);          // moves the clock forward and dispatches device events
+void     HostAdvanceToUs(uint64_t timeUs);
+void     HostSetClockStepUs(uint32_t stepUs);      // virtual time consumed by each millis() / micros() read
+uint32_t HostGetClockStepUs();
+uint64_t HostNextDeviceEventUs();
+void     HostSleepCpu();                           // sleep_cpu(): waits for the next interrupt (device event or timer0 tick)
+uint64_t HostGetSleepUs();                         // virtual time spent inside sleep_cpu()
+
+// interrupts
+bool     HostInterruptsEnabled();
+void     HostSetInterruptsEnabled(bool enabled);
+void     HostRaiseExternalInterrupt(uint8_t interruptNumber);   // INTx edge from a simulated device
+void     HostRaiseVectorInterrupt(void (*vector)(void));        // any other interrupt vector (timers, pin change...)
+uint32_t HostGetInterruptCount();
+
+// watchdog (see avr/wdt.h). A watchdog reset calls the reset handler, the default one exits
+void     HostWatchdogEnable(uint8_t timeout);
+void     HostWatchdogDisable();
+void     HostWatchdogRestart();
+void     HostSetResetHandler(void (*handler)());
+
+// pins seen from the simulated world
+void     HostSetInputPin(uint8_t pin, uint8_t value);  // external level applied to an input pin
+uint8_t  HostGetOutputPin(uint8_t pin);                // level driven by the firmware
+int      HostGetAnalogOutput(uint8_t pin);             // last analogWrite() value
+uint8_t  HostGetPinMode(uint8_t pin);
+
+#endif
@@ -0,0 +1,87 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// ATmega2560 registers written by the firmware.
+// They are plain variables on the host, the simulated Timer1 reads its configuration from them
+
+#ifndef _HOSTREGISTERS
+#define _HOSTREGISTERS
+
+#include <stdint.h>
+
+// GPIO ports used by macros.h
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+extern volatile uint8_t PINB, PINC, PIND;
+
+// SPI
+extern volatile uint8_t SPCR, SPSR, SPDR;
+#define SPR0  0
+#define SPR1  1
+#define MSTR  4
+#define SPE   6
+#define SPI2X 0
+#define SPIF  7
+
+// Timers
+extern volatile uint8_t  TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+extern volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+extern volatile uint8_t  TCCR2A, TCCR2B;
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define WGM12  3
+#define OCIE1A 1
+#define OCIE0A 1
+
+// External and pin change interrupts
+extern volatile uint8_t EICRA, EICRB, EIMSK, PCICR, PCMSK0, PCMSK1, PCMSK2;
+#define ISC00   0
+#define ISC01   1
+#define PCINT0  0
+#define PCINT1  1
+#define PCINT2  2
+#define PCINT3  3
+#define PCINT4  4
+#define PCINT5  5
+#define PCINT6  6
+#define PCINT7  7
+#define PCIE0   0
+
+// Watchdog, reset status and sleep mode
+extern volatile uint8_t WDTCSR, MCUSR, SMCR;
+#define WDP0  0
+#define WDP1  1
+#define WDP2  2
+#define WDE   3
+#define WDCE  4
+#define WDP3  5
+#define WDIE  6
+#define WDIF  7
+#define PORF  0
+#define EXTRF 1
+#define BORF  2
+#define WDRF  3
+
+// last EEPROM address
+#define E2END 0x0FFF
+
+#endif
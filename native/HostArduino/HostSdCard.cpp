@@ -0,0 +1,288 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "HostSdCard.h"
+#include <string.h>
+
+// 32MB volume: large enough to be FAT16 (more than 4085 clusters)
+static const uint32_t HOST_SD_TOTAL_BLOCKS       = 65536;
+static const uint8_t  HOST_SD_BLOCKS_PER_CLUSTER = 4;
+static const uint16_t HOST_SD_RESERVED_BLOCKS    = 1;
+static const uint8_t  HOST_SD_FAT_COUNT          = 2;
+static const uint16_t HOST_SD_BLOCKS_PER_FAT     = 64;
+static const uint16_t HOST_SD_ROOT_ENTRIES       = 512;
+static const uint8_t  HOST_SD_BUSY_BYTES         = 8;    // bytes answered busy after a block write
+
+static const uint8_t R1_READY        = 0x00;
+static const uint8_t R1_IDLE         = 0x01;
+static const uint8_t R1_ILLEGAL      = 0x04;
+static const uint8_t DATA_START      = 0xFE;
+static const uint8_t DATA_ACCEPTED   = 0x05;
+
+static void SetWord(uint8_t *buffer, uint16_t offset, uint16_t value)
+{
+  buffer[offset]     = value & 0xFF;
+  buffer[offset + 1] = value >> 8;
+}
+
+static void SetLong(uint8_t *buffer, uint16_t offset, uint32_t value)
+{
+  SetWord(buffer, offset, value & 0xFFFF);
+  SetWord(buffer, offset + 2, value >> 16);
+}
+
+HostSdCard::~HostSdCard()
+{
+  if(_image != 0)
+  {
+    fclose(_image);
+  }
+}
+
+bool HostSdCard::Open(const char *imagePath)
+{
+  _image = fopen(imagePath, "r+b");
+  if(_image == 0)
+  {
+    _image = fopen(imagePath, "w+b");
+    if(_image == 0)
+    {
+      return false;
+    }
+    Format();
+  }
+  return true;
+}
+
+// writing the boot sector and both FATs, the file is extended sparse up to the volume size
+void HostSdCard::Format()
+{
+  uint8_t block[512];
+  memset(block, 0, sizeof(block));
+  block[0] = 0xEB; block[1] = 0x3C; block[2] = 0x90;   // jump instruction
+  memcpy(&block[3], "3DTOXSIM", 8);
+  SetWord(block, 11, 512);                             // bytes per sector
+  block[13] = HOST_SD_BLOCKS_PER_CLUSTER;
+  SetWord(block, 14, HOST_SD_RESERVED_BLOCKS);
+  block[16] = HOST_SD_FAT_COUNT;
+  SetWord(block, 17, HOST_SD_ROOT_ENTRIES);
+  SetWord(block, 19, 0);                               // total sectors stored on 32 bits
+  block[21] = 0xF8;                                    // media descriptor: fixed disk
+  SetWord(block, 22, HOST_SD_BLOCKS_PER_FAT);
+  SetLong(block, 32, HOST_SD_TOTAL_BLOCKS);
+  block[38] = 0x29;                                    // extended boot signature
+  memcpy(&block[43], "3DTOX      ", 11);
+  memcpy(&block[54], "FAT16   ", 8);
+  block[510] = 0x55;
+  block[511] = 0xAA;
+  WriteBlock(0, block);
+
+  for(uint8_t fat = 0; fat < HOST_SD_FAT_COUNT; fat++)
+  {
+    memset(block, 0, sizeof(block));
+    SetWord(block, 0, 0xFFF8);                         // media descriptor entry
+    SetWord(block, 2, 0xFFFF);                         // end of chain entry
+    WriteBlock(HOST_SD_RESERVED_BLOCKS + fat * HOST_SD_BLOCKS_PER_FAT, block);
+  }
+
+  memset(block, 0, sizeof(block));
+  WriteBlock(HOST_SD_TOTAL_BLOCKS - 1, block);
+  _blocksWritten = 0;
+}
+
+void HostSdCard::WriteBlock(uint32_t block, const uint8_t *data)
+{
+  fseek(_image, (long)block * 512, SEEK_SET);
+  fwrite(data, 1, 512, _image);
+  fflush(_image);
+  _blocksWritten++;
+}
+
+// start token, data and 2 CRC bytes
+void HostSdCard::QueueBlock(uint32_t block)
+{
+  uint8_t data[512];
+  memset(data, 0, sizeof(data));
+  fseek(_image, (long)block * 512, SEEK_SET);
+  size_t readCount = fread(data, 1, sizeof(data), _image);
+  (void)readCount;   // sectors past the end of a sparse image read as zeros
+  _output.push_back(DATA_START);
+  _output.insert(_output.end(), data, data + sizeof(data));
+  _output.push_back(0xFF);
+  _output.push_back(0xFF);
+  _blocksRead++;
+}
+
+void HostSdCard::QueueRegister(const uint8_t *data)
+{
+  _output.push_back(DATA_START);
+  _output.insert(_output.end(), data, data + 16);
+  _output.push_back(0xFF);
+  _output.push_back(0xFF);
+}
+
+void HostSdCard::ExecuteCommand()
+{
+  uint8_t  command  = _command[0] & 0x3F;
+  uint32_t argument = ((uint32_t)_command[1] << 24) | ((uint32_t)_command[2] << 16)
+                    | ((uint32_t)_command[3] << 8) | _command[4];
+  bool applicationCommand = _applicationCommand;
+  _applicationCommand = false;
+  uint8_t status = _initialized ? R1_READY : R1_IDLE;
+
+  _output.clear();
+  if(applicationCommand && command == 41)           // ACMD41: initialization done at once
+  {
+    _initialized = true;
+    _output.push_back(R1_READY);
+    return;
+  }
+
+  switch(command)
+  {
+    case 0:                                          // GO_IDLE_STATE
+      _initialized = false;
+      _output.push_back(R1_IDLE);
+      break;
+    case 8:                                          // SEND_IF_COND: version 2 card, 2.7-3.6V
+      _output.push_back(status);
+      _output.push_back(0x00);
+      _output.push_back(0x00);
+      _output.push_back(0x01);
+      _output.push_back(argument & 0xFF);
+      break;
+    case 55:                                         // APP_CMD
+      _applicationCommand = true;
+      _output.push_back(status);
+      break;
+    case 58:                                         // READ_OCR: powered up, high capacity
+      _output.push_back(status);
+      _output.push_back(0xC0);
+      _output.push_back(0xFF);
+      _output.push_back(0x80);
+      _output.push_back(0x00);
+      break;
+    case 9:                                          // SEND_CSD: version 2.0, C_SIZE from the volume size
+    {
+      uint8_t csd[16];
+      memset(csd, 0, sizeof(csd));
+      uint32_t cSize = HOST_SD_TOTAL_BLOCKS / 1024 - 1;
+      csd[0]  = 0x40;
+      csd[5]  = 0x59;                                // READ_BL_LEN = 9
+      csd[7]  = (cSize >> 16) & 0x3F;
+      csd[8]  = (cSize >> 8) & 0xFF;
+      csd[9]  = cSize & 0xFF;
+      csd[10] = 0x7F;                                // ERASE_BLK_EN and SECTOR_SIZE
+      csd[11] = 0x80;
+      _output.push_back(R1_READY);
+      QueueRegister(csd);
+      break;
+    }
+    case 10:                                         // SEND_CID
+    {
+      uint8_t cid[16];
+      memset(cid, 0, sizeof(cid));
+      memcpy(&cid[3], "3DSIM", 5);
+      _output.push_back(R1_READY);
+      QueueRegister(cid);
+      break;
+    }
+    case 13:                                         // SEND_STATUS: R2, no error
+      _output.push_back(R1_READY);
+      _output.push_back(0x00);
+      break;
+    case 17:                                         // READ_SINGLE_BLOCK
+      if(argument >= HOST_SD_TOTAL_BLOCKS)
+      {
+        _output.push_back(0x40);                     // parameter error
+        break;
+      }
+      _output.push_back(R1_READY);
+      QueueBlock(argument);
+      break;
+    case 24:                                         // WRITE_BLOCK
+      if(argument >= HOST_SD_TOTAL_BLOCKS)
+      {
+        _output.push_back(0x40);
+        break;
+      }
+      _output.push_back(R1_READY);
+      _writeBlock  = argument;
+      _writeLength = 0;
+      _state       = stWAIT_WRITE_TOKEN;
+      break;
+    default:
+      _output.push_back(R1_ILLEGAL);
+      break;
+  }
+}
+
+uint8_t HostSdCard::Transfer(uint8_t value)
+{
+  switch(_state)
+  {
+    case stIDLE:
+      if((value & 0xC0) == 0x40)                     // start of a command frame
+      {
+        _output.clear();
+        _command[0]     = value;
+        _commandLength  = 1;
+        _state          = stCOMMAND;
+        return 0xFF;
+      }
+      break;
+    case stCOMMAND:
+      _command[_commandLength++] = value;
+      if(_commandLength == sizeof(_command))
+      {
+        _state = stIDLE;
+        ExecuteCommand();
+      }
+      return 0xFF;
+    case stWAIT_WRITE_TOKEN:
+      if(value == DATA_START)
+      {
+        _state = stWRITE_DATA;
+      }
+      break;
+    case stWRITE_DATA:
+      _writeBuffer[_writeLength++] = value;
+      if(_writeLength == sizeof(_writeBuffer))
+      {
+        WriteBlock(_writeBlock, _writeBuffer);
+        _state = stIDLE;
+        _output.clear();
+        _output.push_back(DATA_ACCEPTED);
+        for(uint8_t i = 0; i < HOST_SD_BUSY_BYTES; i++)
+        {
+          _output.push_back(0x00);
+        }
+      }
+      return 0xFF;
+  }
+
+  if(_output.empty())
+  {
+    return 0xFF;
+  }
+  uint8_t result = _output.front();
+  _output.pop_front();
+  return result;
+}
@@ -0,0 +1,66 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Simulated SDHC card answering the SPI protocol used by Sd2Card.
+// The card content is an image file. A missing image is created and formatted
+// as a FAT16 "super floppy" volume so the firmware finds an empty card.
+
+#ifndef _HOSTSDCARD
+#define _HOSTSDCARD
+
+#include <stdio.h>
+#include <deque>
+#include "SPI.h"
+
+class HostSdCard : public HostSpiDevice
+{
+  public:
+  HostSdCard() {}
+  ~HostSdCard();
+  bool Open(const char *imagePath);
+  uint8_t Transfer(uint8_t value);
+
+  uint32_t GetBlocksRead()    { return _blocksRead; }
+  uint32_t GetBlocksWritten() { return _blocksWritten; }
+
+  private:
+  enum eState { stIDLE, stCOMMAND, stWAIT_WRITE_TOKEN, stWRITE_DATA };
+
+  void Format();
+  void ExecuteCommand();
+  void QueueBlock(uint32_t block);
+  void QueueRegister(const uint8_t *data);
+  void WriteBlock(uint32_t block, const uint8_t *data);
+
+  FILE               *_image = 0;
+  eState              _state = stIDLE;
+  uint8_t             _command[6];
+  uint8_t             _commandLength = 0;
+  bool                _applicationCommand = false;
+  bool                _initialized = false;
+  uint32_t            _writeBlock = 0;
+  uint8_t             _writeBuffer[512 + 2];
+  uint16_t            _writeLength = 0;
+  std::deque<uint8_t> _output;
+  uint32_t            _blocksRead = 0;
+  uint32_t            _blocksWritten = 0;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "LiquidCrystal.h"
+
+// an HD44780 instruction takes about 40us, clear and home about 1.5ms
+static const unsigned int HOST_LCD_WRITE_US = 40;
+static const unsigned int HOST_LCD_CLEAR_US = 1520;
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+{
+  (void)rs; (void)enable; (void)d0; (void)d1; (void)d2; (void)d3;
+  memset(_text, ' ', sizeof(_text));
+  for(uint8_t row = 0; row < HOST_LCD_MAX_ROWS; row++)
+  {
+    _text[row][HOST_LCD_MAX_COLUMNS] = '\0';
+  }
+}
+
+void LiquidCrystal::begin(uint8_t columns, uint8_t rows)
+{
+  _columns = min(columns, HOST_LCD_MAX_COLUMNS);
+  _rows    = min(rows, HOST_LCD_MAX_ROWS);
+  clear();
+}
+
+void LiquidCrystal::clear()
+{
+  delayMicroseconds(HOST_LCD_CLEAR_US);
+  for(uint8_t row = 0; row < HOST_LCD_MAX_ROWS; row++)
+  {
+    memset(_text[row], ' ', HOST_LCD_MAX_COLUMNS);
+  }
+  _column = 0;
+  _row    = 0;
+}
+
+void LiquidCrystal::setCursor(uint8_t column, uint8_t row)
+{
+  delayMicroseconds(HOST_LCD_WRITE_US);
+  _column = column;
+  _row    = row < _rows ? row : _rows - 1;
+}
+
+// characters written past the end of a line are lost, the simulation doesn't model the DDRAM wrapping
+size_t LiquidCrystal::write(uint8_t value)
+{
+  delayMicroseconds(HOST_LCD_WRITE_US);
+  if(_column < _columns)
+  {
+    _text[_row][_column] = (value >= 0x20 && value < 0x7F) ? (char)value : '?';
+  }
+  _column++;
+  return 1;
+}
+
+const char *LiquidCrystal::HostGetLine(uint8_t row)
+{
+  static char line[HOST_LCD_MAX_COLUMNS + 1];
+  if(row >= _rows)
+  {
+    return "";
+  }
+  memcpy(line, _text[row], _columns);
+  line[_columns] = '\0';
+  return line;
+}
+
+void LiquidCrystal::HostDump(FILE *output)
+{
+  fprintf(output, "+");
+  for(uint8_t i = 0; i < _columns; i++)
+  {
+    fputc('-', output);
+  }
+  fprintf(output, "+\n");
+  for(uint8_t row = 0; row < _rows; row++)
+  {
+    fprintf(output, "|%s|\n", HostGetLine(row));
+  }
+  fprintf(output, "+");
+  for(uint8_t i = 0; i < _columns; i++)
+  {
+    fputc('-', output);
+  }
+  fprintf(output, "+%s\n", _displayOn ? "" : " (off)");
+}
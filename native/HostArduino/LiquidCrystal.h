@@ -0,0 +1,63 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host character LCD: a text buffer that can be dumped by the simulation
+
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+
+#include <Arduino.h>
+
+const uint8_t HOST_LCD_MAX_COLUMNS = 40;
+const uint8_t HOST_LCD_MAX_ROWS    = 4;
+
+class LiquidCrystal : public Print
+{
+  public:
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+  void begin(uint8_t columns, uint8_t rows);
+  void clear();
+  void home() { setCursor(0, 0); }
+  void setCursor(uint8_t column, uint8_t row);
+  void noDisplay() { _displayOn = false; }
+  void display() { _displayOn = true; }
+  void noBlink() {}
+  void blink() {}
+  void noCursor() {}
+  void cursor() {}
+  void createChar(uint8_t location, uint8_t charmap[]) { (void)location; (void)charmap; }
+  size_t write(uint8_t value);
+  using Print::write;
+
+  // simulated world side
+  void HostDump(FILE *output);
+  const char *HostGetLine(uint8_t row);
+  bool HostIsDisplayOn() { return _displayOn; }
+
+  private:
+  char    _text[HOST_LCD_MAX_ROWS][HOST_LCD_MAX_COLUMNS + 1];
+  uint8_t _columns   = 20;
+  uint8_t _rows      = 4;
+  uint8_t _column    = 0;
+  uint8_t _row       = 0;
+  bool    _displayOn = true;
+};
+
+#endif
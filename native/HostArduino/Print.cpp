@@ -0,0 +1,128 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "Print.h"
+#include <stdio.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while(size--)
+  {
+    if(write(*buffer++))
+    {
+      n++;
+    }
+    else
+    {
+      break;
+    }
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *str)
+{
+  return write(reinterpret_cast<const char *>(str));
+}
+
+size_t Print::print(const String &str)
+{
+  return write(str.c_str(), str.length());
+}
+
+size_t Print::print(const char str[])
+{
+  return write(str);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base)
+{
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+// negative numbers are only printed with a sign in base 10, as on the AVR core.
+// Other bases print the 32 bits two's complement value
+size_t Print::print(long value, int base)
+{
+  if(base == 0)
+  {
+    return write((uint8_t)value);
+  }
+  if(base == 10 && value < 0)
+  {
+    size_t n = print('-');
+    return n + printNumber(-value, 10);
+  }
+  return printNumber((uint32_t)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  if(base == 0)
+  {
+    return write((uint8_t)value);
+  }
+  return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+  return write(buffer);
+}
+
+size_t Print::println(const __FlashStringHelper *str) { size_t n = print(str); return n + println(); }
+size_t Print::println(const String &str) { size_t n = print(str); return n + println(); }
+size_t Print::println(const char str[]) { size_t n = print(str); return n + println(); }
+size_t Print::println(char c) { size_t n = print(c); return n + println(); }
+size_t Print::println(unsigned char value, int base) { size_t n = print(value, base); return n + println(); }
+size_t Print::println(int value, int base) { size_t n = print(value, base); return n + println(); }
+size_t Print::println(unsigned int value, int base) { size_t n = print(value, base); return n + println(); }
+size_t Print::println(long value, int base) { size_t n = print(value, base); return n + println(); }
+size_t Print::println(unsigned long value, int base) { size_t n = print(value, base); return n + println(); }
+size_t Print::println(double value, int digits) { size_t n = print(value, digits); return n + println(); }
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base)
+{
+  String str(value, base);
+  return write(str.c_str(), str.length());
+}
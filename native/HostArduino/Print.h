@@ -0,0 +1,76 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host version of the Arduino Print class
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+class Print
+{
+  public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t value) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str == 0 ? 0 : write((const uint8_t *)str, strlen(str)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  int getWriteError() { return _writeError; }
+  void clearWriteError() { setWriteError(0); }
+
+  size_t print(const __FlashStringHelper *str);
+  size_t print(const String &str);
+  size_t print(const char str[]);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC_BASE);
+  size_t print(int value, int base = DEC_BASE);
+  size_t print(unsigned int value, int base = DEC_BASE);
+  size_t print(long value, int base = DEC_BASE);
+  size_t print(unsigned long value, int base = DEC_BASE);
+  size_t print(double value, int digits = 2);
+
+  size_t println(const __FlashStringHelper *str);
+  size_t println(const String &str);
+  size_t println(const char str[]);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC_BASE);
+  size_t println(int value, int base = DEC_BASE);
+  size_t println(unsigned int value, int base = DEC_BASE);
+  size_t println(long value, int base = DEC_BASE);
+  size_t println(unsigned long value, int base = DEC_BASE);
+  size_t println(double value, int digits = 2);
+  size_t println();
+
+  protected:
+  void setWriteError(int error = 1) { _writeError = error; }
+
+  private:
+  static const int DEC_BASE = 10;
+  int _writeError = 0;
+  size_t printNumber(unsigned long value, uint8_t base);
+};
+
+#endif
@@ -0,0 +1,75 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "SPI.h"
+
+SPIClass SPI;
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+  _clock = settings.Clock;
+  if(_clock > HOST_MAX_SPI_CLOCK)
+  {
+    _clock = HOST_MAX_SPI_CLOCK;
+  }
+  if(_clock == 0)
+  {
+    _clock = 1;
+  }
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  _pendingNs += (uint32_t)(8ULL * 1000000000ULL / _clock);
+  if(_pendingNs >= 1000)
+  {
+    HostAdvanceUs(_pendingNs / 1000);
+    _pendingNs %= 1000;
+  }
+
+  uint8_t result = 0xFF;   // MISO is pulled up when no device drives it
+  for(uint8_t i = 0; i < _deviceCount; i++)
+  {
+    if(HostGetOutputPin(_chipSelectPins[i]) == LOW)
+    {
+      result = _devices[i]->Transfer(data);
+    }
+  }
+  return result;
+}
+
+void SPIClass::transfer(void *buffer, size_t count)
+{
+  uint8_t *data = (uint8_t *)buffer;
+  for(size_t i = 0; i < count; i++)
+  {
+    data[i] = transfer(data[i]);
+  }
+}
+
+void SPIClass::HostAttachDevice(HostSpiDevice *device, uint8_t chipSelectPin)
+{
+  if(_deviceCount < HOST_MAX_SPI_DEVICES)
+  {
+    _devices[_deviceCount]        = device;
+    _chipSelectPins[_deviceCount] = chipSelectPin;
+    _deviceCount++;
+  }
+}
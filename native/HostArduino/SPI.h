@@ -0,0 +1,78 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host SPI bus. Each transfer takes the time of 8 SPI clock cycles on the virtual clock
+// and is forwarded to the simulated device whose chip select pin is driven low.
+
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings
+{
+  public:
+  SPISettings() : Clock(4000000) {}
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : Clock(clock) { (void)bitOrder; (void)dataMode; }
+  uint32_t Clock;
+};
+
+// simulated device connected to the SPI bus
+class HostSpiDevice
+{
+  public:
+  virtual ~HostSpiDevice() {}
+  // returns the byte shifted out by the device while receiving value
+  virtual uint8_t Transfer(uint8_t value) = 0;
+};
+
+class SPIClass
+{
+  public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings settings);
+  void endTransaction() {}
+  uint8_t transfer(uint8_t data);
+  void transfer(void *buffer, size_t count);
+  void usingInterrupt(uint8_t interruptNumber) { (void)interruptNumber; }
+
+  void HostAttachDevice(HostSpiDevice *device, uint8_t chipSelectPin);
+
+  private:
+  static const uint8_t HOST_MAX_SPI_DEVICES = 4;
+  // the ATmega2560 SPI clock can't go above F_CPU / 2
+  static const uint32_t HOST_MAX_SPI_CLOCK = F_CPU / 2;
+
+  HostSpiDevice *_devices[HOST_MAX_SPI_DEVICES] = {};
+  uint8_t        _chipSelectPins[HOST_MAX_SPI_DEVICES] = {};
+  uint8_t        _deviceCount = 0;
+  uint32_t       _clock       = 4000000;
+  uint32_t       _pendingNs   = 0;       // transfer time not yet applied to the microsecond clock
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,113 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+// polling period used while waiting for data
+static const unsigned int HOST_STREAM_POLL_US = 100;
+
+int Stream::timedRead()
+{
+  unsigned long startMillis = millis();
+  do
+  {
+    int c = read();
+    if(c >= 0)
+    {
+      return c;
+    }
+    delayMicroseconds(HOST_STREAM_POLL_US);
+  } while(millis() - startMillis < _timeout);
+  return -1;
+}
+
+int Stream::timedPeek()
+{
+  unsigned long startMillis = millis();
+  do
+  {
+    int c = peek();
+    if(c >= 0)
+    {
+      return c;
+    }
+    delayMicroseconds(HOST_STREAM_POLL_US);
+  } while(millis() - startMillis < _timeout);
+  return -1;
+}
+
+bool Stream::find(char *target)
+{
+  return find(target, strlen(target));
+}
+
+// same algorithm as the AVR core: restarting the match on the first mismatching byte
+bool Stream::find(char *target, size_t length)
+{
+  if(length == 0)
+  {
+    return true;
+  }
+  size_t index = 0;
+  int c;
+  while((c = timedRead()) >= 0)
+  {
+    if(c == target[index])
+    {
+      if(++index >= length)
+      {
+        return true;
+      }
+    }
+    else
+    {
+      index = (c == target[0]) ? 1 : 0;
+    }
+  }
+  return false;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while(count < length)
+  {
+    int c = timedRead();
+    if(c < 0)
+    {
+      break;
+    }
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  String result;
+  int c = timedRead();
+  while(c >= 0 && c != terminator)
+  {
+    result += (char)c;
+    c = timedRead();
+  }
+  return result;
+}
@@ -0,0 +1,209 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "WString.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <strings.h>
+
+// converting an integer into a string using the given base
+static std::string HostNumberToString(unsigned long value, unsigned char base, bool negative)
+{
+  if(base < 2)
+  {
+    base = 10;
+  }
+  char buffer[8 * sizeof(long) + 2];
+  char *str = &buffer[sizeof(buffer) - 1];
+  *str = '\0';
+  do
+  {
+    unsigned long digit = value % base;
+    value /= base;
+    *--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+  } while(value);
+  if(negative)
+  {
+    *--str = '-';
+  }
+  return std::string(str);
+}
+
+String::String(const char *cstr) : _buffer(cstr ? cstr : "") {}
+String::String(const String &str) : _buffer(str._buffer) {}
+String::String(const __FlashStringHelper *str) : _buffer(reinterpret_cast<const char *>(str)) {}
+String::String(char c) : _buffer(1, c) {}
+String::String(unsigned char value, unsigned char base) : _buffer(HostNumberToString(value, base, false)) {}
+String::String(int value, unsigned char base)
+  : _buffer(base == 10 && value < 0 ? HostNumberToString(-(long)value, base, true) : HostNumberToString((unsigned int)value, base, false)) {}
+String::String(unsigned int value, unsigned char base) : _buffer(HostNumberToString(value, base, false)) {}
+String::String(long value, unsigned char base)
+  : _buffer(base == 10 && value < 0 ? HostNumberToString(-value, base, true) : HostNumberToString((unsigned long)value, base, false)) {}
+String::String(unsigned long value, unsigned char base) : _buffer(HostNumberToString(value, base, false)) {}
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+String::String(double value, unsigned char decimalPlaces)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  _buffer = buffer;
+}
+
+String &String::operator=(const String &rhs)
+{
+  _buffer = rhs._buffer;
+  return *this;
+}
+
+String &String::operator=(const char *cstr)
+{
+  _buffer = cstr ? cstr : "";
+  return *this;
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+bool String::equalsIgnoreCase(const String &str) const
+{
+  return strcasecmp(c_str(), str.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+  return _buffer.compare(0, prefix._buffer.length(), prefix._buffer) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+  if(index >= _buffer.length())
+  {
+    return 0;
+  }
+  return _buffer[index];
+}
+
+char &String::operator[](unsigned int index)
+{
+  if(index >= _buffer.length())
+  {
+    _invalidChar = 0;
+    return _invalidChar;
+  }
+  return _buffer[index];
+}
+
+int String::indexOf(char ch) const
+{
+  return indexOf(ch, 0);
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+  size_t index = _buffer.find(ch, fromIndex);
+  return index == std::string::npos ? -1 : (int)index;
+}
+
+int String::indexOf(const String &str) const
+{
+  return indexOf(str, 0);
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const
+{
+  size_t index = _buffer.find(str._buffer, fromIndex);
+  return index == std::string::npos ? -1 : (int)index;
+}
+
+int String::lastIndexOf(char ch) const
+{
+  size_t index = _buffer.rfind(ch);
+  return index == std::string::npos ? -1 : (int)index;
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+  return substring(beginIndex, length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if(beginIndex > endIndex)
+  {
+    unsigned int temp = endIndex;
+    endIndex   = beginIndex;
+    beginIndex = temp;
+  }
+  if(beginIndex >= length())
+  {
+    return String();
+  }
+  if(endIndex > length())
+  {
+    endIndex = length();
+  }
+  return String(_buffer.substr(beginIndex, endIndex - beginIndex).c_str());
+}
+
+void String::trim()
+{
+  size_t begin = _buffer.find_first_not_of(" \t\r\n");
+  if(begin == std::string::npos)
+  {
+    _buffer.clear();
+    return;
+  }
+  size_t end = _buffer.find_last_not_of(" \t\r\n");
+  _buffer = _buffer.substr(begin, end - begin + 1);
+}
+
+void String::toUpperCase()
+{
+  for(size_t i = 0; i < _buffer.length(); i++)
+  {
+    _buffer[i] = toupper(_buffer[i]);
+  }
+}
+
+long String::toInt() const
+{
+  return atol(c_str());
+}
+
+float String::toFloat() const
+{
+  return (float)atof(c_str());
+}
+
+double String::toDouble() const
+{
+  return atof(c_str());
+}
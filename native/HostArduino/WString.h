@@ -0,0 +1,98 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host version of the Arduino String class, backed by std::string
+
+#ifndef String_class_h
+#define String_class_h
+
+#include <string>
+#include "avr/pgmspace.h"
+
+class String
+{
+  public:
+  String(const char *cstr = "");
+  String(const String &str);
+  String(const __FlashStringHelper *str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  String &operator=(const String &rhs);
+  String &operator=(const char *cstr);
+
+  unsigned int length() const { return (unsigned int)_buffer.length(); }
+  const char *c_str() const { return _buffer.c_str(); }
+
+  bool concat(const String &str) { _buffer += str._buffer; return true; }
+  bool concat(const char *cstr) { if(cstr) { _buffer += cstr; } return true; }
+  bool concat(char c) { _buffer += c; return true; }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+  String &operator+=(const String &rhs) { concat(rhs); return *this; }
+  String &operator+=(const char *cstr) { concat(cstr); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+
+  friend String operator+(const String &lhs, const String &rhs);
+  friend String operator+(const String &lhs, const char *rhs);
+
+  bool equals(const String &str) const { return _buffer == str._buffer; }
+  bool equals(const char *cstr) const { return _buffer == (cstr ? cstr : ""); }
+  bool equalsIgnoreCase(const String &str) const;
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool startsWith(const String &prefix) const;
+
+  char charAt(unsigned int index) const;
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index);
+
+  int indexOf(char ch) const;
+  int indexOf(char ch, unsigned int fromIndex) const;
+  int indexOf(const String &str) const;
+  int indexOf(const String &str, unsigned int fromIndex) const;
+  int lastIndexOf(char ch) const;
+
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void trim();
+  void toUpperCase();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+  private:
+  std::string _buffer;
+  char _invalidChar = 0;
+};
+
+#endif
@@ -0,0 +1,52 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+// Host version of avr/pgmspace.h: flash and SRAM share the same address space
+
+#ifndef _HOST_PGMSPACE
+#define _HOST_PGMSPACE
+
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(str) (str)
+
+#define pgm_read_byte(addr)       (*(const uint8_t *)(addr))
+#define pgm_read_byte_near(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)       (*(const uint16_t *)(addr))
+#define pgm_read_word_near(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)      (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)        (*(void * const *)(addr))
+
+#define memcpy_P(dest, src, num)  memcpy((dest), (src), (num))
+#define strcpy_P(dst, src)        strcpy((dst), (src))
+#define strcmp_P(a, b)            strcmp((a), (b))
+#define strcasecmp_P(a, b)        strcasecmp((a), (b))
+#define strncasecmp_P(a, b, n)    strncasecmp((a), (b), (n))
+#define strlen_P(a)               strlen((a))
+#define sprintf_P(s, f, ...)      sprintf((s), (f), __VA_ARGS__)
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+#endif
@@ -0,0 +1,1368 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Entry point of the native build: runs setup() and loop() on the virtual clock
+ // with simulated devices around the firmware:
+ // - fan: follows the PWM duty cycle with a first order lag and sends tachometer pulses
+ // - PM2.5 sensor: sends a frame every second on Serial3 (constant values or CSV trace)
+ // - outlet PM2.5 sensor (DUAL_PMS builds): same on PMS_OUTLET_SERIAL
+ // - 3D printer: answers M105 requests on the RS232 port
+ // - LCD knob: quadrature rotations and button presses at given times
+ // - SD card: FAT16 image file, EEPROM: binary file
+ // - input replay: plays a trace recorded by the firmware (INPUT_RECORDER) instead of the
+ //   simulated fan, sensor and printer
+ // Usage: 3DToxSim [options], see PrintUsage()
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <SoftwareSerial.h>
+#include <LiquidCrystal.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <string>
+#include "HostSdCard.h"
+#include "Constants.h"
+#include "Scheduler.h"
+#include "RotaryEncoder.h"
+#include "InputRecorder.h"
+#include "PmsParser.h"
+#include "PmFilters.h"
+#include "config.h"
+#include "FanSupervisor.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// firmware entry points and objects
+void setup();
+void loop();
+extern SoftwareSerial _SoftwareSerial;
+extern LiquidCrystal  lcd;
+extern CScheduler     _scheduler;
+extern CConfig*       _config;
+extern CFanSupervisor* _fanSupervisor;
+
+static const uint8_t  FAN_PULSES_PER_TURN   = RPM_SPEED_DEVIDER;
+static const uint64_t FAN_IDLE_POLL_US      = 10000;    // max fan model update period
+static const double   FAN_TIME_CONSTANT_S   = 1.5;      // time to reach 63% of the target speed
+static const uint64_t FAN_GLITCH_DELAY_US   = 150;      // spurious edge after a real one (--tach-glitches)
+static const double   FAN_BLOCKED_RATIO     = 0.3;      // share of the normal speed reached while blocked (--fan-block)
+static const uint64_t PMS_FRAME_PERIOD_US   = 1000000;
+static const uint64_t PRINTER_REPLY_US      = 5000;
+static const uint64_t KNOB_STEP_US          = 2000;     // time between two quadrature edges, a fast spin (250 detents/s)
+static const uint64_t KNOB_PRESS_US         = 200000;   // duration of a button press
+static const uint64_t KNOB_LEAD_US          = 10000;    // knob inputs are played this long before their recorded event (debouncing)
+static const uint64_t REPLAY_PMS_LEAD_US    = 100000;   // PMS bytes are recorded once read, they are sent this long before
+static const uint64_t REPLAY_COM_WINDOW_US  = 1500000;  // max gap between a M105 request and the recorded reply it gets
+static const uint64_t REPLAY_END_MARGIN_US  = 5000000;  // default simulated time after the last replayed input
+
+// ----------------------------------------------------------------------------
+// Simulated fan: target speed proportional to the PWM duty cycle while powered
+// ----------------------------------------------------------------------------
+class HostFan : public HostDevice
+{
+  public:
+  HostFan(unsigned int maxRpm) : _maxRpm(maxRpm) {}
+
+  uint64_t NextEventUs() { return _nextUs; }
+
+  // the rotation is integrated at least every FAN_IDLE_POLL_US, so a fan starting from a crawl
+  // gives its next pulse as soon as it has turned enough, not after the period of its crawling speed
+  void OnEvent(uint64_t nowUs)
+  {
+    UpdateSpeed(nowUs);
+    if(_glitchPending && nowUs >= _glitchUs)
+    {
+      _glitchPending = false;           // spurious edge, it doesn't move the rotor
+      _glitches++;
+      HostRaiseExternalInterrupt(digitalPinToInterrupt(PWM_FAN_INPUT_PIN_1));
+    }
+    else if(_phase >= 1.0 - 1e-9)
+    {
+      HostRaiseExternalInterrupt(digitalPinToInterrupt(PWM_FAN_INPUT_PIN_1));   // falling edge of the hall sensor
+      _pulses++;
+      _phase = _phase >= 1.0 ? _phase - 1.0 : 0;
+      if(_glitchPercent > 0 && (unsigned)random(100) < _glitchPercent)
+      {
+        _glitchPending = true;
+        _glitchUs      = nowUs + FAN_GLITCH_DELAY_US;
+      }
+    }
+    _nextUs = nowUs + FAN_IDLE_POLL_US;
+    if(_rpm >= 1.0)
+    {
+      uint64_t pulseUs = nowUs + (uint64_t)((1.0 - _phase) * 60000000.0 / (_rpm * FAN_PULSES_PER_TURN)) + 1;
+      _nextUs = min(_nextUs, pulseUs);
+    }
+    if(_glitchPending)
+    {
+      _nextUs = min(_nextUs, _glitchUs);
+    }
+  }
+
+  // percentage of pulses followed by a spurious edge, noise coupled into the tachometer wire
+  void SetGlitches(unsigned percent) { _glitchPercent = percent; }
+  // locked rotor between the two times, the fan stops at once
+  void SetStall(double startS, double endS) { _stallStartS = startS; _stallEndS = endS; }
+  // blocked air path between the two times, the fan only reaches FAN_BLOCKED_RATIO of its speed
+  void SetBlock(double startS, double endS) { _blockStartS = startS; _blockEndS = endS; }
+  // the fan doesn't turn below this duty cycle, its speed is proportional to the duty cycle above it
+  void SetStartDuty(double percent) { _startDuty = percent / 100.0; }
+  // filter loading up: the speed decreases by up to percent, linearly between the two times
+  void SetLoad(double startS, double endS, double percent) { _loadStartS = startS; _loadEndS = endS; _loadRatio = percent / 100.0; }
+
+  double GetRpm() { return _rpm; }
+  uint64_t GetPulses() { return _pulses; }
+  uint64_t GetGlitches() { return _glitches; }
+
+  private:
+  void UpdateSpeed(uint64_t nowUs)
+  {
+    double targetRpm = 0;
+    if(HostGetOutputPin(PWM_FAN_POWER_OUTPUT_PIN) == HIGH)
+    {
+      double duty = HostGetAnalogOutput(PWM_OUTPUT_CONTROL_PIN) / 255.0;
+      targetRpm = duty > _startDuty ? _maxRpm * (duty - _startDuty) / (1.0 - _startDuty) : 0;
+    }
+    double nowS = nowUs / 1000000.0;
+    if(_loadRatio > 0 && nowS >= _loadStartS)
+    {
+      double progress = _loadEndS > _loadStartS ? min((nowS - _loadStartS) / (_loadEndS - _loadStartS), 1.0) : 1.0;
+      targetRpm *= 1.0 - _loadRatio * progress;
+    }
+    if(nowS >= _blockStartS && nowS < _blockEndS)
+    {
+      targetRpm *= FAN_BLOCKED_RATIO;
+    }
+    double elapsedS = (nowUs - _lastUpdateUs) / 1000000.0;
+    double lastRpm  = _rpm;
+    _rpm += (targetRpm - _rpm) * (1.0 - exp(-elapsedS / FAN_TIME_CONSTANT_S));
+    if(nowS >= _stallStartS && nowS < _stallEndS)
+    {
+      _rpm = 0;                         // locked rotor, it doesn't turn at all
+    }
+    else
+    {
+      _phase += (lastRpm + _rpm) / 2 * elapsedS / 60.0 * FAN_PULSES_PER_TURN;
+    }
+    _lastUpdateUs = nowUs;
+  }
+
+  unsigned int _maxRpm;
+  double       _rpm          = 0;
+  uint64_t     _lastUpdateUs = 0;
+  uint64_t     _nextUs       = FAN_IDLE_POLL_US;
+  uint64_t     _pulses       = 0;
+  double       _phase        = 0;       // fraction of the next tachometer pulse already turned
+  uint64_t     _glitchUs     = 0;
+  unsigned     _glitchPercent = 0;
+  bool         _glitchPending = false;
+  uint64_t     _glitches     = 0;
+  double       _stallStartS  = 0, _stallEndS = 0;
+  double       _blockStartS  = 0, _blockEndS = 0;
+  double       _startDuty    = 0;
+  double       _loadStartS   = 0, _loadEndS = 0, _loadRatio = 0;
+};
+
+// ----------------------------------------------------------------------------
+// PMS5003 frames: 13 data words and a checksum
+// ----------------------------------------------------------------------------
+static void BuildPmsFrame(const uint16_t words[13], std::vector<uint8_t> &frame)
+{
+  frame.resize(32);
+  frame[0] = 0x42;
+  frame[1] = 0x4D;
+  frame[2] = 0x00;
+  frame[3] = 28;
+  for(uint8_t i = 0; i < 13; i++)
+  {
+    frame[4 + 2 * i] = words[i] >> 8;
+    frame[5 + 2 * i] = words[i] & 0xFF;
+  }
+  uint16_t checksum = 0;
+  for(uint8_t i = 0; i < 30; i++)
+  {
+    checksum += frame[i];
+  }
+  frame[30] = checksum >> 8;
+  frame[31] = checksum & 0xFF;
+}
+
+// one of the link failures seen on the field: a flipped byte, a frame cut by a sensor reset,
+// or noise on the line before the frame
+static void CorruptPmsFrame(std::vector<uint8_t> &frame)
+{
+  switch(random(3))
+  {
+    case 0:
+      frame[random(frame.size())] ^= 1 << random(8);
+      break;
+    case 1:
+      frame.resize(random(1, frame.size()));
+      break;
+    default:
+    {
+      long count = random(1, 16);
+      for(long i = 0; i < count; i++)
+      {
+        frame.insert(frame.begin(), (uint8_t)random(256));
+      }
+      break;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Simulated PMS5003 like sensor, sending a 32 bytes frame every second while SET is high
+// ----------------------------------------------------------------------------
+struct PmSample
+{
+  double   TimeS;
+  uint16_t Pm01;
+  uint16_t Pm25;
+  uint16_t Pm10;
+};
+
+class HostPmSensor : public HostDevice
+{
+  public:
+  HostPmSensor(HardwareSerial &serial, int setPin) : _serial(serial), _setPin(setPin) {}
+
+  void SetConstant(uint16_t pm01, uint16_t pm25, uint16_t pm10)
+  {
+    PmSample sample = { 0, pm01, pm25, pm10 };
+    _trace.clear();
+    _trace.push_back(sample);
+  }
+
+  // CSV columns: time in seconds, PM1.0, PM2.5, PM10. Lines starting with # are ignored
+  bool LoadTrace(const char *path)
+  {
+    FILE *file = fopen(path, "r");
+    if(file == 0)
+    {
+      return false;
+    }
+    _trace.clear();
+    char line[128];
+    while(fgets(line, sizeof(line), file) != 0)
+    {
+      PmSample sample;
+      unsigned int pm01, pm25, pm10;
+      if(line[0] == '#' || sscanf(line, "%lf,%u,%u,%u", &sample.TimeS, &pm01, &pm25, &pm10) != 4)
+      {
+        continue;
+      }
+      sample.Pm01 = pm01;
+      sample.Pm25 = pm25;
+      sample.Pm10 = pm10;
+      _trace.push_back(sample);
+    }
+    fclose(file);
+    return !_trace.empty();
+  }
+
+  void SetNoise(uint16_t noise) { _noise = noise; }
+  // the sensor doesn't send anything between these times, like a dead sensor or an unplugged cable
+  void SetOutage(double startS, double endS) { _outageStartS = startS; _outageEndS = endS; }
+  // percentage of frames damaged by CorruptPmsFrame()
+  void SetCorruption(unsigned percent) { _corruptPercent = percent; }
+
+  uint64_t NextEventUs() { return _nextUs; }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    _nextUs = nowUs + PMS_FRAME_PERIOD_US;
+    if(HostGetOutputPin(_setPin) != HIGH || _trace.empty())
+    {
+      return;   // sensor in standby
+    }
+    if(nowUs / 1000000.0 >= _outageStartS && nowUs / 1000000.0 < _outageEndS)
+    {
+      return;
+    }
+    PmSample sample = GetSample(nowUs / 1000000.0);
+    uint16_t words[13];
+    memset(words, 0, sizeof(words));
+    words[0] = AddNoise(sample.Pm01);   // CF=1 values, the ones read by the firmware
+    words[1] = AddNoise(sample.Pm25);
+    words[2] = AddNoise(sample.Pm10);
+    words[3] = words[0];                // atmospheric values
+    words[4] = words[1];
+    words[5] = words[2];
+    // particle counts per 0.1L, roughly following the mass distribution of the trace
+    words[6]  = words[0] * 150 + words[1] * 30;
+    words[7]  = words[0] * 45 + words[1] * 10;
+    words[8]  = words[1] * 8;
+    words[9]  = words[2] * 2;
+    words[10] = words[2] / 2;
+    words[11] = words[2] / 8;
+
+    std::vector<uint8_t> frame;
+    BuildPmsFrame(words, frame);
+    if(_corruptPercent > 0 && (unsigned)random(100) < _corruptPercent)
+    {
+      CorruptPmsFrame(frame);
+      _corrupted++;
+    }
+    _serial.HostInject(frame.data(), frame.size());
+    _frames++;
+  }
+
+  uint32_t GetFrameCount() { return _frames; }
+  uint32_t GetCorruptedCount() { return _corrupted; }
+
+  private:
+  // the last sample whose time is reached applies
+  PmSample GetSample(double timeS)
+  {
+    PmSample sample = _trace[0];
+    for(size_t i = 1; i < _trace.size() && _trace[i].TimeS <= timeS; i++)
+    {
+      sample = _trace[i];
+    }
+    return sample;
+  }
+
+  uint16_t AddNoise(uint16_t value)
+  {
+    if(_noise == 0)
+    {
+      return value;
+    }
+    long noisy = (long)value + random(-(long)_noise, (long)_noise + 1);
+    return noisy < 0 ? 0 : (uint16_t)noisy;
+  }
+
+  HardwareSerial       &_serial;
+  int                   _setPin;
+  std::vector<PmSample> _trace;
+  uint16_t              _noise          = 0;
+  double                _outageStartS   = 0;
+  double                _outageEndS     = 0;
+  unsigned              _corruptPercent = 0;
+  uint64_t              _nextUs         = PMS_FRAME_PERIOD_US / 2;
+  uint32_t              _frames         = 0;
+  uint32_t              _corrupted      = 0;
+};
+
+// ----------------------------------------------------------------------------
+// Throughput of the PMS frame parser on streams with an increasing share of damaged frames.
+// The parser is run on the host CPU, so only the relative figures matter
+// ----------------------------------------------------------------------------
+static void RunPmsParserBenchmark()
+{
+  static const unsigned CORRUPT_PERCENTS[] = { 0, 1, 10, 50, 100 };
+  static const unsigned FRAME_COUNT        = 20000;
+  static const unsigned PASSES             = 50;
+
+  printf("%8s %12s %14s %14s %10s %10s\n", "CORRUPT", "STREAM_KB", "BYTES_PER_S", "FRAMES_PER_S", "UNTOUCHED", "PARSED");
+  for(size_t scenario = 0; scenario < sizeof(CORRUPT_PERCENTS) / sizeof(CORRUPT_PERCENTS[0]); scenario++)
+  {
+    randomSeed(1);
+    std::vector<uint8_t> stream;
+    unsigned intact = 0;
+    for(unsigned i = 0; i < FRAME_COUNT; i++)
+    {
+      uint16_t words[13];
+      for(uint8_t w = 0; w < 13; w++)
+      {
+        words[w] = random(1000);
+      }
+      std::vector<uint8_t> frame;
+      BuildPmsFrame(words, frame);
+      if((unsigned)random(100) < CORRUPT_PERCENTS[scenario])
+      {
+        CorruptPmsFrame(frame);
+      }
+      else
+      {
+        intact++;
+      }
+      stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    CPmsParser parser;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(unsigned pass = 0; pass < PASSES; pass++)
+    {
+      for(size_t i = 0; i < stream.size(); i++)
+      {
+        parser.Parse(stream[i]);
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%7u%% %12.1f %14.0f %14.0f %10u %10lu\n", CORRUPT_PERCENTS[scenario], stream.size() / 1024.0,
+           parser.GetByteCount() / seconds, parser.GetFrameCount() / seconds,
+           intact, parser.GetFrameCount() / PASSES);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Step response and cost of the PM smoothing filters (see PmFilters.h), with their Pm25.h settings.
+// The sensor sends one frame per second, so a latency in frames is a latency in seconds.
+// - RISE_S / FALL_S: frames needed to cover 90% of a 5 -> 100 step, then of the 100 -> 5 step
+// - SPIKE: highest filtered value after a single 200 frame inside a steady 5 stream
+// - NS, CYCLES: cost of one Add() + GetValue() on the host CPU, only the relative figures matter
+// ----------------------------------------------------------------------------
+template <class FILTER>
+static void BenchmarkPmFilter(const char *name)
+{
+  static const int      STEP_LOW = 5, STEP_HIGH = 100, SPIKE = 200, MAX_FRAMES = 1000;
+  static const unsigned COST_ITERATIONS = 20000000;
+
+  FILTER filter;
+  for(int i = 0; i < 100; i++)
+  {
+    filter.Add(STEP_LOW);
+  }
+  int rise = 0;
+  while(filter.GetValue(-1) < STEP_LOW + (STEP_HIGH - STEP_LOW) * 9 / 10 && rise < MAX_FRAMES)
+  {
+    filter.Add(STEP_HIGH);
+    rise++;
+  }
+  for(int i = 0; i < 100; i++)
+  {
+    filter.Add(STEP_HIGH);
+  }
+  int fall = 0;
+  while(filter.GetValue(-1) > STEP_LOW + (STEP_HIGH - STEP_LOW) / 10 && fall < MAX_FRAMES)
+  {
+    filter.Add(STEP_LOW);
+    fall++;
+  }
+  filter.Clear();
+  for(int i = 0; i < 100; i++)
+  {
+    filter.Add(STEP_LOW);
+  }
+  int spike = 0;
+  for(int i = 0; i < 20; i++)
+  {
+    filter.Add(i == 0 ? SPIKE : STEP_LOW);
+    spike = std::max(spike, filter.GetValue(-1));
+  }
+
+  std::vector<int> values(4096);
+  for(size_t i = 0; i < values.size(); i++)
+  {
+    values[i] = random(1000);
+  }
+  volatile int sink = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+  uint64_t startCycles = __rdtsc();
+#endif
+  for(unsigned i = 0; i < COST_ITERATIONS; i++)
+  {
+    filter.Add(values[i & 4095]);
+    sink = filter.GetValue(-1);
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  double cycles = (double)(__rdtsc() - startCycles) / COST_ITERATIONS;
+#else
+  double cycles = 0;   // not measured on this CPU
+#endif
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / COST_ITERATIONS;
+  (void)sink;
+
+  printf("%-14s %7s%-4d %7s%-4d %6d %8.2f %8.1f\n", name,
+         rise < MAX_FRAMES ? "" : ">", rise, fall < MAX_FRAMES ? "" : ">", fall, spike, ns, cycles);
+}
+
+static void RunPmFilterBenchmark()
+{
+  printf("%-14s %11s %11s %6s %8s %8s\n", "FILTER", "RISE_S", "FALL_S", "SPIKE", "NS", "CYCLES");
+  randomSeed(1);
+  BenchmarkPmFilter<CMeanFilter<PM_AVERAGE_WINDOW> >("MEAN");
+  BenchmarkPmFilter<CEwmaFilter<PM_EWMA_SHIFT> >("EWMA");
+  BenchmarkPmFilter<CMedianFilter<PM_MEDIAN_WINDOW> >("MEDIAN");
+  BenchmarkPmFilter<CTrimmedMeanFilter<PM_TRIMMED_WINDOW, PM_TRIMMED_COUNT> >("TRIMMED_MEAN");
+  BenchmarkPmFilter<CAsymmetricFilter<PM_ATTACK_SHIFT, PM_DECAY_SHIFT> >("ASYMMETRIC");
+}
+
+// ----------------------------------------------------------------------------
+// Reaction of the AUTO mode fan speed to fumes, with and without the PM trend boost (see PmTrend.h).
+// The PM filter, trend and fan speed controller of the firmware are fed one frame per second:
+// - fumes: the PM rises from the VERY_GOOD limit to the VERY_UNHEALTHY limit of the profile within RISE_S,
+//   stays there, then decays. T50_S / T90_S: seconds from the start of the rise until the duty cycle
+//   covers 50% / 90% of the MinDuty..MaxDuty range. LATE: sum of the PM2.5 measured while the duty cycle
+//   was still below 90% of the range, the fumes not extracted at full speed
+// - noise: 10 minutes of clean air with the sensor noise. BOOST_S: seconds spent with a boost,
+//   CHANGES: amount of duty cycle changes, each one makes the fan speed hunt
+// ----------------------------------------------------------------------------
+static void BenchmarkFanBoost(const char *name, byte profileIndex, bool useBoost, int riseS, int noise)
+{
+  static const int FUMES_S = 60, DECAY_S = 120, CLEAN_S = 600;
+  AQProfile profile;
+  LoadAQProfile(profileIndex, profile);
+  const FanControlProfile &control = profile.NormalFanControl;
+  int low  = profile.Limits[VERY_GOOD];
+  int high = profile.Limits[VERY_UNHEALTHY];
+
+  PmFilter         average;
+  CPmTrend         trend;
+  CFanSpeedControl fan;
+  int  t50 = -1, t90 = -1;
+  long late = 0;
+  int  duty50 = control.MinDuty + (control.MaxDuty - control.MinDuty) / 2;
+  int  duty90 = control.MinDuty + (control.MaxDuty - control.MinDuty) * 9 / 10;
+  for(int t = -30; t < riseS + FUMES_S + DECAY_S; t++)
+  {
+    int pm25 = low;
+    if(t >= 0 && t < riseS)                 { pm25 = low + (long)(high - low) * (t + 1) / riseS; }
+    else if(t >= riseS && t < riseS + FUMES_S) { pm25 = high; }
+    else if(t >= riseS + FUMES_S)            { pm25 = low + (high - low) * 9 / (9 + t - riseS - FUMES_S); }
+    average.Add(pm25);
+    trend.Add(pm25, pm25 / 2);
+    byte boost = trend.UpdateBoost(control);
+    int  duty  = fan.Update(control, average.GetValue(-1), useBoost ? boost : 0);
+    if(t < 0)
+    {
+      continue;
+    }
+    if(t50 < 0 && duty >= duty50) { t50 = t; }
+    if(t90 < 0 && duty >= duty90) { t90 = t; }
+    if(duty < duty90 && t < riseS + FUMES_S) { late += pm25; }
+  }
+
+  average.Clear();
+  trend.Clear();
+  fan.Reset();
+  int boostS = 0, changes = 0, lastDuty = -1;
+  for(int t = 0; t < CLEAN_S; t++)
+  {
+    int pm25 = max(0L, (long)low / 2 + random(-(long)noise, (long)noise + 1));
+    int pm01 = max(0L, (long)low / 4 + random(-(long)noise, (long)noise + 1));
+    average.Add(pm25);
+    trend.Add(pm25, pm01);
+    byte boost = trend.UpdateBoost(control);
+    int  duty  = fan.Update(control, average.GetValue(-1), useBoost ? boost : 0);
+    boostS  += useBoost && boost > 0;
+    changes += lastDuty >= 0 && duty != lastDuty;
+    lastDuty = duty;
+  }
+  printf("%-14s %-6s %7d %7d %8ld %8d %8d\n", name, useBoost ? "BOOST" : "-", t50, t90, late, boostS, changes);
+}
+
+static void RunFanBoostBenchmark()
+{
+  printf("%-14s %-6s %7s %7s %8s %8s %8s\n", "PROFILE", "TREND", "T50_S", "T90_S", "LATE", "BOOST_S", "CHANGES");
+  static const byte PROFILES[] = { CLEAN_FILTER, NO_FILTER, ABEK_FILTER };
+  static const int  NOISES[]   = { 2, 20, 4 };
+  for(byte i = 0; i < sizeof(PROFILES); i++)
+  {
+    for(byte useBoost = 0; useBoost < 2; useBoost++)
+    {
+      randomSeed(1);
+      BenchmarkFanBoost(AQ_PROFILE_STRING[PROFILES[i]], PROFILES[i], useBoost, 15, NOISES[i]);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Simulated 3D printer answering M105 temperature requests
+// ----------------------------------------------------------------------------
+class HostPrinter : public HostDevice, public HostSerialListener
+{
+  public:
+  HostPrinter(double hotEndTemp, double bedTemp) : _hotEndTemp(hotEndTemp), _bedTemp(bedTemp) {}
+
+  void OnTransmit(uint8_t value)
+  {
+    if(value == '\n')
+    {
+      if(_line.find("M105") != std::string::npos)
+      {
+        _replyUs = HostNowUs() + PRINTER_REPLY_US;
+      }
+      _line.clear();
+    }
+    else if(value != '\r')
+    {
+      _line += (char)value;
+    }
+  }
+
+  uint64_t NextEventUs() { return _replyUs; }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    (void)nowUs;
+    char reply[64];
+    snprintf(reply, sizeof(reply), "ok T:%.1f /%.1f B:%.1f /%.1f @:0 B@:0\n", _hotEndTemp, _hotEndTemp, _bedTemp, _bedTemp);
+    _SoftwareSerial.HostInject((const uint8_t *)reply, strlen(reply));
+    _replyUs = UINT64_MAX;
+  }
+
+  private:
+  double      _hotEndTemp;
+  double      _bedTemp;
+  std::string _line;
+  uint64_t    _replyUs = UINT64_MAX;
+};
+
+// ----------------------------------------------------------------------------
+// Console commands typed on the USB serial port at a given time
+// ----------------------------------------------------------------------------
+struct ConsoleCommand
+{
+  uint64_t    TimeUs;
+  std::string Text;
+};
+
+class HostConsole : public HostDevice
+{
+  public:
+  void Add(uint64_t timeUs, const std::string &text)
+  {
+    ConsoleCommand command = { timeUs, text + "\n" };
+    std::vector<ConsoleCommand>::iterator it = _commands.begin();
+    while(it != _commands.end() && it->TimeUs <= timeUs)
+    {
+      ++it;
+    }
+    _commands.insert(it, command);
+  }
+
+  uint64_t NextEventUs() { return _commands.empty() ? UINT64_MAX : _commands.front().TimeUs; }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    (void)nowUs;
+    const std::string &text = _commands.front().Text;
+    Serial.HostInject((const uint8_t *)text.c_str(), text.length());
+    _commands.erase(_commands.begin());
+  }
+
+  private:
+  std::vector<ConsoleCommand> _commands;
+};
+
+// ----------------------------------------------------------------------------
+// LCD knob: rotations are played as quadrature edges on BTN_EN1/BTN_EN2,
+// ROTATION_DIVIDER edges per detent. Presses pull BTN_ENC low for KNOB_PRESS_US
+// ----------------------------------------------------------------------------
+struct KnobEdge
+{
+  uint64_t TimeUs;
+  uint8_t  Pin;
+  uint8_t  Level;
+};
+
+class HostKnob : public HostDevice
+{
+  public:
+  // positive detents turn clockwise
+  void AddTurn(uint64_t timeUs, int detents)
+  {
+    _turns.push_back(std::make_pair(timeUs, detents));
+  }
+
+  void AddPress(uint64_t timeUs)
+  {
+    SetButton(timeUs, true);
+    SetButton(timeUs + KNOB_PRESS_US, false);
+  }
+
+  void SetButton(uint64_t timeUs, bool pressed)
+  {
+    Add(timeUs, BTN_ENC, pressed ? LOW : HIGH);
+  }
+
+  // time needed to play a turn of the given amount of detents
+  static uint64_t GetTurnDurationUs(int detents)
+  {
+    return (uint64_t)abs(detents) * ROTATION_DIVIDER * KNOB_STEP_US;
+  }
+
+  // turns are converted into edges once every option is known, so consecutive turns chain properly
+  void Prepare()
+  {
+    static const uint8_t CW_SEQUENCE[4] = { 3, 1, 0, 2 };   // A/B levels, A = BTN_EN1 on bit 1
+    byte position = 0;                                      // index inside CW_SEQUENCE, both pins high at rest
+    for(size_t i = 0; i < _turns.size(); i++)
+    {
+      uint64_t timeUs = _turns[i].first;
+      int      edges  = _turns[i].second * ROTATION_DIVIDER;
+      while(edges != 0)
+      {
+        position = edges > 0 ? (position + 1) & 3 : (position + 3) & 3;
+        edges   += edges > 0 ? -1 : 1;
+        timeUs  += KNOB_STEP_US;
+        Add(timeUs, BTN_EN1, (CW_SEQUENCE[position] >> 1) & 1);
+        Add(timeUs, BTN_EN2, CW_SEQUENCE[position] & 1);
+      }
+    }
+  }
+
+  uint64_t NextEventUs() { return _edges.empty() ? UINT64_MAX : _edges.front().TimeUs; }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    while(!_edges.empty() && _edges.front().TimeUs <= nowUs)
+    {
+      HostSetInputPin(_edges.front().Pin, _edges.front().Level);
+      _edges.erase(_edges.begin());
+    }
+  }
+
+  private:
+  void Add(uint64_t timeUs, uint8_t pin, uint8_t level)
+  {
+    KnobEdge edge = { timeUs, pin, level };
+    std::vector<KnobEdge>::iterator it = _edges.begin();
+    while(it != _edges.end() && it->TimeUs <= timeUs)
+    {
+      ++it;
+    }
+    _edges.insert(it, edge);
+  }
+
+  std::vector<std::pair<uint64_t, int> > _turns;
+  std::vector<KnobEdge> _edges;
+};
+
+// ----------------------------------------------------------------------------
+// Input replay: plays one session of a trace recorded by the firmware (see InputRecorder.h)
+// on the virtual clock. The session starts at the millis() value recorded at startup
+// - PMS bytes are sent on Serial3 just before their recorded time, so the firmware reads them at the same time
+// - tachometer pulses are spread evenly over the recorded measurement period
+// - each M105 request gets the recorded reply closest in time, a recorded timeout gets no reply
+// - knob events are played on the knob pins just before their recorded time
+// - SD card detection changes are applied to SD_DETECT_PIN
+// ----------------------------------------------------------------------------
+struct ReplayRecord
+{
+  uint64_t             TimeUs;
+  uint8_t              Type;
+  std::vector<uint8_t> Payload;
+};
+
+class HostReplay : public HostDevice, public HostSerialListener
+{
+  public:
+  // returns the amount of sessions found, 0 if the file can't be read or the session doesn't exist
+  int Load(const char *path, int session)
+  {
+    FILE *file = fopen(path, "rb");
+    if(file == 0)
+    {
+      return 0;
+    }
+    std::vector<uint8_t> data;
+    int value;
+    while((value = fgetc(file)) != EOF)
+    {
+      data.push_back((uint8_t)value);
+    }
+    fclose(file);
+
+    int      sessionCount = 0;
+    uint64_t timeMs       = 0;
+    size_t   position     = 0;
+    while(position < data.size())
+    {
+      ReplayRecord record;
+      record.Type = data[position++];
+      uint64_t delta = 0;
+      uint8_t  shift = 0;
+      do
+      {
+        if(position >= data.size())
+        {
+          return sessionCount;      // truncated record, the card was removed while writing
+        }
+        value  = data[position++];
+        delta |= (uint64_t)(value & 0x7F) << shift;
+        shift += 7;
+      } while(value & 0x80);
+
+      size_t length = GetPayloadLength(record.Type);
+      if(record.Type == itPMS_DATA || record.Type == itPMS_OUTLET_DATA || record.Type == itCOM_REPLY)
+      {
+        if(position >= data.size())
+        {
+          return sessionCount;
+        }
+        length = data[position++];
+      }
+      if(record.Type > itPMS_OUTLET_DATA || position + length > data.size())
+      {
+        fprintf(stderr, "Invalid input trace record at offset %u\n", (unsigned)position);
+        return sessionCount;
+      }
+      record.Payload.assign(data.begin() + position, data.begin() + position + length);
+      position += length;
+
+      if(record.Type == itSESSION)
+      {
+        sessionCount++;
+        timeMs = delta;             // millis() at startup, the recorder restarts from 0
+        if(length != 3 || record.Payload[0] != 'T' || record.Payload[1] != 'R' || record.Payload[2] != INPUT_TRACE_VERSION)
+        {
+          fprintf(stderr, "Unsupported input trace session %d\n", sessionCount);
+          return 0;
+        }
+        continue;
+      }
+      timeMs += delta;
+      record.TimeUs = timeMs * 1000;
+      if(sessionCount == session)
+      {
+        _records.push_back(record);
+      }
+    }
+    return sessionCount >= session ? sessionCount : 0;
+  }
+
+  // knob events are handed over to the simulated knob, the other records are played by this device
+  void Prepare(HostKnob &knob)
+  {
+    uint64_t knobFreeUs = 0;        // end of the last knob input, so they don't overlap
+    for(size_t i = 0; i < _records.size(); i++)
+    {
+      const ReplayRecord &record = _records[i];
+      if(record.TimeUs > _endUs)
+      {
+        _endUs = record.TimeUs;
+      }
+      switch(record.Type)
+      {
+        case itKNOB:
+        {
+          InputEvent event;
+          memcpy(&event, record.Payload.data(), sizeof(event));
+          uint64_t durationUs = event.Type == ieROTATION ? HostKnob::GetTurnDurationUs(event.Steps) : 0;
+          uint64_t startUs    = record.TimeUs > durationUs + KNOB_LEAD_US ? record.TimeUs - durationUs - KNOB_LEAD_US : 0;
+          startUs    = std::max(startUs, knobFreeUs);
+          knobFreeUs = startUs + durationUs + KNOB_LEAD_US;
+          if(event.Type == ieROTATION)
+          {
+            knob.AddTurn(startUs, event.Steps);
+          }
+          else
+          {
+            knob.SetButton(startUs, event.Type == ieBUTTON_PRESSED);
+          }
+          break;
+        }
+        case itCOM_REPLY:
+        case itCOM_TIMEOUT:
+          _comReplies.push_back(record);
+          break;
+        case itTACH:
+          _tachs.push_back(record);
+          break;
+        case itPMS_DATA:
+        case itPMS_OUTLET_DATA:
+          _events.push_back(record);
+          _events.back().TimeUs = record.TimeUs > REPLAY_PMS_LEAD_US ? record.TimeUs - REPLAY_PMS_LEAD_US : 0;
+          break;
+        default:
+          _events.push_back(record);
+          break;
+      }
+    }
+    // PMS bytes were moved earlier
+    std::stable_sort(_events.begin(), _events.end(),
+                     [](const ReplayRecord &a, const ReplayRecord &b) { return a.TimeUs < b.TimeUs; });
+    StartTachWindow();
+  }
+
+  size_t GetRecordCount() { return _records.size(); }
+  // time of the last recorded input
+  uint64_t GetEndUs() { return _endUs; }
+  uint32_t GetComRepliesPlayed() { return _comPlayed; }
+
+  uint64_t NextEventUs()
+  {
+    uint64_t nextUs = std::min(_replyUs, _nextPulseUs);
+    if(_nextEvent < _events.size())
+    {
+      nextUs = std::min(nextUs, _events[_nextEvent].TimeUs);
+    }
+    return nextUs;
+  }
+
+  void OnEvent(uint64_t nowUs)
+  {
+    if(_replyUs <= nowUs)
+    {
+      _SoftwareSerial.HostInject((const uint8_t *)_reply.c_str(), _reply.length());
+      _replyUs = UINT64_MAX;
+    }
+    while(_nextPulseUs <= nowUs)
+    {
+      HostRaiseExternalInterrupt(digitalPinToInterrupt(PWM_FAN_INPUT_PIN_1));
+      NextPulse();
+    }
+    while(_nextEvent < _events.size() && _events[_nextEvent].TimeUs <= nowUs)
+    {
+      const ReplayRecord &record = _events[_nextEvent++];
+      if(record.Type == itPMS_DATA)
+      {
+        Serial3.HostInject(record.Payload.data(), record.Payload.size());
+      }
+      else if(record.Type == itPMS_OUTLET_DATA)
+      {
+        PMS_OUTLET_SERIAL.HostInject(record.Payload.data(), record.Payload.size());
+      }
+      else if(record.Type == itSD_DETECT)
+      {
+        HostSetInputPin(SD_DETECT_PIN, record.Payload[0]);
+      }
+    }
+  }
+
+  // M105 requests sent by the firmware on the RS232 port
+  void OnTransmit(uint8_t value)
+  {
+    if(value == '\n')
+    {
+      if(_line.find("M105") != std::string::npos)
+      {
+        AnswerRequest(HostNowUs());
+      }
+      _line.clear();
+    }
+    else if(value != '\r')
+    {
+      _line += (char)value;
+    }
+  }
+
+  private:
+  static size_t GetPayloadLength(uint8_t type)
+  {
+    switch(type)
+    {
+      case itSESSION:   return 3;
+      case itKNOB:      return sizeof(InputEvent);
+      case itTACH:      return 4;
+      case itSD_DETECT: return 1;
+      default:          return 0;
+    }
+  }
+
+  void AnswerRequest(uint64_t nowUs)
+  {
+    while(_nextCom < _comReplies.size() && _comReplies[_nextCom].TimeUs + REPLAY_COM_WINDOW_US < nowUs)
+    {
+      _nextCom++;                   // replies older than this request were missed
+    }
+    if(_nextCom >= _comReplies.size() || _comReplies[_nextCom].TimeUs > nowUs + REPLAY_COM_WINDOW_US)
+    {
+      return;                       // nothing recorded around this request
+    }
+    const ReplayRecord &record = _comReplies[_nextCom++];
+    if(record.Type == itCOM_REPLY)
+    {
+      _reply.assign(record.Payload.begin(), record.Payload.end());
+      _reply  += "\n";
+      _replyUs = nowUs + PRINTER_REPLY_US;
+      _comPlayed++;
+    }
+  }
+
+  // pulses of one measurement are played evenly over (time - period, time]
+  void StartTachWindow()
+  {
+    _nextPulseUs = UINT64_MAX;
+    while(_nextTach < _tachs.size())
+    {
+      const ReplayRecord &record = _tachs[_nextTach];
+      _pulseCount  = record.Payload[0] | (record.Payload[1] << 8);
+      _pulsePeriodUs = (uint64_t)(record.Payload[2] | (record.Payload[3] << 8)) * 1000;
+      _pulseEndUs  = record.TimeUs;
+      _pulseIndex  = 0;
+      if(_pulseCount > 0)
+      {
+        NextPulse();
+        return;
+      }
+      _nextTach++;
+    }
+  }
+
+  void NextPulse()
+  {
+    if(_pulseIndex == _pulseCount)
+    {
+      _nextTach++;
+      StartTachWindow();
+      return;
+    }
+    _pulseIndex++;
+    uint64_t startUs = _pulseEndUs > _pulsePeriodUs ? _pulseEndUs - _pulsePeriodUs : 0;
+    _nextPulseUs = startUs + (_pulseEndUs - startUs) * _pulseIndex / _pulseCount;
+  }
+
+  std::vector<ReplayRecord> _records;
+  std::vector<ReplayRecord> _events;        // PMS bytes and SD card detection
+  std::vector<ReplayRecord> _comReplies;
+  std::vector<ReplayRecord> _tachs;
+  size_t      _nextEvent     = 0;
+  size_t      _nextCom       = 0;
+  size_t      _nextTach      = 0;
+  uint64_t    _endUs         = 0;
+  std::string _line;
+  std::string _reply;
+  uint64_t    _replyUs       = UINT64_MAX;
+  uint32_t    _comPlayed     = 0;
+  uint32_t    _pulseCount    = 0;
+  uint32_t    _pulseIndex    = 0;
+  uint64_t    _pulsePeriodUs = 0;
+  uint64_t    _pulseEndUs    = 0;
+  uint64_t    _nextPulseUs   = UINT64_MAX;
+};
+
+// ----------------------------------------------------------------------------
+// Watchdog reset: the simulation can't reboot the firmware, it stops after printing the summary.
+// Running it again with the same EEPROM file boots with the recorded stall history
+// ----------------------------------------------------------------------------
+static std::function<void()> _printSummary;
+
+static void OnWatchdogReset()
+{
+  printf("\nwatchdog reset at %.3f s\n", HostNowUs() / 1000000.0);
+  _printSummary();
+  exit(0);
+}
+
+// ----------------------------------------------------------------------------
+// Command line
+// ----------------------------------------------------------------------------
+static void PrintUsage(const char *program)
+{
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "  --seconds N            simulated duration (default 60, or the whole session with --replay)\n"
+    "  --eeprom FILE          EEPROM image (default host_eeprom.bin)\n"
+    "  --sd FILE              SD card image, created and formatted if missing (default host_sd.img)\n"
+    "  --no-sd                no SD card inserted\n"
+    "  --pm PM1,PM25,PM10     constant air quality values (default 1,1,2)\n"
+    "  --pm-trace FILE        air quality CSV trace: time_s,pm1,pm25,pm10\n"
+    "  --pms-noise N          random noise added to each PM value\n"
+    "  --pms-corrupt P        percentage of sensor frames flipped, cut or preceded by noise\n"
+    "  --outlet-pm PM1,PM25,PM10  constant values of the outlet sensor (DUAL_PMS builds, default 0,0,0)\n"
+    "  --outlet-trace FILE    CSV values of the outlet sensor, same format as --pm-trace\n"
+    "  --outlet-outage T1,T2  the outlet sensor sends nothing between T1 and T2 seconds\n"
+    "  --pms-outage T1,T2     the sensor sends nothing from T1 to T2 seconds\n"
+    "  --bench-pms            measures the PMS frame parser throughput and exits\n"
+    "  --bench-filters        measures the step response and cost of each PM smoothing filter and exits\n"
+    "  --bench-boost          measures the fan reaction to fumes with and without the PM trend boost and exits\n"
+    "  --printer-temp HOT,BED 3D printer answering M105 like Marlin with these temperatures\n"
+    "  --fan-max-rpm N        fan speed at 100%% duty cycle (default 19000)\n"
+    "  --tach-glitches P      percentage of fan tachometer pulses followed by a spurious edge\n"
+    "  --fan-stall T1,T2      the fan rotor is locked from T1 to T2 seconds\n"
+    "  --fan-block T1,T2      the fan air path is blocked from T1 to T2 seconds, it turns 70%% slower\n"
+    "  --fan-start-duty P     the fan doesn't turn below P%% duty cycle (default 0)\n"
+    "  --fan-load T1,T2,P     the filter loads up from T1 to T2 seconds, the fan ends up P%% slower\n"
+    "  --console T:COMMAND    types COMMAND on the USB console at T seconds (repeatable)\n"
+    "  --turn T:N             turns the LCD knob by N detents at T seconds, negative is counter clockwise (repeatable)\n"
+    "  --press T              presses the LCD knob button at T seconds (repeatable)\n"
+    "  --replay FILE          plays the inputs recorded by the firmware into FILE (INPUT_RECORDER)\n"
+    "                         instead of the simulated fan, sensor and printer. Default duration: whole session\n"
+    "  --replay-session N     session of the trace to play, one per firmware startup (default 1)\n"
+    "  --clock-step-us N      virtual time consumed by each millis()/micros() call (default 1)\n"
+    "  --lcd                  prints the LCD content every simulated second\n"
+    "  --quiet                doesn't echo the USB console output\n",
+    program);
+}
+
+int main(int argc, char **argv)
+{
+  double      seconds       = 0;      // 0: default duration
+  const char *eepromPath    = "host_eeprom.bin";
+  const char *sdPath        = "host_sd.img";
+  bool        useSd         = true;
+  unsigned    pm01 = 1, pm25 = 1, pm10 = 2;
+  const char *pmTracePath   = 0;
+  unsigned    pmsNoise      = 0;
+  double      pmsOutageStart = 0, pmsOutageEnd = 0;
+  unsigned    pmsCorrupt    = 0;
+  unsigned    outletPm01 = 0, outletPm25 = 0, outletPm10 = 0;
+  const char *outletTracePath = 0;
+  double      outletOutageStart = 0, outletOutageEnd = 0;
+  bool        usePrinter    = false;
+  double      hotEndTemp    = 0, bedTemp = 0;
+  unsigned    fanMaxRpm     = 19000;
+  unsigned    tachGlitches  = 0;
+  double      fanStallStart = 0, fanStallEnd = 0;
+  double      fanBlockStart = 0, fanBlockEnd = 0;
+  double      fanStartDuty  = 0;
+  double      fanLoadStart  = 0, fanLoadEnd = 0, fanLoad = 0;
+  unsigned    clockStepUs   = 1;
+  bool        showLcd       = false;
+  bool        quiet         = false;
+  HostConsole console;
+  HostKnob    knob;
+  const char *replayPath    = 0;
+  int         replaySession = 1;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string option = argv[i];
+    bool hasValue = i + 1 < argc;
+    if(option == "--seconds" && hasValue)              { seconds = atof(argv[++i]); }
+    else if(option == "--eeprom" && hasValue)          { eepromPath = argv[++i]; }
+    else if(option == "--sd" && hasValue)              { sdPath = argv[++i]; useSd = true; }
+    else if(option == "--no-sd")                       { useSd = false; }
+    else if(option == "--pm" && hasValue)              { sscanf(argv[++i], "%u,%u,%u", &pm01, &pm25, &pm10); }
+    else if(option == "--pm-trace" && hasValue)        { pmTracePath = argv[++i]; }
+    else if(option == "--pms-noise" && hasValue)       { pmsNoise = atoi(argv[++i]); }
+    else if(option == "--pms-outage" && hasValue)      { sscanf(argv[++i], "%lf,%lf", &pmsOutageStart, &pmsOutageEnd); }
+    else if(option == "--pms-corrupt" && hasValue)     { pmsCorrupt = atoi(argv[++i]); }
+    else if(option == "--outlet-pm" && hasValue)       { sscanf(argv[++i], "%u,%u,%u", &outletPm01, &outletPm25, &outletPm10); }
+    else if(option == "--outlet-trace" && hasValue)    { outletTracePath = argv[++i]; }
+    else if(option == "--outlet-outage" && hasValue)   { sscanf(argv[++i], "%lf,%lf", &outletOutageStart, &outletOutageEnd); }
+    else if(option == "--bench-pms")
+    {
+      RunPmsParserBenchmark();
+      return 0;
+    }
+    else if(option == "--bench-filters")
+    {
+      RunPmFilterBenchmark();
+      return 0;
+    }
+    else if(option == "--bench-boost")
+    {
+      RunFanBoostBenchmark();
+      return 0;
+    }
+    else if(option == "--printer-temp" && hasValue)    { usePrinter = sscanf(argv[++i], "%lf,%lf", &hotEndTemp, &bedTemp) == 2; }
+    else if(option == "--fan-max-rpm" && hasValue)     { fanMaxRpm = atoi(argv[++i]); }
+    else if(option == "--tach-glitches" && hasValue)   { tachGlitches = atoi(argv[++i]); }
+    else if(option == "--fan-stall" && hasValue)       { sscanf(argv[++i], "%lf,%lf", &fanStallStart, &fanStallEnd); }
+    else if(option == "--fan-block" && hasValue)       { sscanf(argv[++i], "%lf,%lf", &fanBlockStart, &fanBlockEnd); }
+    else if(option == "--fan-start-duty" && hasValue)  { fanStartDuty = atof(argv[++i]); }
+    else if(option == "--fan-load" && hasValue)        { sscanf(argv[++i], "%lf,%lf,%lf", &fanLoadStart, &fanLoadEnd, &fanLoad); }
+    else if(option == "--replay" && hasValue)          { replayPath = argv[++i]; }
+    else if(option == "--replay-session" && hasValue)  { replaySession = atoi(argv[++i]); }
+    else if(option == "--clock-step-us" && hasValue)   { clockStepUs = atoi(argv[++i]); }
+    else if(option == "--console" && hasValue)
+    {
+      std::string value = argv[++i];
+      size_t separator = value.find(':');
+      if(separator == std::string::npos)
+      {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+      console.Add((uint64_t)(atof(value.substr(0, separator).c_str()) * 1000000), value.substr(separator + 1));
+    }
+    else if(option == "--turn" && hasValue)
+    {
+      double timeS;
+      int detents;
+      if(sscanf(argv[++i], "%lf:%d", &timeS, &detents) != 2)
+      {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+      knob.AddTurn((uint64_t)(timeS * 1000000), detents);
+    }
+    else if(option == "--press" && hasValue)           { knob.AddPress((uint64_t)(atof(argv[++i]) * 1000000)); }
+    else if(option == "--lcd")                         { showLcd = true; }
+    else if(option == "--quiet")                       { quiet = true; }
+    else if(option == "--help")
+    {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else
+    {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(!EEPROM.HostOpen(eepromPath))
+  {
+    fprintf(stderr, "Can't open EEPROM file %s\n", eepromPath);
+    return 1;
+  }
+
+  HostSdCard sdCard;
+  if(useSd)
+  {
+    if(!sdCard.Open(sdPath))
+    {
+      fprintf(stderr, "Can't open SD card image %s\n", sdPath);
+      return 1;
+    }
+    SPI.HostAttachDevice(&sdCard, CS_PIN);
+    HostSetInputPin(SD_DETECT_PIN, LOW);   // card detect switch closed
+  }
+
+  HostFan fan(fanMaxRpm);
+  fan.SetGlitches(tachGlitches);
+  fan.SetStall(fanStallStart, fanStallEnd);
+  fan.SetBlock(fanBlockStart, fanBlockEnd);
+  fan.SetStartDuty(fanStartDuty);
+  fan.SetLoad(fanLoadStart, fanLoadEnd, fanLoad);
+  HostPmSensor pmSensor(Serial3, SET_PIN);
+  if(pmTracePath != 0)
+  {
+    if(!pmSensor.LoadTrace(pmTracePath))
+    {
+      fprintf(stderr, "Can't read air quality trace %s\n", pmTracePath);
+      return 1;
+    }
+  }
+  else
+  {
+    pmSensor.SetConstant(pm01, pm25, pm10);
+  }
+  pmSensor.SetNoise(pmsNoise);
+  pmSensor.SetOutage(pmsOutageStart, pmsOutageEnd);
+  pmSensor.SetCorruption(pmsCorrupt);
+  HostPmSensor outletSensor(PMS_OUTLET_SERIAL, PMS_OUTLET_SET_PIN);
+  if(outletTracePath != 0)
+  {
+    if(!outletSensor.LoadTrace(outletTracePath))
+    {
+      fprintf(stderr, "Can't read air quality trace %s\n", outletTracePath);
+      return 1;
+    }
+  }
+  else
+  {
+    outletSensor.SetConstant(outletPm01, outletPm25, outletPm10);
+  }
+  outletSensor.SetNoise(pmsNoise);
+  outletSensor.SetOutage(outletOutageStart, outletOutageEnd);
+
+  HostPrinter printer(hotEndTemp, bedTemp);
+  HostReplay  replay;
+  int         replaySessions = 0;
+  if(replayPath != 0)
+  {
+    replaySessions = replay.Load(replayPath, replaySession);
+    if(replaySessions == 0)
+    {
+      fprintf(stderr, "Can't read session %d of input trace %s\n", replaySession, replayPath);
+      return 1;
+    }
+    replay.Prepare(knob);
+    _SoftwareSerial.SetListener(&replay);
+    HostAddDevice(&replay);
+    if(seconds == 0)
+    {
+      seconds = (replay.GetEndUs() + REPLAY_END_MARGIN_US) / 1000000.0;
+    }
+  }
+  else
+  {
+    if(usePrinter)
+    {
+      _SoftwareSerial.SetListener(&printer);
+      HostAddDevice(&printer);
+    }
+    HostAddDevice(&fan);
+    HostAddDevice(&pmSensor);
+#ifdef DUAL_PMS
+    HostAddDevice(&outletSensor);
+#endif
+  }
+  if(seconds == 0)
+  {
+    seconds = 60;
+  }
+  HostAddDevice(&console);
+  knob.Prepare();
+  HostAddDevice(&knob);
+  HostSetClockStepUs(clockStepUs);
+  Serial.SetEcho(!quiet);
+
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+
+  _printSummary = [&]()
+  {
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    printf("\n--- simulation summary ---\n");
+    printf("simulated time  : %.3f s\n", HostNowUs() / 1000000.0);
+    printf("wall time       : %.3f s (x%.0f)\n", wallS, wallS > 0 ? HostNowUs() / 1000000.0 / wallS : 0.0);
+    printf("interrupts      : %u\n", (unsigned)HostGetInterruptCount());
+    printf("cpu sleeping    : %.1f%% of the time, last window %u%% active with %u wake-ups\n",
+           HostNowUs() > 0 ? HostGetSleepUs() * 100.0 / HostNowUs() : 0.0,
+           (unsigned)_scheduler.GetActivePercent(), (unsigned)_scheduler.GetWakeUpsPerWindow());
+    printf("fan             : %.0f RPM, %llu pulses, %llu glitches\n", fan.GetRpm(), (unsigned long long)fan.GetPulses(),
+           (unsigned long long)fan.GetGlitches());
+    printf("fan supervisor  : %s, fault %s, %u stalls (last at %.3f s), %u kick starts, %u recoveries\n",
+           FAN_STATE_STRING[_fanSupervisor->GetState()], FAN_FAULT_STRING[_fanSupervisor->GetFault()],
+           _fanSupervisor->GetStallCount(), _fanSupervisor->GetLastStallMs() / 1000.0,
+           _fanSupervisor->GetKickCount(), _fanSupervisor->GetRecoveryCount());
+    printf("PM frames sent  : %u (%u corrupted), Serial3 overflows: %u\n", (unsigned)pmSensor.GetFrameCount(),
+           (unsigned)pmSensor.GetCorruptedCount(), (unsigned)Serial3.GetOverflowCount());
+    CPmsParser &parser = _config->_pm25->GetParser();
+    printf("PM frames parsed: %lu, %u checksum errors, %u framing errors, %u short reads, %u resyncs, %lu bytes discarded\n",
+           parser.GetFrameCount(), parser.GetChecksumErrors(), parser.GetFramingErrors(), parser.GetShortReads(),
+           parser.GetResyncs(), parser.GetDiscardedBytes());
+    PmsLinkStatistics link;
+    _config->_pm25->GetLinkStatistics(link);
+    printf("PM sensor link  : %s, longest gap between frames %lu ms\n", PMS_LINK_STRING[link.State], link.MaxFrameGapMs);
+#ifdef DUAL_PMS
+    CPm25* outlet = _config->_pmsFusion->GetOutlet();
+    outlet->GetLinkStatistics(link);
+    printf("outlet sensor   : %u frames sent, %lu parsed, link %s, filter efficiency %d%%\n", (unsigned)outletSensor.GetFrameCount(),
+           link.Frames, PMS_LINK_STRING[link.State], _config->_pmsFusion->GetFilterEfficiency());
+    printf("sensor fusion   : air quality status from %s, %u failovers\n", PMS_SOURCE_STRING[_config->_pmsFusion->GetSource()],
+           _config->_pmsFusion->GetFailoverCount());
+#endif
+    printf("knob queue full : %u times\n", (unsigned)CRotaryEncoder::GetQueueFullCount());
+    if(replayPath != 0)
+    {
+      printf("replay          : session %d of %d, %u inputs until %.3f s, %u printer replies played\n",
+             replaySession, replaySessions, (unsigned)replay.GetRecordCount(), replay.GetEndUs() / 1000000.0,
+             (unsigned)replay.GetComRepliesPlayed());
+    }
+    printf("EEPROM writes   : %u total, %u max on one address\n", (unsigned)EEPROM.HostGetTotalWriteCount(), (unsigned)EEPROM.HostGetMaxWriteCount());
+    if(useSd)
+    {
+      printf("SD blocks       : %u read, %u written\n", (unsigned)sdCard.GetBlocksRead(), (unsigned)sdCard.GetBlocksWritten());
+    }
+    lcd.HostDump(stdout);
+  };
+  HostSetResetHandler(OnWatchdogReset);
+
+  setup();
+  uint64_t endUs = (uint64_t)(seconds * 1000000);
+  uint64_t nextLcdDumpUs = 1000000;
+  while(HostNowUs() < endUs)
+  {
+    loop();
+    if(showLcd && HostNowUs() >= nextLcdDumpUs)
+    {
+      printf("t=%.3fs\n", HostNowUs() / 1000000.0);
+      lcd.HostDump(stdout);
+      nextLcdDumpUs += 1000000;
+    }
+  }
+
+  _printSummary();
+  return 0;
+}
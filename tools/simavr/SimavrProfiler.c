@@ -0,0 +1,500 @@
+/* 3DTox V2
+ * Copyright (C) 2019 by Nicolas Rambaud
+ *
+ * This file is part of the 3DTox V2 firmware
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License V3.0 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this piece of code.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+ // ----------------------File content description: -------------------
+ // Cycle accurate profiler of the ATmega2560 firmware: runs the real ELF file under simavr
+ // with stubbed peripherals around it:
+ // - PM2.5 sensor: a 32 bytes frame sent on UART3 every second
+ // - fan: tachometer pulses on INT2 (D19)
+ // - SD card removed, LCD knob released. The 3D printer doesn't answer (COM timeouts)
+ // Measured values:
+ // - cycles of each listed function, from its entry to its return. The cycles spent inside
+ //   interrupts are removed, so the result doesn't depend on when the interrupts fire
+ // - latency of each interrupt vector: cycles between the flag being raised and the vector being run
+ // The results are printed and written as a JSON report (see simavr_profile.py, pio run -e simavr -t profile)
+ // Usage: SimavrProfiler firmware.elf --symbols FILE [--seconds N] [--report FILE] [--fan-rpm N] [--pm25 N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_io.h"
+#include "sim_interrupts.h"
+#include "sim_cycle_timers.h"
+#include "avr_uart.h"
+#include "avr_ioport.h"
+
+#define MCU_NAME            "atmega2560"
+#define MCU_FREQUENCY       16000000
+#define FLASH_WORDS         0x20000   // 256KB of flash
+#define MAX_FUNCTIONS       256
+#define MAX_CALL_DEPTH      64
+#define MAX_VECTORS         64
+#define PMS_FRAME_PERIOD_US 1000000
+#define FAN_PULSES_PER_TURN 2
+
+// Mega 2560 pins used by the firmware (see Constants.h)
+#define FAN_TACH_PORT       'D'       // D19 = PD2 = INT2
+#define FAN_TACH_BIT        2
+#define SD_DETECT_PORT      'L'       // D49 = PL0
+#define SD_DETECT_BIT       0
+#define KNOB_PORT           'C'       // BTN_EN1 D31 = PC6, BTN_EN2 D33 = PC4, BTN_ENC D35 = PC2
+#define PMS_UART            '3'
+
+typedef struct {
+  char     Name[128];
+  uint32_t Address;
+  uint8_t  IsVector;
+  uint32_t Calls;
+  uint64_t TotalCycles;
+  uint64_t MaxCycles;
+  uint64_t MinCycles;
+} ProfiledFunction;
+
+// one call in progress
+typedef struct {
+  int16_t  Function;
+  uint16_t EntrySp;               // stack pointer right after the CALL, the function returned once SP is above
+  uint64_t StartCycle;
+  uint64_t StartInterruptCycles;
+} CallFrame;
+
+typedef struct {
+  uint32_t Count;
+  uint64_t TotalLatency;
+  uint64_t MaxLatency;
+  uint64_t PendingCycle;          // 0 when the vector isn't pending
+  avr_t   *Avr;
+} VectorStats;
+
+static ProfiledFunction _functions[MAX_FUNCTIONS];
+static int              _functionCount = 0;
+static int16_t          _entryIndex[FLASH_WORDS];   // function index by entry word address, -1 if none
+static CallFrame        _calls[MAX_CALL_DEPTH];
+static int              _callDepth = 0;
+static int              _vectorDepth = 0;          // amount of interrupt frames inside the call stack
+static uint64_t         _vectorStartCycle = 0;     // entry of the outermost interrupt frame
+static uint64_t         _interruptCycles = 0;      // cycles spent inside interrupts since startup
+static uint32_t         _lostCalls = 0;            // calls deeper than MAX_CALL_DEPTH
+static VectorStats      _vectors[MAX_VECTORS];
+
+static uint32_t         _fanRpm = 19000;
+static uint16_t         _pm25 = 12;
+static uint8_t          _fanLevel = 1;
+
+// ----------------------------------------------------------------------------
+// Symbols: one function per line, "address name" with a hexadecimal byte address
+// ----------------------------------------------------------------------------
+static int LoadSymbols(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if(file == NULL)
+  {
+    return 0;
+  }
+  for(int i = 0; i < FLASH_WORDS; i++)
+  {
+    _entryIndex[i] = -1;
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), file) != NULL && _functionCount < MAX_FUNCTIONS)
+  {
+    unsigned int address;
+    char name[128];
+    if(sscanf(line, "%x %127[^\n]", &address, name) != 2 || address / 2 >= FLASH_WORDS)
+    {
+      continue;
+    }
+    if(_entryIndex[address / 2] >= 0)
+    {
+      continue;                   // aliases of the same function
+    }
+    ProfiledFunction *function = &_functions[_functionCount];
+    memset(function, 0, sizeof(*function));
+    strcpy(function->Name, name);
+    function->Address   = address;
+    function->IsVector  = strncmp(name, "__vector_", 9) == 0;
+    function->MinCycles = UINT64_MAX;
+    _entryIndex[address / 2] = _functionCount++;
+  }
+  fclose(file);
+  return _functionCount;
+}
+
+// ----------------------------------------------------------------------------
+// Call tracking, checked after each instruction
+// ----------------------------------------------------------------------------
+static uint16_t GetSp(avr_t *avr)
+{
+  return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+static void ReturnFromCall(avr_t *avr)
+{
+  CallFrame *frame = &_calls[--_callDepth];
+  ProfiledFunction *function = &_functions[frame->Function];
+  uint64_t cycles;
+  if(function->IsVector)
+  {
+    cycles = avr->cycle - frame->StartCycle;
+    if(--_vectorDepth == 0)
+    {
+      _interruptCycles += avr->cycle - _vectorStartCycle;
+    }
+  }
+  else
+  {
+    cycles = avr->cycle - frame->StartCycle - (_interruptCycles - frame->StartInterruptCycles);
+  }
+  function->Calls++;
+  function->TotalCycles += cycles;
+  if(cycles > function->MaxCycles)
+  {
+    function->MaxCycles = cycles;
+  }
+  if(cycles < function->MinCycles)
+  {
+    function->MinCycles = cycles;
+  }
+}
+
+static void OnInstruction(avr_t *avr)
+{
+  uint16_t sp = GetSp(avr);
+  // RET / RETI popped the return address: every frame entered with a lower SP is over
+  while(_callDepth > 0 && sp > _calls[_callDepth - 1].EntrySp)
+  {
+    ReturnFromCall(avr);
+  }
+
+  int16_t index = _entryIndex[(avr->pc / 2) % FLASH_WORDS];
+  if(index < 0)
+  {
+    return;
+  }
+  if(_callDepth > 0 && _calls[_callDepth - 1].Function == index && _calls[_callDepth - 1].EntrySp == sp)
+  {
+    return;                       // loop jumping back to the first instruction of the function
+  }
+  if(_callDepth == MAX_CALL_DEPTH)
+  {
+    _lostCalls++;
+    return;
+  }
+  if(_functions[index].IsVector && _vectorDepth++ == 0)
+  {
+    _vectorStartCycle = avr->cycle;
+  }
+  CallFrame *frame = &_calls[_callDepth++];
+  frame->Function             = index;
+  frame->EntrySp              = sp;
+  frame->StartCycle           = avr->cycle;
+  frame->StartInterruptCycles = _interruptCycles;
+}
+
+// ----------------------------------------------------------------------------
+// Interrupt latency: from the flag being raised to the vector being run
+// ----------------------------------------------------------------------------
+static void OnVectorPending(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  VectorStats *stats = (VectorStats *)param;
+  (void)irq;
+  if(value && stats->PendingCycle == 0)
+  {
+    stats->PendingCycle = stats->Avr->cycle;
+  }
+}
+
+static void OnVectorRunning(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  VectorStats *stats = (VectorStats *)param;
+  (void)irq;
+  if(!value || stats->PendingCycle == 0)
+  {
+    return;
+  }
+  uint64_t latency = stats->Avr->cycle - stats->PendingCycle;
+  stats->Count++;
+  stats->TotalLatency += latency;
+  if(latency > stats->MaxLatency)
+  {
+    stats->MaxLatency = latency;
+  }
+  stats->PendingCycle = 0;
+}
+
+static void WatchVectors(avr_t *avr)
+{
+  for(int i = 0; i < avr->interrupts.vector_count; i++)
+  {
+    avr_int_vector_t *vector = avr->interrupts.vector[i];
+    if(vector == NULL || vector->vector >= MAX_VECTORS)
+    {
+      continue;
+    }
+    VectorStats *stats = &_vectors[vector->vector];
+    stats->Avr = avr;
+    avr_irq_register_notify(&vector->irq[AVR_INT_IRQ_PENDING], OnVectorPending, stats);
+    avr_irq_register_notify(&vector->irq[AVR_INT_IRQ_RUNNING], OnVectorRunning, stats);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Stubbed peripherals
+// ----------------------------------------------------------------------------
+static avr_cycle_count_t SendPmsFrame(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+  avr_irq_t *input = (avr_irq_t *)param;
+  uint16_t words[13];
+  memset(words, 0, sizeof(words));
+  words[0] = _pm25 / 2;
+  words[1] = _pm25;
+  words[2] = _pm25 + _pm25 / 2;
+  words[3] = words[0];
+  words[4] = words[1];
+  words[5] = words[2];
+
+  uint8_t frame[32];
+  frame[0] = 0x42;
+  frame[1] = 0x4D;
+  frame[2] = 0x00;
+  frame[3] = 28;
+  for(int i = 0; i < 13; i++)
+  {
+    frame[4 + 2 * i] = words[i] >> 8;
+    frame[5 + 2 * i] = words[i] & 0xFF;
+  }
+  uint16_t checksum = 0;
+  for(int i = 0; i < 30; i++)
+  {
+    checksum += frame[i];
+  }
+  frame[30] = checksum >> 8;
+  frame[31] = checksum & 0xFF;
+  for(int i = 0; i < 32; i++)   // fits inside the UART input FIFO, sent at the UART baud rate
+  {
+    avr_raise_irq(input, frame[i]);
+  }
+  return when + avr_usec_to_cycles(avr, PMS_FRAME_PERIOD_US);
+}
+
+static avr_cycle_count_t ToggleFanTach(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+  avr_irq_t *pin = (avr_irq_t *)param;
+  _fanLevel = !_fanLevel;
+  avr_raise_irq(pin, _fanLevel);
+  uint32_t halfPeriodUs = 30000000UL / (_fanRpm * FAN_PULSES_PER_TURN);
+  return when + avr_usec_to_cycles(avr, halfPeriodUs);
+}
+
+static void SetupPeripherals(avr_t *avr)
+{
+  // the UART output of the firmware isn't printed
+  for(char uart = '0'; uart <= '3'; uart++)
+  {
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS(uart), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS(uart), &flags);
+  }
+
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(SD_DETECT_PORT), SD_DETECT_BIT), 1);  // no SD card
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(KNOB_PORT), 6), 1);                     // knob at rest
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(KNOB_PORT), 4), 1);
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(KNOB_PORT), 2), 1);
+
+  avr_irq_t *pmsInput = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ(PMS_UART), UART_IRQ_INPUT);
+  avr_cycle_timer_register_usec(avr, PMS_FRAME_PERIOD_US / 2, SendPmsFrame, pmsInput);
+
+  avr_irq_t *fanPin = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(FAN_TACH_PORT), FAN_TACH_BIT);
+  avr_raise_irq(fanPin, _fanLevel);
+  if(_fanRpm > 0)
+  {
+    avr_cycle_timer_register_usec(avr, 1000, ToggleFanTach, fanPin);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Report
+// ----------------------------------------------------------------------------
+static void PrintReport(FILE *output, avr_t *avr)
+{
+  fprintf(output, "%-48s %8s %12s %12s %12s\n", "FUNCTION", "CALLS", "AVG_CYCLES", "MIN_CYCLES", "MAX_CYCLES");
+  for(int i = 0; i < _functionCount; i++)
+  {
+    ProfiledFunction *function = &_functions[i];
+    if(function->Calls == 0)
+    {
+      continue;
+    }
+    fprintf(output, "%-48.48s %8u %12llu %12llu %12llu\n", function->Name, function->Calls,
+            (unsigned long long)(function->TotalCycles / function->Calls),
+            (unsigned long long)function->MinCycles, (unsigned long long)function->MaxCycles);
+  }
+  fprintf(output, "\n%-48s %8s %12s %12s\n", "VECTOR", "COUNT", "AVG_LATENCY", "MAX_LATENCY");
+  for(int i = 0; i < MAX_VECTORS; i++)
+  {
+    if(_vectors[i].Count == 0)
+    {
+      continue;
+    }
+    fprintf(output, "__vector_%-39d %8u %12llu %12llu\n", i, _vectors[i].Count,
+            (unsigned long long)(_vectors[i].TotalLatency / _vectors[i].Count),
+            (unsigned long long)_vectors[i].MaxLatency);
+  }
+  fprintf(output, "\nsimulated cycles: %llu (%.3f s), interrupts: %.2f%% of the cycles\n",
+          (unsigned long long)avr->cycle, (double)avr->cycle / avr->frequency,
+          avr->cycle ? _interruptCycles * 100.0 / avr->cycle : 0.0);
+  if(_lostCalls > 0)
+  {
+    fprintf(output, "warning: %u calls deeper than %d functions weren't measured\n", _lostCalls, MAX_CALL_DEPTH);
+  }
+}
+
+static int WriteJsonReport(const char *path, const char *firmwarePath, avr_t *avr)
+{
+  FILE *output = fopen(path, "w");
+  if(output == NULL)
+  {
+    return 0;
+  }
+  fprintf(output, "{\n  \"firmware\": \"%s\",\n  \"mcu\": \"%s\",\n  \"frequency\": %u,\n  \"cycles\": %llu,\n  \"interrupt_cycles\": %llu,\n",
+          firmwarePath, MCU_NAME, (unsigned)avr->frequency, (unsigned long long)avr->cycle, (unsigned long long)_interruptCycles);
+  fprintf(output, "  \"functions\": [");
+  const char *separator = "\n";
+  for(int i = 0; i < _functionCount; i++)
+  {
+    ProfiledFunction *function = &_functions[i];
+    if(function->Calls == 0)
+    {
+      continue;
+    }
+    fprintf(output, "%s    { \"name\": \"%s\", \"calls\": %u, \"avg_cycles\": %llu, \"min_cycles\": %llu, \"max_cycles\": %llu, \"total_cycles\": %llu }",
+            separator, function->Name, function->Calls,
+            (unsigned long long)(function->TotalCycles / function->Calls), (unsigned long long)function->MinCycles,
+            (unsigned long long)function->MaxCycles, (unsigned long long)function->TotalCycles);
+    separator = ",\n";
+  }
+  fprintf(output, "\n  ],\n  \"interrupts\": [");
+  separator = "\n";
+  for(int i = 0; i < MAX_VECTORS; i++)
+  {
+    if(_vectors[i].Count == 0)
+    {
+      continue;
+    }
+    fprintf(output, "%s    { \"name\": \"__vector_%d\", \"count\": %u, \"avg_latency_cycles\": %llu, \"max_latency_cycles\": %llu }",
+            separator, i, _vectors[i].Count,
+            (unsigned long long)(_vectors[i].TotalLatency / _vectors[i].Count), (unsigned long long)_vectors[i].MaxLatency);
+    separator = ",\n";
+  }
+  fprintf(output, "\n  ]\n}\n");
+  fclose(output);
+  return 1;
+}
+
+static void PrintUsage(const char *program)
+{
+  fprintf(stderr,
+    "Usage: %s firmware.elf --symbols FILE [options]\n"
+    "  --symbols FILE   functions to profile, one \"hex_address name\" per line\n"
+    "  --seconds N      simulated duration (default 30)\n"
+    "  --report FILE    JSON report\n"
+    "  --fan-rpm N      fan speed sent on the tachometer input, 0 for a stopped fan (default 19000)\n"
+    "  --pm25 N         PM2.5 value sent by the sensor (default 12)\n",
+    program);
+}
+
+int main(int argc, char **argv)
+{
+  const char *firmwarePath = NULL;
+  const char *symbolsPath  = NULL;
+  const char *reportPath   = NULL;
+  double      seconds      = 30;
+
+  for(int i = 1; i < argc; i++)
+  {
+    int hasValue = i + 1 < argc;
+    if(!strcmp(argv[i], "--symbols") && hasValue)      { symbolsPath = argv[++i]; }
+    else if(!strcmp(argv[i], "--seconds") && hasValue) { seconds = atof(argv[++i]); }
+    else if(!strcmp(argv[i], "--report") && hasValue)  { reportPath = argv[++i]; }
+    else if(!strcmp(argv[i], "--fan-rpm") && hasValue) { _fanRpm = atoi(argv[++i]); }
+    else if(!strcmp(argv[i], "--pm25") && hasValue)    { _pm25 = atoi(argv[++i]); }
+    else if(argv[i][0] != '-' && firmwarePath == NULL) { firmwarePath = argv[i]; }
+    else
+    {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if(firmwarePath == NULL || symbolsPath == NULL)
+  {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  if(LoadSymbols(symbolsPath) == 0)
+  {
+    fprintf(stderr, "No function to profile inside %s\n", symbolsPath);
+    return 1;
+  }
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if(elf_read_firmware(firmwarePath, &firmware) != 0)
+  {
+    fprintf(stderr, "Can't read firmware %s\n", firmwarePath);
+    return 1;
+  }
+  avr_t *avr = avr_make_mcu_by_name(MCU_NAME);
+  if(avr == NULL)
+  {
+    fprintf(stderr, "simavr doesn't support %s\n", MCU_NAME);
+    return 1;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->frequency = MCU_FREQUENCY;
+  WatchVectors(avr);
+  SetupPeripherals(avr);
+
+  avr_cycle_count_t endCycle = (avr_cycle_count_t)(seconds * MCU_FREQUENCY);
+  int state = cpu_Running;
+  while(avr->cycle < endCycle && state != cpu_Done && state != cpu_Crashed)
+  {
+    state = avr_run(avr);
+    OnInstruction(avr);
+  }
+  if(state == cpu_Crashed)
+  {
+    fprintf(stderr, "Firmware crashed at pc 0x%05x, cycle %llu\n", avr->pc, (unsigned long long)avr->cycle);
+  }
+
+  PrintReport(stdout, avr);
+  if(reportPath != NULL && !WriteJsonReport(reportPath, firmwarePath, avr))
+  {
+    fprintf(stderr, "Can't write report %s\n", reportPath);
+    return 1;
+  }
+  avr_terminate(avr);
+  return state == cpu_Crashed ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+# 3DTox V2
+# Copyright (C) 2019 by Nicolas Rambaud
+#
+# This file is part of the 3DTox V2 firmware
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This Library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License V3.0 for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this piece of code.  If not, see
+# <http://www.gnu.org/licenses/>.
+
+# ----------------------File content description: -------------------
+# PlatformIO extra script of the simavr environment, adding the "profile" target:
+#   pio run -e simavr -t profile
+# - builds SimavrProfiler.c with the host compiler against simavr (pkg-config simavr, libelf)
+# - lists the profiled functions of the firmware ELF with avr-nm
+# - runs the firmware under simavr and writes profile.json inside the build directory
+# - compares the report with the previous run (profile.previous.json) and fails when a function
+#   average or an interrupt max latency got slower than custom_profile_tolerance percent
+# Requires simavr with its development files (apt install simavr libsimavr-dev libelf-dev)
+
+Import("env")
+
+import json
+import os
+import re
+import shutil
+import subprocess
+
+# functions measured by the profiler, matched against the demangled symbol names
+PROFILED_FUNCTIONS = [
+    r"^FanController::getSpeed\(",
+    r"^LogDataToSdIfAvailable\(",
+    r"^CPm25::",
+    r"^CPmsParser::",
+    r"^CRunningDuration::SpreadReadMinutes\(",
+    r"^CRunningDuration::CheckAndSaveRunningDuration\(",
+    r"^ViewMain::",
+    r"^LiquidCrystal::",
+    r"^CRotaryEncoder::",
+    r"^CScheduler::RunNextTask\(",
+    r"^Task",
+    r"^v?sprintf$",
+    r"^__vector_\d+$",
+]
+
+TOOL_DIR      = os.path.join(env.subst("$PROJECT_DIR"), "tools", "simavr")
+BUILD_DIR     = env.subst("$BUILD_DIR")
+PROFILER_PATH = os.path.join(BUILD_DIR, "SimavrProfiler")
+SYMBOLS_PATH  = os.path.join(BUILD_DIR, "profile_symbols.txt")
+REPORT_PATH   = os.path.join(BUILD_DIR, "profile.json")
+PREVIOUS_PATH = os.path.join(BUILD_DIR, "profile.previous.json")
+
+
+def get_option(name, default):
+    return env.GetProjectOption(name, default)
+
+
+def run(command, **kwargs):
+    print(" ".join(command))
+    return subprocess.run(command, env=env["ENV"], universal_newlines=True, **kwargs)
+
+
+def build_profiler(target, source, env):
+    flags = subprocess.run(["pkg-config", "--cflags", "--libs", "simavr"],
+                           stdout=subprocess.PIPE, universal_newlines=True)
+    if flags.returncode == 0:
+        flags = flags.stdout.split()
+    else:
+        flags = ["-I/usr/include/simavr", "-lsimavr"]
+    result = run(["cc", "-O2", "-std=gnu99", os.path.join(TOOL_DIR, "SimavrProfiler.c"),
+                  "-o", PROFILER_PATH] + flags + ["-lelf"])
+    return result.returncode
+
+
+def list_symbols(target, source, env):
+    elf = str(source[0])
+    result = run(["avr-nm", "--demangle", "--defined-only", elf], stdout=subprocess.PIPE)
+    if result.returncode != 0:
+        return result.returncode
+    patterns = [re.compile(pattern) for pattern in PROFILED_FUNCTIONS]
+    count = 0
+    with open(SYMBOLS_PATH, "w") as symbols:
+        for line in result.stdout.splitlines():
+            fields = line.split(" ", 2)
+            if len(fields) != 3 or fields[1] not in ("T", "t", "W", "w"):
+                continue
+            if any(pattern.search(fields[2]) for pattern in patterns):
+                symbols.write("%s %s\n" % (fields[0], fields[2]))
+                count += 1
+    print("%d functions profiled" % count)
+    return 0 if count > 0 else 1
+
+
+def run_profiler(target, source, env):
+    if os.path.isfile(REPORT_PATH):
+        shutil.copyfile(REPORT_PATH, PREVIOUS_PATH)
+    command = [PROFILER_PATH, str(source[0]), "--symbols", SYMBOLS_PATH, "--report", REPORT_PATH,
+               "--seconds", str(get_option("custom_profile_seconds", "30"))]
+    return run(command).returncode
+
+
+# a change is reported when it's above the tolerance and above a few cycles, so tiny functions don't trigger it
+def compare_reports(target, source, env):
+    if not os.path.isfile(PREVIOUS_PATH):
+        print("No previous report, %s is the new baseline" % REPORT_PATH)
+        return 0
+    tolerance = float(get_option("custom_profile_tolerance", "5"))
+    with open(PREVIOUS_PATH) as file:
+        previous = json.load(file)
+    with open(REPORT_PATH) as file:
+        current = json.load(file)
+
+    regressions = 0
+    for section, key in (("functions", "avg_cycles"), ("interrupts", "max_latency_cycles")):
+        before = dict((item["name"], item[key]) for item in previous.get(section, []))
+        for item in current.get(section, []):
+            old = before.get(item["name"])
+            new = item[key]
+            if not old or abs(new - old) < 8:
+                continue
+            change = (new - old) * 100.0 / old
+            if abs(change) < tolerance:
+                continue
+            print("%-10s %-48s %-18s %10d -> %10d (%+.1f%%)" % (
+                "SLOWER" if change > 0 else "faster", item["name"], key, old, new, change))
+            if change > 0:
+                regressions += 1
+    if regressions > 0:
+        print("%d performance regressions above %.1f%%" % (regressions, tolerance))
+        return 1
+    print("No performance regression above %.1f%%" % tolerance)
+    return 0
+
+
+env.AddCustomTarget(
+    name="profile",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[build_profiler, list_symbols, run_profiler, compare_reports],
+    title="Profile",
+    description="Runs the firmware under simavr and reports cycles per function and interrupt latencies")